@@ -0,0 +1,187 @@
+/*Allocation accounting. Every allocation of the assembler's structures
+  goes through mem_alloc with the subsystem it belongs to. Normally that's
+  just malloc. With --alloc-stats, each block gets a small header with its
+  size and tag, so that mem_free can take it off the right account, and
+  the counts, bytes and peak live heap are reported per subsystem.
+  
+  Since the header is there only with the stats on, ALLOC_STATS must not
+  change once something was allocated, and whatever comes from mem_alloc
+  must go back through mem_free.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bool.h"
+#include "alloc.h"
+
+/*precedes the block, the union keeps the block aligned for anything*/
+typedef union mem_header {
+    struct {
+        size_t size;
+        mem_tag tag;
+    } info;
+    double align_double;
+    long align_long;
+    void *align_ptr;
+} mem_header;
+
+typedef struct mem_account {
+    long allocs;
+    long frees;
+    unsigned long bytes; /*allocated in total*/
+    unsigned long live;  /*allocated and not yet freed*/
+    unsigned long peak;  /*of live*/
+} mem_account;
+
+bool ALLOC_STATS = false;
+
+static mem_account accounts[MAX_MEM_TAGS];
+static mem_account total;
+static unsigned long file_peak; /*of total.live, since reset_file_peak*/
+
+static const char *tag_names[MAX_MEM_TAGS] = {
+    "lexer",
+    "parser",
+    "symbols",
+    "code image",
+    "output",
+    "lists",
+    "server",
+    "other"
+};
+
+/*Same as malloc, and accounted to tag when ALLOC_STATS is set.*/
+void *mem_alloc(size_t size, mem_tag tag) {
+    mem_header *header;
+    
+    if (!ALLOC_STATS) {
+        return malloc(size);
+    }
+    
+    header = malloc(sizeof(mem_header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    
+    header->info.size = size;
+    header->info.tag  = tag;
+    
+    accounts[tag].allocs++;
+    accounts[tag].bytes += size;
+    accounts[tag].live  += size;
+    if (accounts[tag].live > accounts[tag].peak) {
+        accounts[tag].peak = accounts[tag].live;
+    }
+    
+    total.allocs++;
+    total.bytes += size;
+    total.live  += size;
+    if (total.live > total.peak) {
+        total.peak = total.live;
+    }
+    if (total.live > file_peak) {
+        file_peak = total.live;
+    }
+    
+    return header+1;
+}
+
+/*Same as realloc, for what mem_alloc allocated. The block stays on the
+  account it was on, tag is for a NULL ptr.*/
+void *mem_realloc(void *ptr, size_t size, mem_tag tag) {
+    mem_header *header;
+    size_t old_size;
+    
+    if (!ALLOC_STATS) {
+        return realloc(ptr, size);
+    } else if (ptr == NULL) {
+        return mem_alloc(size, tag);
+    }
+    
+    header   = (mem_header*)ptr - 1;
+    old_size = header->info.size;
+    tag      = header->info.tag;
+    
+    header = realloc(header, sizeof(mem_header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    
+    header->info.size = size;
+    
+    /*counted as a free of the old block and an allocation of the new*/
+    accounts[tag].allocs++;
+    accounts[tag].frees++;
+    accounts[tag].bytes += size;
+    accounts[tag].live  = accounts[tag].live - old_size + size;
+    if (accounts[tag].live > accounts[tag].peak) {
+        accounts[tag].peak = accounts[tag].live;
+    }
+    
+    total.allocs++;
+    total.frees++;
+    total.bytes += size;
+    total.live  = total.live - old_size + size;
+    if (total.live > total.peak) {
+        total.peak = total.live;
+    }
+    if (total.live > file_peak) {
+        file_peak = total.live;
+    }
+    
+    return header+1;
+}
+
+/*Frees what mem_alloc allocated. The signature is free's, so it can be
+  passed as an item destroyer to destroy_clist.*/
+void mem_free(void *ptr) {
+    mem_header *header;
+    
+    if (!ALLOC_STATS || ptr == NULL) {
+        free(ptr);
+        return;
+    }
+    
+    header = (mem_header*)ptr - 1;
+    
+    accounts[header->info.tag].frees++;
+    accounts[header->info.tag].live -= header->info.size;
+    total.frees++;
+    total.live -= header->info.size;
+    
+    free(header);
+}
+
+/*Prints the accounts of all the subsystems to f_out.*/
+void print_alloc_stats(FILE *f_out) {
+    int i;
+    
+    fprintf(f_out, "\n\nAllocations:\n");
+    fprintf(f_out, "%-12s %10s %10s %12s %12s %12s\n", "subsystem",
+            "allocs", "frees", "bytes", "peak live", "live now");
+    for (i = 0; i < MAX_MEM_TAGS; i++) {
+        fprintf(f_out, "%-12s %10ld %10ld %12lu %12lu %12lu\n",
+                tag_names[i], accounts[i].allocs, accounts[i].frees,
+                accounts[i].bytes, accounts[i].peak, accounts[i].live);
+    }
+    /*the subsystems peak at different times, so the total peak is
+      usually less than the sum of theirs*/
+    fprintf(f_out, "%-12s %10ld %10ld %12lu %12lu %12lu\n", "total",
+            total.allocs, total.frees, total.bytes, total.peak, total.live);
+}
+
+/*Returns the allocations made so far, for the microbenchmarks.*/
+long get_alloc_count(void) {
+    return total.allocs;
+}
+
+/*Starts measuring the peak live heap of a file anew.*/
+void reset_file_peak(void) {
+    file_peak = total.live;
+}
+
+/*Returns the peak live heap since reset_file_peak, 0 without
+  ALLOC_STATS.*/
+unsigned long get_file_peak(void) {
+    return file_peak;
+}
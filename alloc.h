@@ -0,0 +1,28 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+/*who the memory is for, see --alloc-stats*/
+typedef enum {
+    mem_lexer,   /*tokens of the current line*/
+    mem_parser,  /*statements and operands*/
+    mem_symbols, /*labels, entries and externs*/
+    mem_code,    /*the machine code and what's needed to finish it*/
+    mem_output,  /*entry/extern output, queued errors and diagnostics*/
+    mem_lists,   /*c_list nodes, whatever they hold*/
+    mem_lsp,     /*documents, messages and JSON of the language server*/
+    mem_other,
+    MAX_MEM_TAGS
+} mem_tag;
+
+extern bool ALLOC_STATS; /*set by --alloc-stats, before anything is
+                           allocated*/
+
+void *mem_alloc(size_t size, mem_tag tag);
+void *mem_realloc(void *ptr, size_t size, mem_tag tag);
+void mem_free(void *ptr);
+void print_alloc_stats(FILE *f_out);
+long get_alloc_count(void);
+void reset_file_peak(void);
+unsigned long get_file_peak(void);
+
+#endif /*ALLOC_H*/
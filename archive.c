@@ -0,0 +1,417 @@
+/*Archives of assembled modules, and the link of the members of them that
+  are needed.
+  
+  An archive (name.lib, made by the archiver) has the binary objects of
+  its members (see objfile.c, with the data runs kept) one after the
+  other, and the tables of the members and of all their entries at the
+  end. The entries (the index) are sorted by name, so the member that
+  has an entry is found by a binary search, and the tables are all that
+  is read to open an archive: a member is read only once it's needed.
+  The numbers are as in the binary object:
+    magic "AARC", version (16 bits), word size (16 bits)
+    member count, index count, offset of the tables (32 bits each)
+    the binary objects of the members
+    the tables: every member's offset (32 bits), name length (16 bits)
+                and name, then every entry's member (32 bits), name
+                length (16 bits) and name, by name then member
+  As with ranlib, an entry of two members is in the index twice, and the
+  first member is the one that's found.
+  
+  pull_archive_modules adds the members that a link needs to it: every
+  extern of the modules of the link that isn't an entry of any of them is
+  looked up in the archives, and the member that has it is added, which
+  may need more members in turn.*/
+
+#define _POSIX_C_SOURCE 200112L /*for the threads of link.h*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+#include "archive.h"
+
+#define ARC_MAGIC "AARC"
+#define ARC_MAGIC_LENGTH 4
+#define ARC_VERSION 1
+#define MIN_TABLE 16 /*entries, of a table that grows*/
+#define MIN_TABLE_BYTES 6 /*of a member or an entry of the tables, with an
+                            empty name*/
+
+static void init_archive(archive_t *ar);
+static void put_archive_header(archive_t *ar, unsigned long tables);
+static void put_archive_name(char *name, FILE *f_out);
+static bool get_archive_name(FILE *f_in, char **name);
+static char *copy_archive_name(const char *name, size_t length);
+static void *grow_table(void *table, unsigned int *capacity,
+                        unsigned int count, unsigned int needed,
+                        size_t size);
+static void add_defined_entries(c_hash *defined, obj_image *img);
+static int cmp_archive_symbol(const void *a, const void *b);
+
+/*Starts the archive filename.lib, which the members are added to, and
+  which is done by finish_archive.*/
+void create_archive(archive_t *ar, char *filename) {
+    init_archive(ar);
+    ar->file = open_obj_file(ar->fname, filename, EXTENSION_LIB, "wb");
+    
+    /*written again by finish_archive, with the counts*/
+    put_archive_header(ar, 0);
+}
+
+/*Writes img into the archive, as the member name (which is copied).*/
+void add_archive_member(archive_t *ar, obj_image *img, char *name) {
+    unsigned int i;
+    archive_member *p_member;
+    archive_symbol *p_symbol;
+    
+    ar->members = grow_table(ar->members, &ar->member_capacity,
+                             ar->member_count, ar->member_count + 1,
+                             sizeof(archive_member));
+    p_member = &ar->members[ar->member_count];
+    p_member->name   = copy_archive_name(name, strlen(name));
+    p_member->offset = ftell(ar->file);
+    p_member->pulled = false;
+    put_obj_bin(img, ar->file, true);
+    
+    ar->index = grow_table(ar->index, &ar->symbol_capacity,
+                           ar->symbol_count,
+                           ar->symbol_count + img->entry_count,
+                           sizeof(archive_symbol));
+    for (i = 0; i < img->entry_count; i++) {
+        p_symbol = &ar->index[ar->symbol_count++];
+        p_symbol->name   = copy_archive_name(img->entries[i].name,
+                                             strlen(img->entries[i].name));
+        p_symbol->member = ar->member_count;
+    }
+    
+    ar->member_count++;
+}
+
+/*Writes the tables of the archive after its members, and closes its
+  file (close_archive frees the rest).*/
+void finish_archive(archive_t *ar) {
+    unsigned int i;
+    unsigned long tables = ftell(ar->file);
+    
+    qsort(ar->index, ar->symbol_count, sizeof(archive_symbol),
+          &cmp_archive_symbol);
+    
+    for (i = 0; i < ar->member_count; i++) {
+        put_u32(ar->members[i].offset, ar->file);
+        put_archive_name(ar->members[i].name, ar->file);
+    }
+    for (i = 0; i < ar->symbol_count; i++) {
+        put_u32(ar->index[i].member, ar->file);
+        put_archive_name(ar->index[i].name, ar->file);
+    }
+    
+    fseek(ar->file, 0, SEEK_SET);
+    put_archive_header(ar, tables);
+    fclose(ar->file);
+    ar->file = NULL;
+}
+
+/*Closes the archive that was being made, and removes its file.*/
+void discard_archive(archive_t *ar) {
+    fclose(ar->file);
+    ar->file = NULL;
+    remove(ar->fname);
+}
+
+/*Opens filename.lib and reads its tables, the members are read as
+  they're needed (see read_archive_member). Returns false (and prints
+  why) if it can't be read, ar is closed then.*/
+bool open_archive(archive_t *ar, char *filename) {
+    char magic[ARC_MAGIC_LENGTH];
+    unsigned int i;
+    unsigned int version, word_size;
+    unsigned int member_count, symbol_count, tables, offset;
+    bool tables_ok;
+    
+    init_archive(ar);
+    ar->file = open_obj_file(ar->fname, filename, EXTENSION_LIB, "rb");
+    if (ar->file == NULL) {
+        fprintf(stderr, "Error, can't read %s\n", ar->fname);
+        return false;
+    }
+    
+    if (fread(magic, 1, ARC_MAGIC_LENGTH, ar->file) != ARC_MAGIC_LENGTH ||
+        memcmp(magic, ARC_MAGIC, ARC_MAGIC_LENGTH) != 0 ||
+        !get_u16(ar->file, &version) || !get_u16(ar->file, &word_size)) {
+        fprintf(stderr, "Error, %s is not an archive.\n", ar->fname);
+        close_archive(ar);
+        return false;
+    }
+    
+    if (version != ARC_VERSION || word_size != WORD_BITS) {
+        fprintf(stderr, "Error, %s is of version %u (word size %u), "
+                        "expected %d (word size %d).\n", ar->fname,
+                version, word_size, ARC_VERSION, WORD_BITS);
+        close_archive(ar);
+        return false;
+    }
+    
+    tables_ok = get_u32(ar->file, &member_count) &&
+                get_u32(ar->file, &symbol_count) &&
+                get_u32(ar->file, &tables) &&
+                fseek(ar->file, tables, SEEK_SET) == 0 &&
+                member_count <= get_bytes_left(ar->file)/MIN_TABLE_BYTES &&
+                symbol_count <= get_bytes_left(ar->file)/MIN_TABLE_BYTES -
+                                member_count;
+    if (tables_ok) {
+        ar->members = grow_table(NULL, &ar->member_capacity, 0,
+                                 member_count, sizeof(archive_member));
+        ar->index   = grow_table(NULL, &ar->symbol_capacity, 0,
+                                 symbol_count, sizeof(archive_symbol));
+    }
+    
+    /*counted as they're read, for close_archive to free*/
+    for (i = 0; tables_ok && i < member_count; i++) {
+        tables_ok = get_u32(ar->file, &offset) &&
+                    get_archive_name(ar->file, &ar->members[i].name);
+        if (tables_ok) {
+            ar->members[i].offset = offset;
+            ar->members[i].pulled = false;
+            ar->member_count++;
+        }
+    }
+    for (i = 0; tables_ok && i < symbol_count; i++) {
+        tables_ok = get_u32(ar->file, &ar->index[i].member) &&
+                    get_archive_name(ar->file, &ar->index[i].name);
+        if (tables_ok) {
+            ar->symbol_count++;
+            tables_ok = ar->index[i].member < member_count;
+        }
+    }
+    
+    if (!tables_ok) {
+        fprintf(stderr, "Error, %s is cut short.\n", ar->fname);
+        close_archive(ar);
+        return false;
+    }
+    
+    return true;
+}
+
+/*Returns the first member with the entry name, -1 if there's none.*/
+int find_archive_symbol(archive_t *ar, char *name) {
+    unsigned int low = 0;
+    unsigned int high = ar->symbol_count;
+    unsigned int mid;
+    
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (strcmp(ar->index[mid].name, name) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    return low < ar->symbol_count && strcmp(ar->index[low].name, name) == 0 ?
+           (int)ar->index[low].member : -1;
+}
+
+/*Reads member of the archive into img, which is initialized by the call.
+  Returns false (and prints why) if it can't be read.*/
+bool read_archive_member(archive_t *ar, unsigned int member,
+                         obj_image *img) {
+    char name[2*MAX_FILE_LENGTH + 2]; /*archive(member), for the errors*/
+    
+    sprintf(name, "%s(%s)", ar->fname, ar->members[member].name);
+    if (fseek(ar->file, ar->members[member].offset, SEEK_SET) != 0) {
+        init_obj_image(img, IC_INIT, 0, 0);
+        fprintf(stderr, "Error, %s is cut short.\n", name);
+        return false;
+    }
+    
+    return get_obj_bin(img, ar->file, name);
+}
+
+/*Closes the archive, which is empty after. The members of a link that
+  were pulled from it go with it, so that's after the link.*/
+void close_archive(archive_t *ar) {
+    unsigned int i;
+    
+    for (i = 0; i < ar->member_count; i++) {
+        mem_free(ar->members[i].name);
+    }
+    for (i = 0; i < ar->symbol_count; i++) {
+        mem_free(ar->index[i].name);
+    }
+    
+    if (ar->file != NULL) {
+        fclose(ar->file);
+    }
+    mem_free(ar->members);
+    mem_free(ar->index);
+    init_archive(ar);
+}
+
+/*Adds the members of the archives that the modules of lnk need to it,
+  after them: every extern that isn't an entry of a module of the link
+  is looked up in the archives in order, and the member that has it is
+  added, with the externs of its own to look up. An extern that no
+  archive has is left for the link to report. Returns false (and prints
+  why) if a member can't be read.*/
+bool pull_archive_modules(link_t *lnk, archive_t *archives,
+                          int archive_count) {
+    unsigned int i, j, k;
+    int a;
+    int member = -1;
+    bool pulled_ok = true;
+    char *name;
+    c_hash defined; /*the entries of the modules, by name*/
+    
+    init_chash(&defined, &get_obj_symbol_name);
+    for (i = 0; i < lnk->module_count; i++) {
+        add_defined_entries(&defined, &lnk->modules[i].img);
+    }
+    
+    /*the modules that are added are gone over as well*/
+    for (i = 0; i < lnk->module_count && pulled_ok; i++) {
+        for (j = 0; j < lnk->modules[i].img.extern_count && pulled_ok; j++) {
+            name = lnk->modules[i].img.externs[j].name;
+            if (find_chash_str(&defined, &find_obj_symbol, name) != NULL) {
+                continue;
+            }
+            
+            for (a = 0; a < archive_count; a++) {
+                if ((member = find_archive_symbol(&archives[a], name)) >= 0) {
+                    break;
+                }
+            }
+            if (a == archive_count || archives[a].members[member].pulled) {
+                continue;
+            }
+            
+            archives[a].members[member].pulled = true;
+            k = add_link_module(lnk, archives[a].members[member].name);
+            destroy_obj_image(&lnk->modules[k].img);
+            pulled_ok = read_archive_member(&archives[a], member,
+                                            &lnk->modules[k].img);
+            add_defined_entries(&defined, &lnk->modules[k].img);
+        }
+    }
+    
+    destroy_chash(&defined);
+    
+    return pulled_ok;
+}
+
+static void init_archive(archive_t *ar) {
+    ar->fname[0]        = '\0';
+    ar->file            = NULL;
+    ar->members         = NULL;
+    ar->member_count    = 0;
+    ar->member_capacity = 0;
+    ar->index           = NULL;
+    ar->symbol_count    = 0;
+    ar->symbol_capacity = 0;
+}
+
+/*tables is the offset of the tables, at the end.*/
+static void put_archive_header(archive_t *ar, unsigned long tables) {
+    fwrite(ARC_MAGIC, 1, ARC_MAGIC_LENGTH, ar->file);
+    put_u16(ARC_VERSION, ar->file);
+    put_u16(WORD_BITS, ar->file);
+    put_u32(ar->member_count, ar->file);
+    put_u32(ar->symbol_count, ar->file);
+    put_u32(tables, ar->file);
+}
+
+static void put_archive_name(char *name, FILE *f_out) {
+    size_t length = strlen(name);
+    
+    put_u16(length, f_out);
+    fwrite(name, 1, length, f_out);
+}
+
+static bool get_archive_name(FILE *f_in, char **name) {
+    unsigned int length;
+    char name_buf[MAX_FILE_LENGTH];
+    
+    if (!get_u16(f_in, &length) || length >= MAX_FILE_LENGTH ||
+        fread(name_buf, 1, length, f_in) != length) {
+        return false;
+    }
+    
+    *name = copy_archive_name(name_buf, length);
+    return true;
+}
+
+static char *copy_archive_name(const char *name, size_t length) {
+    char *copy = mem_alloc(length+1, mem_output);
+    
+    if (copy == NULL) {
+        fprintf(stderr, "Malloc failure in copy_archive_name.");
+        exit(1);
+    }
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    
+    return copy;
+}
+
+/*Returns table (of count items of size) with the room for needed items
+  at least, moved to a bigger one if it hasn't.*/
+static void *grow_table(void *table, unsigned int *capacity,
+                        unsigned int count, unsigned int needed,
+                        size_t size) {
+    void *grown;
+    
+    if (table != NULL && needed <= *capacity) {
+        return table;
+    }
+    
+    *capacity = *capacity * 2 > needed ? *capacity * 2 : needed;
+    if (*capacity < MIN_TABLE) {
+        *capacity = MIN_TABLE;
+    }
+    
+    grown = mem_alloc(size * *capacity, mem_output);
+    if (grown == NULL) {
+        fprintf(stderr, "Malloc failure in grow_table.");
+        exit(1);
+    }
+    
+    if (count > 0) {
+        memcpy(grown, table, size * count);
+    }
+    mem_free(table);
+    
+    return grown;
+}
+
+static void add_defined_entries(c_hash *defined, obj_image *img) {
+    unsigned int i;
+    
+    for (i = 0; i < img->entry_count; i++) {
+        add_chash(defined, &img->entries[i]);
+    }
+}
+
+/*By name, then by member.*/
+static int cmp_archive_symbol(const void *a, const void *b) {
+    const archive_symbol *sym_a = a;
+    const archive_symbol *sym_b = b;
+    int cmp = strcmp(sym_a->name, sym_b->name);
+    
+    if (cmp != 0) {
+        return cmp;
+    }
+    
+    return sym_a->member < sym_b->member ? -1 :
+           sym_a->member > sym_b->member;
+}
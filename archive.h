@@ -0,0 +1,48 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#define EXTENSION_LIB ".lib" /*the archive*/
+
+    /*a module of an archive*/
+    typedef struct archive_member {
+        char *name;           /*as it was given, without an extension*/
+        unsigned long offset; /*of its binary object, in the file*/
+        bool pulled;          /*into a link already*/
+    } archive_member;
+    
+    /*an entry of a member, in the index*/
+    typedef struct archive_symbol {
+        char *name;
+        unsigned int member;
+    } archive_symbol;
+
+/*Assembled modules bundled into a single file, with an index of all
+  their entries sorted by name, to find the member that has an entry
+  without reading the others. See archive.c.*/
+typedef struct archive_t {
+    char fname[MAX_FILE_LENGTH]; /*of the file, with the extension*/
+    FILE *file;                  /*NULL once it's closed*/
+    
+    archive_member *members;
+    unsigned int member_count;
+    unsigned int member_capacity; /*while it's made*/
+    
+    archive_symbol *index;       /*by name, then member*/
+    unsigned int symbol_count;
+    unsigned int symbol_capacity;
+} archive_t;
+
+void create_archive(archive_t *ar, char *filename);
+void add_archive_member(archive_t *ar, obj_image *img, char *name);
+void finish_archive(archive_t *ar);
+void discard_archive(archive_t *ar);
+bool open_archive(archive_t *ar, char *filename);
+int find_archive_symbol(archive_t *ar, char *name);
+bool read_archive_member(archive_t *ar, unsigned int member,
+                         obj_image *img);
+void close_archive(archive_t *ar);
+
+bool pull_archive_modules(link_t *lnk, archive_t *archives,
+                          int archive_count);
+
+#endif /*ARCHIVE_H*/
@@ -0,0 +1,121 @@
+/*Bundles assembled modules into an archive, with an index of their
+  entries, for the linker to take only the members it needs from (see
+  archive.c, and --lib of the linker).
+  
+  Usage: archiver [options] archive name...
+         archiver --list archive
+  
+  Options:
+    --from FORMAT   text reads name.ob (with name.ent and name.ext, if
+                    there are), bin reads name.obj, text is the default
+    --list          prints the members of archive.lib, then its index:
+                    every entry, by name, with the member it's of
+  
+  The names are given without an extension, and so is the archive, which
+  is written to archive.lib. The modules are read one at a time, so an
+  archive of any number of them takes the memory of one. Exits with 1 if
+  a module or the archive can't be read, no archive is left then.*/
+
+#define _POSIX_C_SOURCE 200112L /*for the threads of link.h*/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+#include "archive.h"
+
+static bool list_archive(char *filename);
+
+int main(int argc, char **argv) {
+    int i;
+    char *from = "text";
+    bool list = false;
+    bool read_ok;
+    bool archive_ok = true;
+    int first_name = 0; /*the archive, then the modules*/
+    archive_t ar;
+    obj_image img;
+    
+    for (i = 1; i < argc && first_name == 0; i++) {
+        if (strcmp(argv[i], "--from") == 0 && i+1 < argc) {
+            from = argv[++i];
+        } else if (strncmp(argv[i], "--from=", 7) == 0) {
+            from = argv[i] + 7;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else if (argv[i][0] != '-') {
+            first_name = i;
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (first_name == 0 || (list && first_name != argc-1) ||
+        (!list && first_name == argc-1) ||
+        (strcmp(from, "text") != 0 && strcmp(from, "bin") != 0)) {
+        fprintf(stderr, "Usage: archiver [--from text|bin] archive "
+                        "name...\n"
+                        "       archiver --list archive\n");
+        return 2;
+    }
+    
+    if (list) {
+        return list_archive(argv[first_name]) ? 0 : 1;
+    }
+    
+    create_archive(&ar, argv[first_name]);
+    for (i = first_name+1; i < argc; i++) {
+        read_ok = strcmp(from, "bin") == 0 ? read_obj_bin(&img, argv[i]) :
+                                             read_obj_text(&img, argv[i]);
+        if (read_ok) {
+            add_archive_member(&ar, &img, argv[i]);
+        }
+        archive_ok = archive_ok && read_ok;
+        destroy_obj_image(&img);
+    }
+    
+    if (archive_ok) {
+        finish_archive(&ar);
+    } else {
+        discard_archive(&ar);
+    }
+    close_archive(&ar);
+    
+    return archive_ok ? 0 : 1;
+}
+
+/*Prints the tables of filename.lib. Returns false if it can't be
+  read.*/
+static bool list_archive(char *filename) {
+    unsigned int i;
+    archive_t ar;
+    
+    if (!open_archive(&ar, filename)) {
+        return false;
+    }
+    
+    printf("%u members\n", ar.member_count);
+    for (i = 0; i < ar.member_count; i++) {
+        printf("    %s\n", ar.members[i].name);
+    }
+    
+    printf("%u entries\n", ar.symbol_count);
+    for (i = 0; i < ar.symbol_count; i++) {
+        printf("    %s\t%s\n", ar.index[i].name,
+               ar.members[ar.index[i].member].name);
+    }
+    
+    close_archive(&ar);
+    
+    return true;
+}
@@ -0,0 +1,587 @@
+/*End to end benchmark of the assembler, run by make bench. Each case is a
+  set of programs generated by asgen (with fixed seeds, so the corpus is
+  always the same), which the assembler is run over a few times. The
+  median wall time, lines/sec and the peak RSS of every case are reported
+  and compared against the baseline, and a case that got slower by more
+  than the threshold fails the run.
+  
+  Usage: asbench [options] assembler
+  
+  Options:
+    --runs N          runs of each case, the median is taken (default 5)
+    --threshold P     allowed slowdown against the baseline, in percent
+                      (default 20)
+    --baseline FILE   the baseline to compare against
+    --save FILE       write the results as a new baseline
+    --scale           measure the growth exponents instead, see below
+    --max-exponent E  allowed growth exponent of --scale (default 1.2)
+  
+  The baseline is JSON, see save_results. The times are kept in
+  microseconds, since json.c reads integers only. The corpus is written
+  into the bench directory, which must exist.
+  
+  With --scale (make scaling) the assembler is run at geometrically
+  growing sizes along each axis of AXES, and the exponent of the growth of
+  its CPU time is fitted (the slope of log time over log size). An axis
+  whose exponent is over the maximum fails the run, which is how a
+  quadratic lookup sneaking back in gets caught.*/
+
+#define _DEFAULT_SOURCE /*for wait4*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "json.h"
+
+#define ASGEN "./asgen"
+#define BENCH_DIR "bench"
+
+#define MAX_PATH 256
+#define MAX_ARGS 32  /*of a single command*/
+#define MAX_RUNS 101
+
+#define SCALE_START 4000 /*lines of the smallest program of an axis*/
+#define SCALE_STEPS 5    /*sizes of an axis, each twice the previous one*/
+#define SCALE_RUNS 3
+
+typedef struct bench_case {
+    char *name;
+    int files;     /*programs assembled together, in a single run*/
+    char *gen_args; /*for asgen, the seed is added per file*/
+} bench_case;
+
+typedef struct bench_result {
+    long median_us;
+    long lines;
+    long lines_per_sec;
+    long peak_rss_kb; /*the largest of the runs*/
+} bench_result;
+
+static const bench_case CASES[] = {
+    {"small", 1, "--lines 60"},
+    {"medium", 1, "--lines 10000 --labels 1000 --externs 50 --entries 50 "
+                  "--no-mem-cap"},
+    {"huge", 1, "--lines 50000 --labels 5000 --externs 200 --entries 200 "
+                "--no-mem-cap"},
+    {"errors", 1, "--lines 10000 --labels 1000 --externs 50 --entries 50 "
+                  "--errors 10 --no-mem-cap"},
+    {"multi", 8, "--lines 2000 --labels 200 --externs 20 --entries 20 "
+                 "--no-mem-cap"}
+};
+
+#define MAX_CASES ((int)(sizeof(CASES)/sizeof(CASES[0])))
+
+/*an axis of --scale, the programs grow in lines and in the thing the axis
+  is named after*/
+typedef struct scale_axis {
+    char *name;
+    int divisor;    /*the count of the thing is the lines over this*/
+    char *gen_args; /*for asgen, formatted with the lines and the count*/
+} scale_axis;
+
+static const scale_axis AXES[] = {
+    {"labels", 4, "--lines %ld --labels %ld --entries %ld --no-mem-cap"},
+    {"externs", 10, "--lines %ld --externs %ld --labels 100 --no-mem-cap"},
+    {"forward", 4, "--lines %ld --labels %ld --forward 100 --no-mem-cap"},
+    {"errors", 10, "--lines %ld --labels %ld --errors 20 --no-mem-cap"},
+    {"data", 10, "--lines %ld --labels %ld --data 100 --string 0 "
+                 "--struct 0 --no-mem-cap"}
+};
+
+#define MAX_AXES ((int)(sizeof(AXES)/sizeof(AXES[0])))
+
+static bool generate_case(int case_num);
+static bool run_case(const char *assembler, int case_num, int runs,
+                     bench_result *result);
+static bool run_command(char **argv, const char *f_output, long *wall_us,
+                        long *cpu_us, long *rss_kb);
+static int scale(const char *assembler, double max_exponent);
+static bool run_axis_size(const char *assembler, int axis_num, long lines,
+                          long *cpu_us);
+static double fit_exponent(long *sizes, long *times, int count);
+static int split_args(char *str, char **argv, int argc);
+static void get_case_path(int case_num, int file, char *path);
+static long count_lines(const char *filename);
+static int cmp_long(const void *a, const void *b);
+
+static char *read_file(const char *filename);
+static long get_baseline(const char *baseline, const char *name);
+static void save_results(const char *filename, bench_result *results);
+
+static double get_wall_time(void);
+
+int main(int argc, char **argv) {
+    int i;
+    int runs = 5;
+    int threshold = 20;
+    int failed = 0;
+    bool scale_mode = false;
+    double max_exponent = 1.2;
+    long base_us;
+    double change;
+    char *f_baseline = NULL;
+    char *f_save = NULL;
+    char *baseline = NULL;
+    char *assembler = NULL;
+    bench_result results[MAX_CASES];
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i+1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i+1 < argc) {
+            threshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--baseline") == 0 && i+1 < argc) {
+            f_baseline = argv[++i];
+        } else if (strcmp(argv[i], "--save") == 0 && i+1 < argc) {
+            f_save = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0) {
+            scale_mode = true;
+        } else if (strcmp(argv[i], "--max-exponent") == 0 && i+1 < argc) {
+            max_exponent = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && assembler == NULL) {
+            assembler = argv[i];
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (assembler == NULL || runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "Usage: asbench [--runs N] [--threshold P] "
+                        "[--baseline FILE] [--save FILE] [--scale] "
+                        "[--max-exponent E] assembler\n");
+        return 2;
+    }
+    
+    if (scale_mode) {
+        return scale(assembler, max_exponent);
+    }
+    
+    if (f_baseline != NULL && (baseline = read_file(f_baseline)) == NULL) {
+        fprintf(stderr, "Error, can't read the baseline: %s\n", f_baseline);
+        return 2;
+    }
+    
+    printf("%-10s %12s %12s %12s %12s %8s\n", "case", "median (ms)",
+           "lines/sec", "peak RSS kB", "base (ms)", "change");
+    
+    for (i = 0; i < MAX_CASES; i++) {
+        if (!generate_case(i) || !run_case(assembler, i, runs, &results[i])) {
+            fprintf(stderr, "Error, case %s couldn't be run.\n",
+                    CASES[i].name);
+            free(baseline);
+            return 2;
+        }
+        
+        printf("%-10s %12.3f %12ld %12ld", CASES[i].name,
+               results[i].median_us/1000.0, results[i].lines_per_sec,
+               results[i].peak_rss_kb);
+        
+        base_us = (baseline != NULL) ? get_baseline(baseline, CASES[i].name)
+                                     : -1;
+        if (base_us > 0) {
+            change = 100.0*(results[i].median_us - base_us)/base_us;
+            printf(" %12.3f %+7.1f%%", base_us/1000.0, change);
+            
+            if (change > threshold) {
+                printf("  REGRESSION");
+                failed++;
+            }
+        }
+        putchar('\n');
+    }
+    
+    if (f_save != NULL) {
+        save_results(f_save, results);
+    }
+    
+    free(baseline);
+    
+    if (failed > 0) {
+        printf("\n%d case(s) regressed by more than %d%%.\n", failed,
+               threshold);
+        return 1;
+    }
+    
+    return 0;
+}
+
+/*Writes the programs of the case into BENCH_DIR. Returns false if asgen
+  failed.*/
+static bool generate_case(int case_num) {
+    int i;
+    int argc;
+    long wall_us, cpu_us, rss_kb;
+    char gen_args[MAX_PATH];
+    char seed[32];
+    char path[MAX_PATH];
+    char *argv[MAX_ARGS];
+    
+    for (i = 0; i < CASES[case_num].files; i++) {
+        strncpy(gen_args, CASES[case_num].gen_args, MAX_PATH-1);
+        gen_args[MAX_PATH-1] = '\0';
+        
+        /*every file gets its own seed*/
+        sprintf(seed, "%d", case_num*100 + i + 1);
+        argv[0] = ASGEN;
+        argv[1] = "--seed";
+        argv[2] = seed;
+        argc = split_args(gen_args, argv, 3);
+        argv[argc] = NULL;
+        
+        get_case_path(case_num, i, path);
+        strcat(path, ".as");
+        if (!run_command(argv, path, &wall_us, &cpu_us, &rss_kb)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/*Runs the assembler over the case runs times and fills result.*/
+static bool run_case(const char *assembler, int case_num, int runs,
+                     bench_result *result) {
+    int i;
+    long wall_us[MAX_RUNS];
+    long cpu_us, rss_kb;
+    char paths[MAX_ARGS][MAX_PATH];
+    char as_path[MAX_PATH+4]; /*plus the extension*/
+    char *argv[MAX_ARGS];
+    
+    result->lines       = 0;
+    result->peak_rss_kb = 0;
+    
+    argv[0] = (char*)assembler;
+    for (i = 0; i < CASES[case_num].files && i < MAX_ARGS-2; i++) {
+        get_case_path(case_num, i, paths[i]);
+        argv[i+1] = paths[i];
+        
+        sprintf(as_path, "%s.as", paths[i]);
+        result->lines += count_lines(as_path);
+    }
+    argv[i+1] = NULL;
+    
+    /*a warm up run, which isn't counted*/
+    if (!run_command(argv, "/dev/null", &wall_us[0], &cpu_us, &rss_kb)) {
+        return false;
+    }
+    
+    for (i = 0; i < runs; i++) {
+        if (!run_command(argv, "/dev/null", &wall_us[i], &cpu_us, &rss_kb)) {
+            return false;
+        }
+        
+        if (rss_kb > result->peak_rss_kb) {
+            result->peak_rss_kb = rss_kb;
+        }
+    }
+    
+    qsort(wall_us, runs, sizeof(long), &cmp_long);
+    result->median_us = wall_us[runs/2];
+    result->lines_per_sec = (result->median_us > 0) ?
+                            (long)(result->lines * 1e6 / result->median_us) :
+                            0;
+    
+    return true;
+}
+
+/*Runs the command argv with its stdout (and stderr) going to f_output,
+  and waits for it. The wall time, the CPU time (user and system) and the
+  peak RSS of the command are written into *wall_us, *cpu_us and *rss_kb.
+  Returns false if it couldn't be run or was killed (the assembler's own
+  exit status is no concern of ours).*/
+static bool run_command(char **argv, const char *f_output, long *wall_us,
+                        long *cpu_us, long *rss_kb) {
+    int fd;
+    int status;
+    pid_t pid;
+    double start;
+    struct rusage usage;
+    
+    start = get_wall_time();
+    
+    if ((pid = fork()) < 0) {
+        return false;
+    } else if (pid == 0) {
+        fd = open(f_output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            _exit(127);
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+        
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        return false;
+    }
+    
+    *wall_us = (long)((get_wall_time() - start) * 1e6);
+    *cpu_us  = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L +
+               usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    *rss_kb  = usage.ru_maxrss;
+    
+    return WIFEXITED(status) && WEXITSTATUS(status) != 127;
+}
+
+/*Runs every axis of AXES and prints the times and the fitted exponents.
+  Returns the exit status: 1 if an exponent is over max_exponent.*/
+static int scale(const char *assembler, double max_exponent) {
+    int i, step;
+    int failed = 0;
+    long lines;
+    long sizes[SCALE_STEPS];
+    long times[SCALE_STEPS];
+    double exponent;
+    
+    printf("%-10s", "axis");
+    for (step = 0, lines = SCALE_START; step < SCALE_STEPS;
+         step++, lines *= 2) {
+        printf(" %9ld", lines);
+    }
+    printf(" %9s\n", "exponent");
+    
+    for (i = 0; i < MAX_AXES; i++) {
+        printf("%-10s", AXES[i].name);
+        fflush(stdout);
+        
+        for (step = 0, lines = SCALE_START; step < SCALE_STEPS;
+             step++, lines *= 2) {
+            sizes[step] = lines;
+            if (!run_axis_size(assembler, i, lines, &times[step])) {
+                fprintf(stderr, "\nError, axis %s couldn't be run.\n",
+                        AXES[i].name);
+                return 2;
+            }
+            
+            printf(" %7.1fms", times[step]/1000.0);
+            fflush(stdout);
+        }
+        
+        exponent = fit_exponent(sizes, times, SCALE_STEPS);
+        printf(" %9.2f", exponent);
+        
+        if (exponent > max_exponent) {
+            printf("  NONLINEAR");
+            failed++;
+        }
+        putchar('\n');
+    }
+    
+    if (failed > 0) {
+        printf("\n%d axis(es) grew faster than n^%.2f.\n", failed,
+               max_exponent);
+        return 1;
+    }
+    
+    return 0;
+}
+
+/*Generates the program of the axis with the given lines, and writes the
+  median CPU time of the assembler over it into *cpu_us.*/
+static bool run_axis_size(const char *assembler, int axis_num, long lines,
+                          long *cpu_us) {
+    int i;
+    int argc;
+    long count = lines / AXES[axis_num].divisor;
+    long wall_us, rss_kb;
+    long runs_us[SCALE_RUNS];
+    char gen_args[MAX_PATH];
+    char path[MAX_PATH];
+    char as_path[MAX_PATH+4]; /*plus the extension*/
+    char *argv[MAX_ARGS];
+    
+    sprintf(path, "%s/scale_%s", BENCH_DIR, AXES[axis_num].name);
+    sprintf(as_path, "%s.as", path);
+    sprintf(gen_args, AXES[axis_num].gen_args, lines, count, count);
+    
+    argv[0] = ASGEN;
+    argc = split_args(gen_args, argv, 1);
+    argv[argc] = NULL;
+    if (!run_command(argv, as_path, &wall_us, &runs_us[0], &rss_kb)) {
+        return false;
+    }
+    
+    argv[0] = (char*)assembler;
+    argv[1] = path;
+    argv[2] = NULL;
+    for (i = 0; i < SCALE_RUNS; i++) {
+        if (!run_command(argv, "/dev/null", &wall_us, &runs_us[i],
+                         &rss_kb)) {
+            return false;
+        }
+    }
+    
+    qsort(runs_us, SCALE_RUNS, sizeof(long), &cmp_long);
+    *cpu_us = runs_us[SCALE_RUNS/2];
+    
+    return true;
+}
+
+/*Least squares fit of log(times) = exponent*log(sizes) + c. Returns the
+  exponent. A zero time (under the clock's resolution) counts as 1us.*/
+static double fit_exponent(long *sizes, long *times, int count) {
+    int i;
+    double x, y;
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    
+    for (i = 0; i < count; i++) {
+        x = log((double)sizes[i]);
+        y = log((double)((times[i] > 0) ? times[i] : 1));
+        
+        sum_x  += x;
+        sum_y  += y;
+        sum_xx += x*x;
+        sum_xy += x*y;
+    }
+    
+    return (count*sum_xy - sum_x*sum_y) / (count*sum_xx - sum_x*sum_x);
+}
+
+/*Splits str at the spaces into argv, starting at argv[argc]. Returns the
+  new argc. str is modified.*/
+static int split_args(char *str, char **argv, int argc) {
+    char *arg;
+    
+    for (arg = strtok(str, " "); arg != NULL && argc < MAX_ARGS-1;
+         arg = strtok(NULL, " ")) {
+        argv[argc++] = arg;
+    }
+    
+    return argc;
+}
+
+/*Writes the path of the file of the case, without the extension.*/
+static void get_case_path(int case_num, int file, char *path) {
+    sprintf(path, "%s/%s_%d", BENCH_DIR, CASES[case_num].name, file);
+}
+
+/*Returns the amount of lines in the file, 0 if it can't be read.*/
+static long count_lines(const char *filename) {
+    int ch;
+    long lines = 0;
+    FILE *f_input = fopen(filename, "r");
+    
+    if (f_input == NULL) {
+        return 0;
+    }
+    
+    while ((ch = getc(f_input)) != EOF) {
+        if (ch == '\n') {
+            lines++;
+        }
+    }
+    
+    fclose(f_input);
+    
+    return lines;
+}
+
+/*For qsort.*/
+static int cmp_long(const void *a, const void *b) {
+    long x = *(const long*)a;
+    long y = *(const long*)b;
+    
+    return (x > y) - (x < y);
+}
+
+/*Returns the contents of the file as a malloc'd string, NULL if it can't
+  be read.*/
+static char *read_file(const char *filename) {
+    long length;
+    char *text;
+    FILE *f_input = fopen(filename, "rb");
+    
+    if (f_input == NULL) {
+        return NULL;
+    }
+    
+    fseek(f_input, 0, SEEK_END);
+    length = ftell(f_input);
+    rewind(f_input);
+    
+    text = malloc(sizeof(char)*(length+1));
+    if (text == NULL) {
+        fprintf(stderr, "Malloc failure in read_file.");
+        exit(1);
+    }
+    
+    length = fread(text, 1, length, f_input);
+    text[length] = '\0';
+    fclose(f_input);
+    
+    return text;
+}
+
+/*Returns the median_us of the case name in the baseline, -1 if it's not
+  there.*/
+static long get_baseline(const char *baseline, const char *name) {
+    long median_us;
+    char *case_name;
+    const char *elem;
+    bool found;
+    
+    for (elem = json_array_first(json_get(baseline, "cases")); elem != NULL;
+         elem = json_array_next(elem)) {
+        case_name = json_get_string(json_get(elem, "name"));
+        found = (case_name != NULL && strcmp(case_name, name) == 0);
+        mem_free(case_name);
+        
+        if (found && json_get_int(json_get(elem, "median_us"), &median_us)) {
+            return median_us;
+        }
+    }
+    
+    return -1;
+}
+
+/*Writes the results in the baseline format:
+  {"cases": [{"name": ..., "median_us": ..., "lines": ...,
+              "lines_per_sec": ..., "peak_rss_kb": ...}, ...]}*/
+static void save_results(const char *filename, bench_result *results) {
+    int i;
+    FILE *f_out = fopen(filename, "w");
+    
+    if (f_out == NULL) {
+        fprintf(stderr, "Error, can't write the results: %s\n", filename);
+        return;
+    }
+    
+    fprintf(f_out, "{\n  \"cases\": [\n");
+    for (i = 0; i < MAX_CASES; i++) {
+        fprintf(f_out, "    {\"name\": ");
+        json_fput_string(CASES[i].name, f_out);
+        fprintf(f_out, ", \"median_us\": %ld, \"lines\": %ld, "
+                       "\"lines_per_sec\": %ld, \"peak_rss_kb\": %ld}%s\n",
+                results[i].median_us, results[i].lines,
+                results[i].lines_per_sec, results[i].peak_rss_kb,
+                (i < MAX_CASES-1) ? "," : "");
+    }
+    fprintf(f_out, "  ]\n}\n");
+    
+    fclose(f_out);
+}
+
+/*Returns the monotonic time in seconds.*/
+static double get_wall_time(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
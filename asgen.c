@@ -0,0 +1,604 @@
+/*Generator of synthetic assembly programs, for load testing the assembler.
+  The program is written to stdout and depends only on the options and the
+  seed (the random numbers come from our own LCG, not from rand()).
+  
+  Usage: asgen [options] > program.as
+  
+  Options (all take a number, as --option N or --option=N):
+    --seed N         seed of the generator (default 1)
+    --lines N        statements to generate (default 100)
+    --labels N       labels, spread evenly over the statements (default
+                     a tenth of the lines)
+    --forward P      percent of the label references that point forward
+                     (default 50)
+    --externs N      externs to declare, each one is used (default 2)
+    --entries N      labels to declare as entries (default 2)
+    --data P         percent of the statements that are .data (default 10)
+    --string P       percent of the statements that are .string (default 5)
+    --struct P       percent of the statements that are .struct (default 5)
+    --struct-opds P  percent of the label operands that access a struct
+                     field (default 20)
+    --errors P       percent of the statements with a seeded error
+                     (default 0). Note that an error may take a label down
+                     with it, so the count of reported errors may be higher.
+    --no-mem-cap     don't stop at the machine memory (256 words, IC starts
+                     at 100), to stress the assembler's algorithms. The
+                     assembler reports the overflow once and goes on.
+  
+  The program is built in two steps. First the statements are laid out
+  (kinds, operators, addressing modes, and so the sizes - which is where
+  the memory cap is enforced), then the label operands get their targets,
+  since only then it's known which labels exist.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "token.h"
+
+#define MEM_WORDS (256-100) /*machine memory minus the initial IC*/
+
+#define MAX_DATA_NUMS 5    /*numbers in a .data*/
+#define MAX_STRING_LENGTH 10
+#define EXTERN_REF_RATIO 10 /*percent of the references that go to externs,
+                              once all the externs were used*/
+
+#define IMM_MIN (-128)
+#define IMM_MAX 127
+#define DATA_MIN (-512)
+#define DATA_MAX 511
+#define MAX_REG 7
+
+/*kinds of the generated statements*/
+typedef enum {
+    gen_instr,
+    gen_data,
+    gen_string,
+    gen_struct
+} gen_kind;
+
+/*seeded errors*/
+typedef enum {
+    generr_none,
+    generr_extra_opd, /*an extraneous operand*/
+    generr_undef,     /*reference to an undeclared label*/
+    generr_register,  /*register r8*/
+    generr_bounds     /*number out of bounds*/
+} gen_error;
+
+typedef struct gen_opd {
+    add_mode addmode;
+    int value;  /*number, register or struct field*/
+    int target; /*label number, or -1-n for extern n (see set_targets)*/
+} gen_opd;
+
+typedef struct gen_stat {
+    gen_kind kind;
+    int opcode;
+    int opds;
+    gen_opd src;  /*only if opds is 2*/
+    gen_opd dst;  /*only if opds is 1 or 2*/
+    int length;   /*numbers in .data, chars in .string and .struct*/
+    int label;    /*label number, -1 if none*/
+    gen_error error;
+} gen_stat;
+
+typedef struct gen_opts {
+    unsigned long seed;
+    long lines;
+    long labels;
+    int forward;
+    int externs;
+    int entries;
+    int data;
+    int string;
+    int structure;
+    int struct_opds;
+    int errors;
+    int mem_cap; /*0 with --no-mem-cap*/
+} gen_opts;
+
+static int parse_gen_options(int argc, char **argv, gen_opts *opts);
+static bool is_option(const char *arg, const char *name);
+static long get_number_arg(int argc, char **argv, int *i, long max);
+
+static long lay_out(gen_stat *stats, gen_opts *opts);
+static int lay_out_instr(gen_stat *stat, gen_opts *opts, bool has_targets);
+static int lay_out_opd(gen_opd *opd, const int *valid_modes,
+                       gen_opts *opts, bool has_targets);
+static void set_targets(gen_stat *stats, long count, gen_opts *opts,
+                        int *externs_used);
+static void set_target(gen_opd *opd, long next_label, long labels,
+                       gen_opts *opts, int *externs_used);
+
+static void print_program(gen_stat *stats, long count, gen_opts *opts,
+                          int externs_used);
+static void print_stat(gen_stat *stat);
+static void print_opd(gen_opd *opd, bool undef);
+
+static long gen_rand(long n);
+static int gen_rand_range(int min, int max);
+static bool gen_chance(int percent);
+
+static unsigned long gen_seed;
+
+int main(int argc, char **argv) {
+    gen_opts opts;
+    gen_stat *stats;
+    long count;
+    int externs_used = 0;
+    
+    if (parse_gen_options(argc, argv, &opts) < 0) {
+        return 1;
+    }
+    
+    gen_seed = opts.seed;
+    
+    stats = malloc(sizeof(gen_stat)*(opts.lines > 0 ? opts.lines : 1));
+    if (stats == NULL) {
+        fprintf(stderr, "Malloc failure in main.");
+        exit(1);
+    }
+    
+    count = lay_out(stats, &opts);
+    set_targets(stats, count, &opts, &externs_used);
+    print_program(stats, count, &opts, externs_used);
+    
+    free(stats);
+    
+    return 0;
+}
+
+/*Fills opts from argv. Returns -1 (and prints an error) upon an unknown
+  option or a bad number.*/
+static int parse_gen_options(int argc, char **argv, gen_opts *opts) {
+    int i;
+    bool labels_set = false;
+    long num = 0;
+    
+    opts->seed        = 1;
+    opts->lines       = 100;
+    opts->labels      = 10;
+    opts->forward     = 50;
+    opts->externs     = 2;
+    opts->entries     = 2;
+    opts->data        = 10;
+    opts->string      = 5;
+    opts->structure   = 5;
+    opts->struct_opds = 20;
+    opts->errors      = 0;
+    opts->mem_cap     = MEM_WORDS;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-mem-cap") == 0) {
+            opts->mem_cap = 0;
+            continue;
+        }
+        
+        /*the rest take a number*/
+        if (is_option(argv[i], "--seed")) {
+            num = get_number_arg(argc, argv, &i, 0x7fffffffL);
+            opts->seed = num;
+        } else if (is_option(argv[i], "--lines")) {
+            num = opts->lines = get_number_arg(argc, argv, &i, 0x7fffffffL);
+        } else if (is_option(argv[i], "--labels")) {
+            num = opts->labels = get_number_arg(argc, argv, &i, 0x7fffffffL);
+            labels_set = true;
+        } else if (is_option(argv[i], "--forward")) {
+            num = opts->forward = get_number_arg(argc, argv, &i, 100);
+        } else if (is_option(argv[i], "--externs")) {
+            num = opts->externs = get_number_arg(argc, argv, &i, 100000);
+        } else if (is_option(argv[i], "--entries")) {
+            num = opts->entries = get_number_arg(argc, argv, &i, 100000);
+        } else if (is_option(argv[i], "--data")) {
+            num = opts->data = get_number_arg(argc, argv, &i, 100);
+        } else if (is_option(argv[i], "--string")) {
+            num = opts->string = get_number_arg(argc, argv, &i, 100);
+        } else if (is_option(argv[i], "--struct")) {
+            num = opts->structure = get_number_arg(argc, argv, &i, 100);
+        } else if (is_option(argv[i], "--struct-opds")) {
+            num = opts->struct_opds = get_number_arg(argc, argv, &i, 100);
+        } else if (is_option(argv[i], "--errors")) {
+            num = opts->errors = get_number_arg(argc, argv, &i, 100);
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return -1;
+        }
+        
+        if (num < 0) {
+            return -1;
+        }
+    }
+    
+    if (opts->data + opts->string + opts->structure > 100) {
+        fprintf(stderr, "Error, --data, --string and --struct add up "
+                        "to more than 100 percent.\n");
+        return -1;
+    }
+    
+    if (!labels_set) {
+        opts->labels = opts->lines/10;
+    }
+    if (opts->labels > opts->lines) {
+        opts->labels = opts->lines;
+    }
+    
+    return 0;
+}
+
+/*Returns true if arg is the option name, possibly followed by =N.*/
+static bool is_option(const char *arg, const char *name) {
+    int length = strlen(name);
+    
+    return strncmp(arg, name, length) == 0 &&
+           (arg[length] == '\0' || arg[length] == '=');
+}
+
+/*Reads the number of the option argv[*i], either given as --option=N or
+  as --option N (in which case *i is advanced past N). Returns -1 and
+  prints an error if it's missing, malformed or not within 0 and max.*/
+static long get_number_arg(int argc, char **argv, int *i, long max) {
+    long num;
+    char *end;
+    char *arg = strchr(argv[*i], '=');
+    
+    if (arg != NULL) {
+        arg++;
+    } else if (*i+1 < argc) {
+        arg = argv[++(*i)];
+    } else {
+        fprintf(stderr, "Error, %s expects a number.\n", argv[*i]);
+        return -1;
+    }
+    
+    num = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || num < 0 || num > max) {
+        fprintf(stderr, "Error, invalid number: %s\n", arg);
+        return -1;
+    }
+    
+    return num;
+}
+
+/*The first step: kinds, operators, addressing modes, lengths, labels and
+  errors of the statements. Returns the amount of statements, which is
+  less than opts->lines if the memory cap was reached.*/
+static long lay_out(gen_stat *stats, gen_opts *opts) {
+    long i;
+    long words = 0;
+    long size;
+    long label = 0;
+    int kind_roll;
+    bool has_targets = (opts->labels > 0 || opts->externs > 0);
+    gen_stat *stat;
+    
+    for (i = 0; i < opts->lines; i++) {
+        stat = &stats[i];
+        
+        kind_roll = gen_rand(100);
+        if (kind_roll < opts->data) {
+            stat->kind   = gen_data;
+            stat->length = gen_rand_range(1, MAX_DATA_NUMS);
+            size = stat->length;
+        } else if (kind_roll < opts->data + opts->string) {
+            stat->kind   = gen_string;
+            stat->length = gen_rand_range(1, MAX_STRING_LENGTH);
+            size = stat->length+1;
+        } else if (kind_roll < opts->data + opts->string + opts->structure) {
+            stat->kind   = gen_struct;
+            stat->length = gen_rand_range(1, MAX_STRING_LENGTH);
+            size = stat->length+2;
+        } else {
+            stat->kind = gen_instr;
+            size = lay_out_instr(stat, opts, has_targets);
+        }
+        
+        if (opts->mem_cap > 0 && words + size > opts->mem_cap) {
+            break;
+        }
+        words += size;
+        
+        /*spread evenly, and the first statement always has one*/
+        if (label < opts->labels &&
+            (double)i*opts->labels >= (double)label*opts->lines) {
+            stat->label = label++;
+        } else {
+            stat->label = -1;
+        }
+        
+        stat->error = generr_none;
+        if (opts->errors > 0 && gen_chance(opts->errors)) {
+            stat->error = generr_extra_opd + gen_rand(4);
+        }
+    }
+    
+    return i;
+}
+
+/*Lays out the instruction. Returns its size in words.*/
+static int lay_out_instr(gen_stat *stat, gen_opts *opts, bool has_targets) {
+    int size = 1;
+    
+    /*without any labels or externs, lea has no valid source*/
+    do {
+        stat->opcode = gen_rand(OP_STOP+1);
+    } while (stat->opcode == OP_LEA && !has_targets);
+    
+    stat->opds = OPS[stat->opcode].opds;
+    
+    if (stat->opds == 2) {
+        size += lay_out_opd(&stat->src, OPS[stat->opcode].src_mode,
+                            opts, has_targets);
+    }
+    if (stat->opds >= 1) {
+        size += lay_out_opd(&stat->dst, OPS[stat->opcode].dst_mode,
+                            opts, has_targets);
+    }
+    
+    /*two registers share a word*/
+    if (stat->opds == 2 && stat->src.addmode == addmode_reg &&
+        stat->dst.addmode == addmode_reg) {
+        size--;
+    }
+    
+    return size;
+}
+
+/*Picks the addressing mode and the value of the operand. Returns its
+  size in words.*/
+static int lay_out_opd(gen_opd *opd, const int *valid_modes,
+                       gen_opts *opts, bool has_targets) {
+    int mode;
+    
+    opd->target = 0;
+    
+    if (has_targets && valid_modes[addmode_struct] &&
+        gen_chance(opts->struct_opds)) {
+        opd->addmode = addmode_struct;
+    } else {
+        do {
+            mode = gen_rand(MAX_ADD_MODES);
+        } while (!valid_modes[mode] || mode == addmode_struct ||
+                 (mode == addmode_dir && !has_targets));
+        opd->addmode = mode;
+    }
+    
+    switch (opd->addmode) {
+        case addmode_imm:
+            opd->value = gen_rand_range(IMM_MIN, IMM_MAX);
+            return 1;
+        case addmode_dir:
+            return 1;
+        case addmode_struct:
+            opd->value = gen_rand_range(1, 2);
+            return 2;
+        case addmode_reg:
+            opd->value = gen_rand_range(0, MAX_REG);
+            return 1;
+    }
+    
+    return 1;
+}
+
+/*The second step: points the label operands at the labels that were
+  laid out, or at the externs. Every extern (up to opts->externs) gets
+  used before the rest of the extern references are left to chance, and
+  *externs_used is set to the amount of externs referenced.*/
+static void set_targets(gen_stat *stats, long count, gen_opts *opts,
+                        int *externs_used) {
+    long i;
+    long labels = 0;
+    long next_label = 0; /*the first label after the current statement*/
+    
+    for (i = 0; i < count; i++) {
+        if (stats[i].label >= 0) {
+            labels++;
+        }
+    }
+    
+    for (i = 0; i < count; i++) {
+        if (stats[i].label >= 0) {
+            next_label = stats[i].label+1;
+        }
+        
+        if (stats[i].kind != gen_instr) {
+            continue;
+        }
+        
+        if (stats[i].opds == 2) {
+            set_target(&stats[i].src, next_label, labels, opts,
+                       externs_used);
+        }
+        if (stats[i].opds >= 1) {
+            set_target(&stats[i].dst, next_label, labels, opts,
+                       externs_used);
+        }
+    }
+}
+
+/*Points the operand at a label or an extern, if it's a label operand.*/
+static void set_target(gen_opd *opd, long next_label, long labels,
+                       gen_opts *opts, int *externs_used) {
+    bool forward;
+    
+    if (opd->addmode != addmode_dir && opd->addmode != addmode_struct) {
+        return;
+    }
+    
+    /*externs*/
+    if (*externs_used < opts->externs) {
+        opd->target = -1 - (*externs_used)++;
+        return;
+    } else if (labels == 0 ||
+               (*externs_used > 0 && gen_chance(EXTERN_REF_RATIO))) {
+        opd->target = -1 - gen_rand(*externs_used);
+        return;
+    }
+    
+    /*labels, the forward ones are next_label and on*/
+    forward = gen_chance(opts->forward);
+    if ((forward && next_label < labels) || next_label == 0) {
+        opd->target = next_label + gen_rand(labels - next_label);
+    } else {
+        opd->target = gen_rand(next_label);
+    }
+}
+
+/*Prints the whole program to stdout.*/
+static void print_program(gen_stat *stats, long count, gen_opts *opts,
+                          int externs_used) {
+    long i;
+    long labels = 0;
+    int entry = 0;
+    
+    printf("; asgen --seed %lu, %ld statements\n", opts->seed, count);
+    
+    for (i = 0; i < externs_used; i++) {
+        printf(".extern X%ld\n", i);
+    }
+    
+    for (i = 0; i < count; i++) {
+        print_stat(&stats[i]);
+        if (stats[i].label >= 0) {
+            labels++;
+        }
+    }
+    
+    /*entries spread over the labels as well*/
+    for (entry = 0; entry < opts->entries && entry < labels; entry++) {
+        printf(".entry L%ld\n", entry*labels/opts->entries);
+    }
+}
+
+/*Prints the statement, with its seeded error.*/
+static void print_stat(gen_stat *stat) {
+    int i;
+    gen_error error = stat->error;
+    
+    if (stat->label >= 0) {
+        printf("L%d: ", stat->label);
+    } else {
+        putchar('\t');
+    }
+    
+    switch (stat->kind) {
+        case gen_data:
+            printf(".data ");
+            for (i = 0; i < stat->length; i++) {
+                printf(i > 0 ? ", %d" : "%d",
+                       (error == generr_bounds && i == 0) ? DATA_MAX+1 :
+                       gen_rand_range(DATA_MIN, DATA_MAX));
+            }
+            if (error == generr_extra_opd || error == generr_undef ||
+                error == generr_register) {
+                printf(", r1");
+            }
+            break;
+        case gen_string:
+        case gen_struct:
+            if (stat->kind == gen_struct) {
+                printf(".struct %d, \"", error == generr_bounds ? DATA_MAX+1 :
+                       gen_rand_range(DATA_MIN, DATA_MAX));
+            } else {
+                printf(".string \"");
+            }
+            for (i = 0; i < stat->length; i++) {
+                putchar('a' + gen_rand(26));
+            }
+            /*the errors other than bounds leave the string open*/
+            if (error == generr_none ||
+                (error == generr_bounds && stat->kind == gen_struct)) {
+                putchar('"');
+            }
+            break;
+        case gen_instr:
+            printf("%s", OPS[stat->opcode].opname);
+            
+            /*the errors that need an operand of a certain kind fall back
+              to an extraneous operand*/
+            if ((error == generr_undef &&
+                 (stat->opds == 0 || (stat->dst.addmode != addmode_dir &&
+                                      stat->dst.addmode != addmode_struct))) ||
+                (error == generr_register &&
+                 (stat->opds == 0 || stat->dst.addmode != addmode_reg)) ||
+                (error == generr_bounds &&
+                 (stat->opds == 0 || stat->dst.addmode != addmode_imm))) {
+                error = generr_extra_opd;
+            }
+            
+            if (stat->opds == 2) {
+                putchar(' ');
+                print_opd(&stat->src, false);
+                putchar(',');
+            }
+            if (stat->opds >= 1) {
+                putchar(' ');
+                if (error == generr_register) {
+                    printf("r8");
+                } else if (error == generr_bounds) {
+                    printf("#%d", IMM_MAX+1);
+                } else {
+                    print_opd(&stat->dst, error == generr_undef);
+                }
+            }
+            if (error == generr_extra_opd) {
+                printf(stat->opds == 0 ? " r1" : ", r1");
+            }
+            break;
+    }
+    
+    putchar('\n');
+}
+
+/*Prints the operand. If undef is true, a label operand names an
+  undeclared label instead of its target.*/
+static void print_opd(gen_opd *opd, bool undef) {
+    switch (opd->addmode) {
+        case addmode_imm:
+            printf("#%d", opd->value);
+            break;
+        case addmode_reg:
+            printf("r%d", opd->value);
+            break;
+        case addmode_dir:
+        case addmode_struct:
+            if (undef) {
+                printf("U%d", opd->target < 0 ? -opd->target : opd->target);
+            } else if (opd->target < 0) {
+                printf("X%d", -1 - opd->target);
+            } else {
+                printf("L%d", opd->target);
+            }
+            
+            if (opd->addmode == addmode_struct) {
+                printf(".%d", opd->value);
+            }
+            break;
+    }
+}
+
+/*Returns a pseudo random number in [0, n), n > 0. This is the LCG from the
+  C standard's example rand(), so that the output is the same on every
+  platform. Two of its 15 bit outputs make up a number, since there may
+  be more than 32768 labels.*/
+static long gen_rand(long n) {
+    long num;
+    
+    gen_seed = (gen_seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+    num = (gen_seed >> 16) & 0x7fff;
+    gen_seed = (gen_seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+    num = (num << 15) | ((gen_seed >> 16) & 0x7fff);
+    
+    return num % n;
+}
+
+/*Returns a pseudo random number in [min, max].*/
+static int gen_rand_range(int min, int max) {
+    return min + gen_rand(max - min + 1);
+}
+
+/*Returns true with the given percent of chance.*/
+static bool gen_chance(int percent) {
+    return gen_rand(100) < percent;
+}
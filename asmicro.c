@@ -0,0 +1,421 @@
+/*Microbenchmarks of the hot functions of the assembler, run by make micro.
+  Each benchmark calls a single function over the lines (or the tokens,
+  statements or words) of a program generated by asgen, so the inputs have
+  the distribution of a real program, but nothing else of the run gets in
+  the way. The time and the allocations per call are reported.
+  
+  Usage: asmicro [--ops N] program.as
+  
+  Options:
+    --ops N   calls of each function, at least (default 1000000)
+  
+  The calls are made in batches, a batch being a pass over all the inputs
+  of the benchmark. Whatever has to be undone between the batches (the
+  code assembled by assm_stat_instr) is undone outside of the timing.*/
+
+#define _POSIX_C_SOURCE 199309L /*for clock_gettime*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "clist.h"
+#include "token.h"
+#include "statement.h"
+#include "filedata.h"
+#include "lexer.h"
+#include "parser.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
+#include "assm_driver.h"
+
+#define MAX_WORD 1024 /*2^10, all the machine words*/
+
+typedef struct micro_bench {
+    char *name;
+    long (*run_batch)(void); /*returns the calls made*/
+    void (*reset)(void);     /*after every batch, untimed, or NULL*/
+} micro_bench;
+
+static long bench_tokenize_line(void);
+static long bench_get_toktype(void);
+static long bench_is_valid_identifier(void);
+static long bench_parse_line(void);
+static long bench_assm_stat_instr(void);
+static void reset_assm_stat_instr(void);
+static long bench_output_weird(void);
+static long bench_get_weird(void);
+
+static const micro_bench BENCHES[] = {
+    {"tokenize_line", &bench_tokenize_line, NULL},
+    {"get_toktype", &bench_get_toktype, NULL},
+    {"is_valid_identifier", &bench_is_valid_identifier, NULL},
+    {"parse_line", &bench_parse_line, NULL},
+    {"assm_stat_instr", &bench_assm_stat_instr, &reset_assm_stat_instr},
+    {"output_weird", &bench_output_weird, NULL},
+    {"get_weird", &bench_get_weird, NULL}
+};
+
+#define MAX_BENCHES ((int)(sizeof(BENCHES)/sizeof(BENCHES[0])))
+
+/*the inputs, prepared by load_program*/
+static char (*lines)[MAX_LINE];
+static c_list **line_tokens; /*the tokens of every line*/
+static int line_count;
+static token **tokens;       /*all of them, without the EOL tokens*/
+static int token_count;
+static stat_instr_t **instrs;
+static int instr_count;
+
+/*state of the benchmarks*/
+static file_data lex_dat;   /*stays empty*/
+static assm_t lex_assm;
+static file_data parse_dat; /*stays empty, so nothing is redefined*/
+static assm_t parse_assm;
+static file_data assm_dat;  /*has the symbols of the program*/
+static assm_t assm;
+static unsigned int assm_IC;
+static FILE *f_null;
+
+static volatile long sink; /*keeps the results from being optimized out*/
+
+static bool load_program(const char *filename);
+static void free_program(void);
+static void run_bench(const micro_bench *bench, long ops);
+static double get_wall_time(void);
+
+int main(int argc, char **argv) {
+    int i;
+    long ops = 1000000;
+    char *filename = NULL;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ops") == 0 && i+1 < argc) {
+            ops = atol(argv[++i]);
+        } else if (argv[i][0] != '-' && filename == NULL) {
+            filename = argv[i];
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (filename == NULL || ops < 1) {
+        fprintf(stderr, "Usage: asmicro [--ops N] program.as\n");
+        return 2;
+    }
+    
+    ALLOC_STATS = true;
+    
+    if ((f_null = fopen("/dev/null", "w")) == NULL) {
+        fprintf(stderr, "Error, can't open /dev/null.\n");
+        return 2;
+    }
+    
+    if (!load_program(filename)) {
+        fprintf(stderr, "Error, can't read the program: %s\n", filename);
+        fclose(f_null);
+        return 2;
+    }
+    
+    printf("%d lines, %d tokens, %d instructions\n\n", line_count,
+           token_count, instr_count);
+    printf("%-20s %12s %12s %12s\n", "function", "ns/op", "allocs/op",
+           "ops");
+    
+    for (i = 0; i < MAX_BENCHES; i++) {
+        run_bench(&BENCHES[i], ops);
+    }
+    
+    free_program();
+    fclose(f_null);
+    
+    return 0;
+}
+
+/*Reads the lines of the program, and prepares the tokens and the
+  instruction statements the way the first pass would. The labels,
+  entries and externs are defined in assm_dat, for assm_stat_instr.*/
+static bool load_program(const char *filename) {
+    int i;
+    int capacity = 1024;
+    void *statement;
+    line_data lindat;
+    c_list *cur_node;
+    line_ret lineret;
+    FILE *f_input = fopen(filename, "r");
+    
+    if (f_input == NULL) {
+        return false;
+    }
+    
+    lines = malloc(sizeof(*lines)*capacity);
+    if (lines == NULL) {
+        fprintf(stderr, "Malloc failure in load_program.");
+        exit(1);
+    }
+    
+    line_count = 0;
+    while (!0) {
+        if (line_count == capacity) {
+            capacity *= 2;
+            lines = realloc(lines, sizeof(*lines)*capacity);
+            if (lines == NULL) {
+                fprintf(stderr, "Malloc failure in load_program.");
+                exit(1);
+            }
+        }
+        
+        init_string(lines[line_count], MAX_LINE);
+        lineret = get_line(f_input, MAX_LINE, lines[line_count]);
+        if (lineret == line_EOF) {
+            break;
+        } else if (lineret == line_ok &&
+                   !is_comment_or_empty_line(lines[line_count])) {
+            line_count++;
+        }
+    }
+    fclose(f_input);
+    
+    init_run_assm(&lex_dat, &lex_assm);
+    init_run_assm(&parse_dat, &parse_assm);
+    init_run_assm(&assm_dat, &assm);
+    
+    line_tokens = malloc(sizeof(c_list*)*line_count);
+    tokens = malloc(sizeof(token*)*line_count*MAX_LINE);
+    instrs = malloc(sizeof(stat_instr_t*)*line_count);
+    if (line_tokens == NULL || tokens == NULL || instrs == NULL) {
+        fprintf(stderr, "Malloc failure in load_program.");
+        exit(1);
+    }
+    
+    token_count = 0;
+    instr_count = 0;
+    for (i = 0; i < line_count; i++) {
+        assm_dat.linenum++;
+        assm_dat.last_token   = NULL;
+        assm_dat.current_line = lines[i];
+        tokenize_line(&assm_dat);
+        line_tokens[i] = assm_dat.last_token;
+        if (line_tokens[i] == NULL) {
+            continue;
+        }
+        
+        cur_node = line_tokens[i]->next;
+        do {
+            if (((token*)cur_node->item)->toktype != toktype_EOL) {
+                tokens[token_count++] = cur_node->item;
+            }
+            cur_node = cur_node->next;
+        } while (cur_node != line_tokens[i]->next);
+        
+        lindat.label_token        = NULL;
+        lindat.label_error        = false;
+        lindat.valid_label        = false;
+        lindat.has_initial_wspace = false;
+        lindat.stype              = stype_unknown;
+        
+        statement = parse_line(&lindat, &assm_dat);
+        define_line_symbols(statement, &lindat, &assm_dat);
+        
+        if (statement != NULL && lindat.stype == stype_instruction) {
+            instrs[instr_count++] = statement;
+        } else {
+            destroy_statement(statement, lindat.stype);
+        }
+    }
+    
+    assm_dat.last_token = NULL;
+    assm_IC = assm_dat.IC;
+    
+    return true;
+}
+
+/*Frees what load_program prepared.*/
+static void free_program(void) {
+    int i;
+    
+    for (i = 0; i < instr_count; i++) {
+        destroy_statement(instrs[i], stype_instruction);
+    }
+    
+    for (i = 0; i < line_count; i++) {
+        destroy_clist(&line_tokens[i], &destroy_clist_token);
+    }
+    
+    destroy_run_assm(&assm_dat, &assm);
+    destroy_run_assm(&parse_dat, &parse_assm);
+    destroy_run_assm(&lex_dat, &lex_assm);
+    
+    free(instrs);
+    free(tokens);
+    free(line_tokens);
+    free(lines);
+}
+
+/*Runs batches of the benchmark until ops calls were made, and prints the
+  time and the allocations per call.*/
+static void run_bench(const micro_bench *bench, long ops) {
+    long calls = 0;
+    long batch_calls;
+    long allocs = 0;
+    long prev_allocs;
+    double time = 0;
+    double start;
+    
+    while (calls < ops) {
+        prev_allocs = get_alloc_count();
+        start = get_wall_time();
+        
+        batch_calls = (*bench->run_batch)();
+        
+        time   += get_wall_time() - start;
+        allocs += get_alloc_count() - prev_allocs;
+        
+        if (bench->reset != NULL) {
+            (*bench->reset)();
+        }
+        
+        if (batch_calls == 0) { /*no inputs for this one*/
+            break;
+        }
+        calls += batch_calls;
+    }
+    
+    if (calls == 0) {
+        printf("%-20s %12s %12s %12d\n", bench->name, "-", "-", 0);
+        return;
+    }
+    
+    printf("%-20s %12.1f %12.2f %12ld\n", bench->name, time*1e9/calls,
+           (double)allocs/calls, calls);
+}
+
+/*The tokens are freed by the call as well, like the first pass does
+  after every line.*/
+static long bench_tokenize_line(void) {
+    int i;
+    
+    for (i = 0; i < line_count; i++) {
+        lex_dat.last_token   = NULL;
+        lex_dat.current_line = lines[i];
+        tokenize_line(&lex_dat);
+        destroy_clist(&lex_dat.last_token, &destroy_clist_token);
+    }
+    
+    return line_count;
+}
+
+static long bench_get_toktype(void) {
+    int i;
+    long sum = 0;
+    
+    for (i = 0; i < token_count; i++) {
+        sum += get_toktype(tokens[i]);
+    }
+    sink = sum;
+    
+    return token_count;
+}
+
+static long bench_is_valid_identifier(void) {
+    int i;
+    long sum = 0;
+    
+    for (i = 0; i < token_count; i++) {
+        sum += is_valid_identifier(tokens[i]->tokstr);
+    }
+    sink = sum;
+    
+    return token_count;
+}
+
+/*On the tokens of the lines, the statement is freed by the call.*/
+static long bench_parse_line(void) {
+    int i;
+    void *statement;
+    line_data lindat;
+    
+    for (i = 0; i < line_count; i++) {
+        if (line_tokens[i] == NULL) {
+            continue;
+        }
+        
+        lindat.label_token        = NULL;
+        lindat.label_error        = false;
+        lindat.valid_label        = false;
+        lindat.has_initial_wspace = false;
+        lindat.stype              = stype_unknown;
+        
+        parse_dat.last_token   = line_tokens[i];
+        parse_dat.current_line = lines[i];
+        statement = parse_line(&lindat, &parse_dat);
+        destroy_statement(statement, lindat.stype);
+    }
+    parse_dat.last_token = NULL;
+    
+    return line_count;
+}
+
+/*On the instruction statements, against the symbols of the program.*/
+static long bench_assm_stat_instr(void) {
+    int i;
+    
+    for (i = 0; i < instr_count; i++) {
+        assm_stat_instr(&assm, instrs[i], &assm_dat);
+    }
+    
+    return instr_count;
+}
+
+/*Drops the code of the batch.*/
+static void reset_assm_stat_instr(void) {
+    destroy_assm(&assm);
+    assm_dat.IC = assm_IC;
+}
+
+/*Into /dev/null, every machine word once.*/
+static long bench_output_weird(void) {
+    int i;
+    
+    for (i = 0; i < MAX_WORD; i++) {
+        output_weird(i, f_null);
+    }
+    
+    return MAX_WORD;
+}
+
+/*Every machine word once, back from its two digits.*/
+static long bench_get_weird(void) {
+    static char digits[MAX_WORD][3];
+    static bool digits_ready = false;
+    int i;
+    long sum = 0;
+    
+    if (!digits_ready) {
+        for (i = 0; i < MAX_WORD; i++) {
+            sprint_weird(i, digits[i]);
+        }
+        digits_ready = true;
+    }
+    
+    for (i = 0; i < MAX_WORD; i++) {
+        sum += get_weird(digits[i]);
+    }
+    sink = sum;
+    
+    return MAX_WORD;
+}
+
+/*Returns the monotonic time in seconds.*/
+static double get_wall_time(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -5,41 +5,49 @@
 #include <string.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "token.h"
 #include "clist.h"
 #include "statement.h"
 #include "filedata.h"
+#include "wordimg.h"
 #include "assm.h"
 #include "parser.h"
-
-#define EXTENSION_OB  ".ob"
-#define EXTENSION_ENT ".ent"
-#define EXTENSION_EXT ".ext"
+#include "objfile.h"
+#include "mapfile.h"
+#include "trace.h"
+#include "probes.h"
 
 #define MAX_OPDS 2       /*max operands for an operator*/
 #define BASE_32_COUNT 32 /*for weird_base array*/
+#define WEIRD_VALUES 128 /*ASCII, for the weird_values array*/
 
-#define WORD_SIZE 10        /*the word size of the machine*/
-#define TABSTOP "    "      /*whitespace between tokens in the final output*/
 #define STRING_TERMINATOR 0 /*for .string data*/
 
 
 static void add_label(line_data *lindat, file_data *filedat);
-static void assm_stat_instr(assm_t *assm, stat_instr_t *stat,
-                            file_data *filedat);
 static void assm_stat_data(assm_t *assm, stat_ddir_t *stat,
                            file_data *filedat);
 
-static void destroy_item_undefid(void *undefid);
 static item_undefid *create_item_undefid(int IC, int linenum, token *tok);
-static void add_bincode(c_list **binc_list, unsigned int bincode,
+static void add_bincode(word_image *image, unsigned int bincode,
                         unsigned int *increment);
+static void add_datacode(data_image *image, unsigned int bincode,
+                         unsigned int count, unsigned int *increment);
 static void assm_stat_instr_opds(assm_t *assm, stat_instr_t *stat,
                                  file_data *filedat);
 static void assm_opd_ident(assm_t *assm, file_data *filedat, token *ident);
-static item_label *get_instr_label(c_list *last_label, char *str);
-
-extern unsigned int ERRORS; /*for debugging*/
+static item_label *get_instr_label(c_hash *label_table, char *str);
+
+static item_err_assm *find_err_assm(c_list *last_err, char *message,
+                                    char *str);
+static void read_err_lines(c_list *last_err, char *filename);
+static int cmp_err_linenum(const void *a, const void *b);
+static void print_err_assm(item_err_assm *p_err);
+static void destroy_item_err_assm(void *item);
+static char *sprint_dec_as_word(int dec_inst, char *buf);
+static unsigned int count_clist(c_list *last_node);
+static void get_obj_symbols(c_list *last_out, obj_symbol *syms);
 
 char weird_base[BASE_32_COUNT] = {
     /*0*/  '!',
@@ -76,6 +84,11 @@ char weird_base[BASE_32_COUNT] = {
     /*31*/ 'v'
 };
 
+/*weird_base reversed, the value of every ASCII character as a weird base
+  digit, or -1 if it isn't one (see get_weird)*/
+static signed char weird_values[WEIRD_VALUES];
+static bool weird_values_ready = false;
+
 /*Driver for the assembly stage.*/
 void assemble_line(assm_t *assm, void *stat,
                    line_data *lindat, file_data *filedat) {
@@ -94,9 +107,38 @@ void assemble_line(assm_t *assm, void *stat,
     }
 }
 
+/*The syntax only counterpart of assemble_line. The parser's checks of
+  label validity, duplicates and entry/extern conflicts rely on the label,
+  entry and extern lists, so these are the only ones kept - nothing is
+  encoded and operands aren't looked up at all. The label addresses are
+  left at IC_INIT/DC_INIT since no one reads them in this mode.*/
+void define_line_symbols(void *stat, line_data *lindat, file_data *filedat) {
+    stat_ddir_t *p_ddir;
+    
+    if (stat == NULL) {
+        return;
+    }
+    
+    add_label(lindat, filedat);
+    
+    if (lindat->stype == stype_datadir) {
+        p_ddir = stat;
+        
+        if (p_ddir->datadir == datadir_entry) {
+            add_item_entry(filedat,
+                           create_item_entry((token*)p_ddir->data,
+                                             filedat->linenum));
+        } else if (p_ddir->datadir == datadir_extern) {
+            add_item_extern(filedat,
+                            create_item_extern((token*)p_ddir->data,
+                                               filedat->linenum));
+        }
+    }
+}
+
 /*Creates a new item_undefid. Note that a new token is created.*/
 item_undefid *create_item_undefid(int IC, int linenum, token *tok) {
-    item_undefid *new_undefid = malloc(sizeof(item_undefid));
+    item_undefid *new_undefid = mem_alloc(sizeof(item_undefid), mem_code);
     
     if (new_undefid == NULL) {
         fprintf(stderr, "Malloc failure in create_undefid.");
@@ -112,8 +154,9 @@ item_undefid *create_item_undefid(int IC, int linenum, token *tok) {
 
 /*Creates a new item_out_ent_ext. Note that a new str is created.*/
 item_out_ent_ext *create_item_out_ent_ext(int address, char *str) {
-    char *new_str = malloc(sizeof(char) * (strlen(str)+1));
-    item_out_ent_ext *new_out_ent_ext = malloc(sizeof(item_out_ent_ext));
+    char *new_str = mem_alloc(sizeof(char) * (strlen(str)+1), mem_output);
+    item_out_ent_ext *new_out_ent_ext = mem_alloc(sizeof(item_out_ent_ext),
+                                                  mem_output);
     
     if (new_out_ent_ext == NULL || new_str == NULL) {
         fprintf(stderr, "Malloc failure in create_item_out_ent_ext.");
@@ -135,7 +178,7 @@ void destroy_item_undefid(void *undefid) {
     }
     
     destroy_token(((item_undefid*)undefid)->tok);
-    free(undefid);
+    mem_free(undefid);
 }
 
 /*Destroyer for use with c_list.*/
@@ -144,37 +187,37 @@ void destroy_item_out_ent_ext(void *item) {
         return;
     }
     
-    free(((item_out_ent_ext*)item)->str);
-    free(item);
+    mem_free(((item_out_ent_ext*)item)->str);
+    mem_free(item);
 }
 
-/*Wrapper for adding binary codes to instruction and data lists. Increment
-  recieves either IC or DC from filedat and increments it.*/
-static void add_bincode(c_list **binc_list, unsigned int bincode,
+/*Wrapper for adding binary codes to the instruction and data images.
+  Increment recieves either IC or DC from filedat and increments it.*/
+static void add_bincode(word_image *image, unsigned int bincode,
                         unsigned int *increment) {
-    unsigned int *new_bincode = malloc(sizeof(unsigned int));
-    
-    if (new_bincode == NULL) {
-        fprintf(stderr, "Malloc failure in add_bincode.");
-        exit(1);
-    }
-    
-    *new_bincode = bincode;
-    
-    add_clist(binc_list, new_bincode);
+    append_word(image, bincode);
     
     (*increment)++;
 }
 
+/*Same as add_bincode, for count words of the same bincode in the data
+  image (which keeps the long runs as runs).*/
+static void add_datacode(data_image *image, unsigned int bincode,
+                         unsigned int count, unsigned int *increment) {
+    append_data_run(image, bincode, count);
+    
+    *increment += count;
+}
+
 /*Assembles the instruction statement.*/
-void assm_stat_instr(assm_t *assm, stat_instr_t *stat, file_data *filedat) {   
+void assm_stat_instr(assm_t *assm, stat_instr_t *stat, file_data *filedat) {
     int i;
     unsigned int inst = 0; /*the machine code instruction*/
     /*the appropriate amount of bitshift for the current operand*/
     int cur_opd_shift = SHIFT_SRC;
     int reg_opd_count = 0; /*used for the case of two reg addmodes*/
     operand_t *target_opd; /*points at the current operand*/
-
+    
     /*instruction*/
     target_opd = stat->operand_src;
     inst += (stat->opcode << SHIFT_OPC);
@@ -190,7 +233,7 @@ void assm_stat_instr(assm_t *assm, stat_instr_t *stat, file_data *filedat) {
         cur_opd_shift = SHIFT_DST;
     }
     
-    add_bincode(&assm->last_instr, inst, &filedat->IC);
+    add_bincode(&assm->code, inst, &filedat->IC);
     
     /*special case - two reg operands*/
     if (reg_opd_count == 2) {
@@ -198,7 +241,7 @@ void assm_stat_instr(assm_t *assm, stat_instr_t *stat, file_data *filedat) {
         inst += (stat->operand_src->data->reg_num << SHIFT_REG1);
         inst += (stat->operand_dst->data->reg_num << SHIFT_REG2);
         
-        add_bincode(&assm->last_instr, inst, &filedat->IC);
+        add_bincode(&assm->code, inst, &filedat->IC);
     /*assemble the operand codes*/
     } else {
         assm_stat_instr_opds(assm, stat, filedat);
@@ -213,7 +256,7 @@ static void assm_stat_instr_opds(assm_t *assm, stat_instr_t *stat,
     operand_t *target_opd; /*targets the current operand*/
     
     /*Goes through the two operands (if an operand is null, we skip)
-      and adds the relevant codes to assm->last_instr. For identifiers,
+      and adds the relevant codes to assm->code. For identifiers,
       if an identifier is a known label to an instruction statement,
       we add the code (since we know for sure that its IC is final). If
       not, we add it to assm->last_undefid to be dealt with during the
@@ -224,7 +267,7 @@ static void assm_stat_instr_opds(assm_t *assm, stat_instr_t *stat,
             switch (target_opd->addmode) {
                 /*immidiate*/
                 case addmode_imm:
-                    add_bincode(&assm->last_instr,
+                    add_bincode(&assm->code,
                                 target_opd->data->number << SHIFT_8BIT,
                                 &filedat->IC);
                     break;
@@ -239,14 +282,14 @@ static void assm_stat_instr_opds(assm_t *assm, stat_instr_t *stat,
                                    target_opd->data->structure->identifier);
                     
                     /*struct field*/
-                    add_bincode(&assm->last_instr,
+                    add_bincode(&assm->code,
                                 target_opd->data->structure->field <<
                                 SHIFT_8BIT, 
                                 &filedat->IC);
                     break;
                 /*register*/
                 case addmode_reg:
-                    add_bincode(&assm->last_instr,
+                    add_bincode(&assm->code,
                                 target_opd->data->reg_num << cur_reg_shift,
                                 &filedat->IC);
                     break;
@@ -264,40 +307,42 @@ static void assm_opd_ident(assm_t *assm, file_data *filedat, token *ident) {
     item_extern *p_extern;
     
     /*label list lookup, we want instruction labels only*/
-    if ((p_label = get_instr_label(filedat->last_label,
+    if ((p_label = get_instr_label(&filedat->label_table,
                                    ident->tokstr)) != NULL) {
-                                       
-        add_bincode(&assm->last_instr,
+        
+        add_bincode(&assm->code,
                    (p_label->IC << SHIFT_8BIT) + ARE_RELOC,
                     &filedat->IC);
+        PROBE_SYMBOL_RESOLVE(ident->tokstr, p_label->IC);
     /*extern list lookup*/
     } else if ((p_extern =
-               find_clist_str(filedat->last_extern,
+               find_chash_str(&filedat->extern_table,
                               &find_item_extern,
                               ident->tokstr)) != NULL) {
         /*remember that add_bincode increments the IC!*/
         p_extern->was_used = true;
+        PROBE_SYMBOL_RESOLVE(ident->tokstr, 0);
         add_clist(&assm->last_out_ext,
                   create_item_out_ent_ext(filedat->IC, ident->tokstr));
         
-        add_bincode(&assm->last_instr, ARE_EXTERN, &filedat->IC);
+        add_bincode(&assm->code, ARE_EXTERN, &filedat->IC);
     /*add dummy instruction*/
     } else {
         /*remember that add_bincode increments the IC!*/
         add_clist(&assm->last_undefid,
                   create_item_undefid(filedat->IC, filedat->linenum, ident));
-                  
-        add_bincode(&assm->last_instr, ARE_RELOC, &filedat->IC);
+        
+        add_bincode(&assm->code, ARE_RELOC, &filedat->IC);
     }
 }
 
 /*Attempts to find a label of an instruction statement that is
   lexicographically equivalent to str. If found, pointer to item_label
   in the label list is returned. Otherwise we return NULL.*/
-static item_label *get_instr_label(c_list *last_label, char *str) {
+static item_label *get_instr_label(c_hash *label_table, char *str) {
     item_label *p_label;
     
-    if ((p_label = find_clist_str(last_label,
+    if ((p_label = find_chash_str(label_table,
                                   &find_item_label, str)) != NULL) {
         
         if (p_label->stype == stype_instruction) {
@@ -313,97 +358,233 @@ static void assm_stat_data(assm_t *assm, stat_ddir_t *stat,
                            file_data *filedat) {
     char *p_str; /*pointer to a string, for identifiers*/
     ddir_data_t *p_data; /*pointer to .data data, for ease of use*/
-    c_list *p_assm_data_head;
+    c_list *cur_node;
+    unsigned int value;
+    unsigned int run; /*of the same value*/
     
     /*data*/
-    /*a little tricky - we need to append the data list at the
-      end of list of data codes*/
+    /*the equal numbers in a row are added at once, as a run*/
     if (stat->datadir == datadir_data) {
         p_data = stat->data;
-        filedat->DC += p_data->num_of_items;
         
-        if (assm->last_data != NULL) {
-            p_assm_data_head = assm->last_data->next;
+        cur_node = p_data->last_data->next;
+        do {
+            value = *(unsigned int*)cur_node->item;
+            run   = 0;
+            do {
+                run++;
+                cur_node = cur_node->next;
+            } while (cur_node != p_data->last_data->next &&
+                     *(unsigned int*)cur_node->item == value);
             
-            assm->last_data->next = p_data->last_data->next;
-            p_data->last_data->next = p_assm_data_head;
-        }
-        
-        assm->last_data = p_data->last_data;
+            add_datacode(&assm->data, value, run, &filedat->DC);
+        } while (cur_node != p_data->last_data->next);
     /*string*/
     } else if (stat->datadir == datadir_string) {
         p_str = (char*)stat->data;
         p_str++;
         
         while (*p_str != '"') {
-            add_bincode(&assm->last_data, *p_str, &filedat->DC);
+            add_datacode(&assm->data, *p_str, 1, &filedat->DC);
             p_str++;
         }
         
-        add_bincode(&assm->last_data, STRING_TERMINATOR, &filedat->DC);
+        add_datacode(&assm->data, STRING_TERMINATOR, 1, &filedat->DC);
     /*struct*/
     } else if (stat->datadir == datadir_struct) {
-        add_bincode(&assm->last_data, ((ddir_struct_t*)stat->data)->num,
-                    &filedat->DC);
+        add_datacode(&assm->data, ((ddir_struct_t*)stat->data)->num, 1,
+                     &filedat->DC);
         
         p_str = ((ddir_struct_t*)stat->data)->string;
         p_str++;
         while (*p_str != '"') {
-            add_bincode(&assm->last_data, *p_str, &filedat->DC);
+            add_datacode(&assm->data, *p_str, 1, &filedat->DC);
             p_str++;
         }
         
-        add_bincode(&assm->last_data, STRING_TERMINATOR, &filedat->DC);
+        add_datacode(&assm->data, STRING_TERMINATOR, 1, &filedat->DC);
     /*entry and extern*/
     } else if (stat->datadir == datadir_entry) {
-        add_clist(&filedat->last_entry,
-                  create_item_entry((token*)stat->data, filedat->linenum));
+        add_item_entry(filedat,
+                       create_item_entry((token*)stat->data,
+                                         filedat->linenum));
     } else if (stat->datadir == datadir_extern) {
-        add_clist(&filedat->last_extern,
-                  create_item_extern((token*)stat->data, filedat->linenum));
+        add_item_extern(filedat,
+                        create_item_extern((token*)stat->data,
+                                           filedat->linenum));
     }
 }
 
 /*A wrapper function for adding a label.*/
 static void add_label(line_data *lindat, file_data *filedat) {
-    bool error = filedat->error;
-    
     if (lindat->label_token == NULL) {
         return;
     } else if (lindat->has_initial_wspace == true) {
-        print_tok_error(lindat->label_token, filedat,
-                        "Warning, label has preceding whitespace.");
-        
-        filedat->error = error;
+        print_tok_warning(lindat->label_token, filedat,
+                          "Warning, label has preceding whitespace.");
     }
     
     if (lindat->stype == stype_instruction) {
-        add_clist(&filedat->last_label,
-                  create_item_label(lindat->label_token, filedat->IC,
-                                    filedat->linenum, lindat->stype));
+        add_item_label(filedat,
+                       create_item_label(lindat->label_token, filedat->IC,
+                                         filedat->linenum, lindat->stype));
     } else if (lindat->stype == stype_datadir) {
-        add_clist(&filedat->last_label,
-                  create_item_label(lindat->label_token, filedat->DC,
-                                    filedat->linenum, lindat->stype)); 
-    }
-}
-
-/*This is not exactly a desirable solution, but in practice, we won't
-  have to deal with many errors. The alternative would be to store the
-  relevant lines for undefined identifiers somewhere, but, of course,
-  we won't know until the last minute which one of those will remain
-  undefined. So I thought that some redundant i/o and CPU usage is
-  a better choice in this case than redundant RAM usage. Again, in practice
-  we'd have a couple of errors at most, but potentially hundreds of undefined
-  identifiers.
-  
-  Of course, we might also forego the printing of the line entirely,
-  since it's completely optional. But it looks nicer if we still do.*/
-void print_tok_error_assm(token *tok, int linenum, char *filename,
-                          file_data *filedat, char *message) {
+        add_item_label(filedat,
+                       create_item_label(lindat->label_token, filedat->DC,
+                                         filedat->linenum, lindat->stype));
+    }
+}
+
+/*Queues an error found after the first pass, to be printed later by
+  print_errors_assm. Identical errors are merged - the same undeclared
+  identifier on a hundred lines is reported once, with the count and the
+  first few line numbers.*/
+void add_error_assm(assm_t *assm, token *tok, int linenum,
+                    file_data *filedat, char *message) {
+    set_error(filedat);
+    
+    if (filedat->collect_diag) {
+        add_diag(filedat, linenum, tok->starting_index, tok->length, message);
+        return;
+    }
+    
+    queue_error_assm(assm, tok, linenum, message, "Assembly error.");
+}
+
+/*Queues the error without counting it, which is up to the caller (see
+  add_error_assm, and print_tok_error for the errors of the first pass).
+  The title is printed above the error, unless it's NULL. Errors of the
+  same message (the very literal) and token string are merged.*/
+void queue_error_assm(assm_t *assm, token *tok, int linenum, char *message,
+                      char *title) {
+    item_err_assm *p_err;
+    
+    if ((p_err = find_err_assm(get_chash_bucket(&assm->err_table,
+                                                tok->tokstr),
+                               message, tok->tokstr)) != NULL) {
+        if (p_err->count < MAX_ERR_LINES) {
+            p_err->linenums[p_err->count] = linenum;
+            p_err->notes[p_err->count]    = NULL;
+        }
+        
+        p_err->count++;
+        assm->last_queued = p_err;
+        return;
+    }
+    
+    p_err = mem_alloc(sizeof(item_err_assm), mem_output);
+    if (p_err == NULL) {
+        fprintf(stderr, "Malloc failure in queue_error_assm.");
+        exit(1);
+    }
+    
+    p_err->tok         = extract_token(tok);
+    p_err->message     = message;
+    p_err->title       = title;
+    p_err->line        = NULL;
+    p_err->count       = 1;
+    p_err->linenums[0] = linenum;
+    p_err->notes[0]    = NULL;
+    
+    add_clist(&assm->last_err, p_err);
+    add_chash(&assm->err_table, p_err);
+    assm->last_queued = p_err;
+}
+
+/*Appends note (the expected bounds and such) to the occurrence of the
+  error that was queued last. The notes of the occurrences past the first
+  MAX_ERR_LINES are dropped on purpose, just like their line numbers.*/
+void add_note_assm(assm_t *assm, char *note) {
+    char *old_note;
+    char **p_note;
+    item_err_assm *p_err = assm->last_queued;
+    
+    if (p_err == NULL || p_err->count > MAX_ERR_LINES) {
+        return;
+    }
+    
+    p_note = &p_err->notes[p_err->count-1];
+    old_note = *p_note;
+    *p_note = mem_alloc(sizeof(char)*((old_note == NULL ? 0 :
+                                       strlen(old_note)) +
+                                      strlen(note) + 1), mem_output);
+    if (*p_note == NULL) {
+        fprintf(stderr, "Malloc failure in add_note_assm.");
+        exit(1);
+    }
+    
+    strcpy(*p_note, old_note == NULL ? "" : old_note);
+    strcat(*p_note, note);
+    mem_free(old_note);
+}
+
+/*Key getter for use with c_hash.*/
+char *get_err_assm_key(void *item) {
+    return ((item_err_assm*)item)->tok->tokstr;
+}
+
+/*Returns the queued error with the same message and identifier,
+  NULL if there isn't one. last_err is the bucket of the identifier in
+  err_table.*/
+static item_err_assm *find_err_assm(c_list *last_err, char *message,
+                                    char *str) {
+    c_list *cur_node;
+    item_err_assm *p_err;
+    
+    if (last_err == NULL) {
+        return NULL;
+    }
+    
+    cur_node = last_err->next;
+    do {
+        p_err = cur_node->item;
+        if (p_err->message == message &&
+            strcmp(p_err->tok->tokstr, str) == 0) {
+            return p_err;
+        }
+        
+        cur_node = cur_node->next;
+    } while (cur_node != last_err->next);
+    
+    return NULL;
+}
+
+/*Prints the errors queued by add_error_assm, in the order they were
+  found, and empties the queue. The source lines are read from filename
+  in a single pass over the file, no matter how many errors there are. If
+  filename is NULL, the errors are printed without the source lines.*/
+void print_errors_assm(assm_t *assm, char *filename) {
+    c_list *cur_node;
+    
+    if (assm->last_err == NULL) {
+        return;
+    }
+    
+    if (filename != NULL) {
+        read_err_lines(assm->last_err, filename);
+    }
+    
+    cur_node = assm->last_err->next;
+    do {
+        print_err_assm(cur_node->item);
+        cur_node = cur_node->next;
+    } while (cur_node != assm->last_err->next);
+    
+    destroy_chash(&assm->err_table);
+    destroy_clist(&assm->last_err, &destroy_item_err_assm);
+    assm->last_queued = NULL;
+}
+
+/*Stores the source line of the first occurrence into every queued
+  error. The errors are sorted by line number so that the file is read
+  just once.*/
+static void read_err_lines(c_list *last_err, char *filename) {
     int i = 0;
-    int lincount = 1;
-    int ch;
+    int count = 0;
+    int linenum = 0;
+    char line[MAX_LINE];
+    c_list *cur_node;
+    item_err_assm **errs; /*sorted by the line of the first occurrence*/
     FILE *p_file = fopen(filename, "r");
     
     /*really shouldn't happen, but just to be pedantic*/
@@ -412,58 +593,139 @@ void print_tok_error_assm(token *tok, int linenum, char *filename,
         exit(1);
     }
     
-    ERRORS++;
-    filedat->error = true;
+    cur_node = last_err;
+    do {
+        count++;
+        cur_node = cur_node->next;
+    } while (cur_node != last_err);
     
-    /*get to the desired line*/
-    while (lincount != linenum && !feof(p_file)) {
-        ch = fgetc(p_file);
-        if (ch == '\n') {
-            lincount++;
-            if (lincount == linenum) {
-                break;
+    errs = mem_alloc(sizeof(item_err_assm*)*count, mem_output);
+    if (errs == NULL) {
+        fprintf(stderr, "Malloc failure in read_err_lines.");
+        exit(1);
+    }
+    
+    cur_node = last_err->next;
+    for (i = 0; i < count; i++) {
+        errs[i] = cur_node->item;
+        cur_node = cur_node->next;
+    }
+    qsort(errs, count, sizeof(item_err_assm*), &cmp_err_linenum);
+    
+    i = 0;
+    while (i < count && get_line(p_file, MAX_LINE,
+                                 init_string(line, MAX_LINE)) != line_EOF) {
+        linenum++;
+        
+        for (; i < count && errs[i]->linenums[0] == linenum; i++) {
+            errs[i]->line = mem_alloc(sizeof(char)*(strlen(line)+1),
+                                      mem_output);
+            if (errs[i]->line == NULL) {
+                fprintf(stderr, "Malloc failure in read_err_lines.");
+                exit(1);
             }
+            
+            strcpy(errs[i]->line, line);
         }
     }
     
-    /*skip initial whitespace*/
-    while (((ch = fgetc(p_file)) == ' ') || ch == '\t') {
-        i++;
+    mem_free(errs);
+    fclose(p_file);
+}
+
+/*Comparator for qsort, by the line of the first occurrence.*/
+static int cmp_err_linenum(const void *a, const void *b) {
+    return (*(item_err_assm**)a)->linenums[0] -
+           (*(item_err_assm**)b)->linenums[0];
+}
+
+/*Prints a single queued error.*/
+static void print_err_assm(item_err_assm *p_err) {
+    int i = 0;
+    char *line = p_err->line;
+    
+    if (p_err->title != NULL) {
+        fprintf(stderr, "\n%s", p_err->title);
     }
+    fprintf(stderr, "\nLine %d: %s\n", p_err->linenums[0], p_err->message);
     
-    fprintf(stderr, "\nAssembly error.\nLine %d: %s\n", linenum, message);
-    while (ch != '\n' && !feof(p_file)) {
-        if (ch == '\t') {
+    if (line != NULL) {
+        /*skip initial whitespace*/
+        while (*line == ' ' || *line == '\t') {
+            line++; i++;
+        }
+        
+        while (*line != '\n' && *line != '\0') {
+            if (*line == '\t') {
+                fprintf(stderr, " ");
+            } else {
+                fprintf(stderr, "%c", *line);
+            }
+            line++;
+        }
+        fprintf(stderr, "\n");
+        
+        /*fancy line*/
+        for (; i < p_err->tok->starting_index; i++) {
             fprintf(stderr, " ");
-        } else {
-            fprintf(stderr, "%c", ch);
+        }
+        fprintf(stderr, "^");
+        i++;
+        for (; i < (p_err->tok->length)+(p_err->tok->starting_index); i++) {
+            fprintf(stderr, "~");
         }
         
-        ch = fgetc(p_file);
+        fprintf(stderr, "\n");
     }
-    fclose(p_file);
-    fprintf(stderr, "\n");
     
-    /*fancy line*/
-    for (; i < tok->starting_index; i++) {
-        fprintf(stderr, " ");
+    if (p_err->notes[0] != NULL) {
+        fprintf(stderr, "%s", p_err->notes[0]);
     }
-    fprintf(stderr, "^");
-    i++;
-    for (; i < (tok->length)+(tok->starting_index); i++) {
-        fprintf(stderr, "~");
+    
+    /*repeated error*/
+    if (p_err->count > 1) {
+        fprintf(stderr, "Occurrences: %d. Lines:", p_err->count);
+        for (i = 0; i < p_err->count && i < MAX_ERR_LINES; i++) {
+            fprintf(stderr, "%s %d", (i > 0) ? "," : "", p_err->linenums[i]);
+        }
+        fprintf(stderr, "%s\n", (p_err->count > MAX_ERR_LINES) ? ", ..." : "");
+        
+        /*the notes of the other occurrences, with their lines*/
+        for (i = 1; i < p_err->count && i < MAX_ERR_LINES; i++) {
+            if (p_err->notes[i] != NULL) {
+                fprintf(stderr, "Line %d: %s", p_err->linenums[i],
+                        p_err->notes[i]);
+            }
+        }
     }
+}
 
-    fprintf(stderr, "\n");
+/*Destroyer for use with c_list.*/
+static void destroy_item_err_assm(void *item) {
+    int i;
+    item_err_assm *p_err = item;
+    
+    if (item == NULL) {
+        return;
+    }
+    
+    destroy_token(p_err->tok);
+    mem_free(p_err->line);
+    for (i = 0; i < p_err->count && i < MAX_ERR_LINES; i++) {
+        mem_free(p_err->notes[i]);
+    }
+    mem_free(item);
 }
 
 /*Cleans up the assm.*/
 void destroy_assm(assm_t *assm) {   
     destroy_clist(&assm->last_undefid, &destroy_item_undefid);
-    destroy_clist(&assm->last_instr, &free);
-    destroy_clist(&assm->last_data, &free);
+    destroy_word_image(&assm->code);
+    destroy_data_image(&assm->data);
     destroy_clist(&assm->last_out_ent, &destroy_item_out_ent_ext);
     destroy_clist(&assm->last_out_ext, &destroy_item_out_ent_ext);
+    destroy_chash(&assm->err_table);
+    destroy_clist(&assm->last_err, &destroy_item_err_assm);
 }
 
 /*Initializes the input to 0.*/
@@ -477,128 +739,103 @@ char *init_string(char *str, int length) {
     return str;
 }
 
-/*Driver for the output of instructions to the output files.*/
+/*Driver for the output of instructions to the output files, the text
+  files or, with --format=bin, the binary object. Both are written from
+  the same image, see objfile.c. The symbol map (--map) is written along,
+  see mapfile.c.*/
 void output_machine_code(assm_t *assm, file_data *filedat, char *filename) {
-    int i;
-    /*initial starting address, has to be bound to IC_INIT*/
-    int address = IC_INIT;
-    c_list *cur_node; /*used as an iterator*/
-    c_list *target_clist; /*will point at instr or data*/
-    item_out_ent_ext *p_out_ent_ext;
-    char fname_buf[MAX_FILE_LENGTH];
-    FILE *f_out; /*pointer to the output files*/
-    
-    /*instructions and data*/
-    init_string(fname_buf, MAX_FILE_LENGTH);
-    sprintf(fname_buf, "%s%s", filename, EXTENSION_OB);
-    f_out = fopen(fname_buf, "w");
-    if (f_out == NULL) {
-        fprintf(stderr, "Error, fopen returned NULL for \"w\" "
-                        "in output_machine_code.");
-        exit(1);
+    obj_image img;
+    symbol_map map;
+    
+    get_obj_image(assm, filedat, &img);
+    
+    if (filedat->obj_format == OBJ_FORMAT_TEXT) {
+        write_obj_text(&img, filename);
+    } else {
+        write_obj_bin(&img, filename, filedat->obj_format == OBJ_FORMAT_RUNS);
+    }
+    
+    destroy_obj_image(&img);
+    
+    if (filedat->map_format != MAP_FORMAT_NONE) {
+        get_symbol_map(filedat->last_label, &map);
+        if (filedat->map_format == MAP_FORMAT_TEXT) {
+            write_map_text(&map, filename);
+        } else {
+            write_map_bin(&map, filename);
+        }
+        destroy_symbol_map(&map);
     }
+}
+
+/*Fills img (which is initialized by the call) with the code, the data,
+  the entries and the extern references of the assembled file, in the
+  order they're written.*/
+void get_obj_image(assm_t *assm, file_data *filedat, obj_image *img) {
+    unsigned int i;
+    unsigned int word;
+    char word_buf[WORD_BITS+1];
     
-    /*the amount of instructions*/
-    output_weird(filedat->IC-IC_INIT, f_out);
-    fprintf(f_out, "%s", TABSTOP);
-    output_weird(filedat->DC-DC_INIT, f_out);
-    fprintf(f_out, "\n");
+    init_obj_image(img, IC_INIT, count_clist(assm->last_out_ent),
+                   count_clist(assm->last_out_ext));
     
     /*instruction and data codes*/
-    target_clist = assm->last_instr;
-    for (i = 0; i < 2; i++) { /*2 for instructions and data*/
-        if (target_clist != NULL) {
-            cur_node = target_clist->next;
-            
-            /*output format: "ADDRESS" TABSTOP "MACHINECODE"*/
-            do {
-                output_weird(address, f_out);
-                fprintf(f_out, "%s", TABSTOP);
-                output_weird(*(unsigned int*)(cur_node->item), f_out);
-                
-                #ifdef DEBUG_OUTPUT
-                    fprintf(f_out, "%s%d%s", TABSTOP, address, TABSTOP);
-                    output_dec_as_word(*(unsigned int*)(cur_node->item),
-                                       f_out);
-                    fprintf(f_out, "%sreal address: %d", TABSTOP,
-                            *(unsigned int*)(cur_node->item) >> 2);
-                #endif
-                
-                fprintf(f_out, "\n");
-                cur_node = cur_node->next;
-                address++;
-            } while (cur_node != target_clist->next);
+    copy_word_image(&img->code, &assm->code);
+    copy_data_image(&img->data, &assm->data);
+    
+    if (TRACE_CAT(TRACE_OUT)) {
+        for (i = 0; i < img->code.count + img->data.count; i++) {
+            word = i < img->code.count ?
+                   get_word(&img->code, i) :
+                   get_data_word(&img->data, i - img->code.count);
+            printf("%u%s%s%sreal address: %u\n", IC_INIT+i, TABSTOP,
+                   sprint_dec_as_word(word, word_buf), TABSTOP, word >> 2);
         }
-        
-        target_clist = assm->last_data;
-    }
-    fclose(f_out);
-    
-    /*these are best done separately to avoid any confusion - 
-      ugly, but safer*/
-    /*entries*/
-    init_string(fname_buf, MAX_FILE_LENGTH);
-    sprintf(fname_buf, "%s%s", filename, EXTENSION_ENT);
-    if (assm->last_out_ent != NULL) {
-        f_out = fopen(fname_buf, "w");
-        if (f_out == NULL) {
-            fprintf(stderr, "Error, fopen returned NULL for \"w\" "
-                            "in output_machine_code.");
-            exit(1);
-        }   
-    
-        cur_node = assm->last_out_ent->next;
+    }
+    
+    get_obj_symbols(assm->last_out_ent, img->entries);
+    get_obj_symbols(assm->last_out_ext, img->externs);
+}
+
+/*Returns the amount of nodes in the list.*/
+static unsigned int count_clist(c_list *last_node) {
+    unsigned int count = 0;
+    c_list *cur_node;
+    
+    if (last_node == NULL) {
+        return 0;
+    }
+    
+    cur_node = last_node;
+    do {
+        count++;
+        cur_node = cur_node->next;
+    } while (cur_node != last_node);
+    
+    return count;
+}
+
+/*Copies the item_out_ent_ext of the list into syms, in order.*/
+static void get_obj_symbols(c_list *last_out, obj_symbol *syms) {
+    c_list *cur_node;
+    item_out_ent_ext *p_out_ent_ext;
+    
+    if (last_out == NULL) {
+        return;
+    }
+    
+    cur_node = last_out->next;
+    do {
         p_out_ent_ext = cur_node->item;
-        /*output format: "LABEL" TABSTOP "ADDRESS"*/
-        do {
-            fprintf(f_out, "%s\t", p_out_ent_ext->str);
-            output_weird(p_out_ent_ext->address, f_out);
-            
-            #ifdef DEBUG_OUTPUT
-                fprintf(f_out, "\t%d", p_out_ent_ext->address);
-            #endif
-            
-            fprintf(f_out, "\n");
-            cur_node = cur_node->next;
-            p_out_ent_ext = cur_node->item;
-        } while (cur_node != assm->last_out_ent->next);
+        set_obj_symbol(syms++, p_out_ent_ext->address, p_out_ent_ext->str,
+                       strlen(p_out_ent_ext->str));
         
-        fclose(f_out);
-    } else {
-        remove(fname_buf);
-    }
-    
-    /*externs*/
-    init_string(fname_buf, MAX_FILE_LENGTH);
-    sprintf(fname_buf, "%s%s", filename, EXTENSION_EXT);
-    if (assm->last_out_ext != NULL) {
-        f_out = fopen(fname_buf, "w");
-        if (f_out == NULL) {
-            fprintf(stderr, "Error, fopen returned NULL for \"w\" "
-                            "in output_machine_code.");
-            exit(1);
+        if (TRACE_CAT(TRACE_OUT)) {
+            printf("%s\t%d\n", p_out_ent_ext->str, p_out_ent_ext->address);
         }
-    
-        cur_node = assm->last_out_ext->next;
-        p_out_ent_ext = cur_node->item;
-        /*output format: "LABEL" TABSTOP "ADDRESS"*/
-        do {
-            fprintf(f_out, "%s\t", p_out_ent_ext->str);
-            output_weird(p_out_ent_ext->address, f_out);
-            
-            #ifdef DEBUG_OUTPUT
-                fprintf(f_out, "\t%d", p_out_ent_ext->address);
-            #endif
-            
-            fprintf(f_out, "\n");
-            cur_node = cur_node->next;
-            p_out_ent_ext = cur_node->item;
-        } while (cur_node != assm->last_out_ext->next);
         
-        fclose(f_out);
-    } else {
-        remove(fname_buf);
-    }
+        cur_node = cur_node->next;
+    } while (cur_node != last_out->next);
 }
 
 /*Outputs dec_inst as weird base into f_out. Since we know for sure
@@ -618,40 +855,111 @@ void output_weird(int dec_inst, FILE *f_out) {
     fprintf(f_out, "%c%c", buffer[0], buffer[1]);
 }
 
-/*DEBUG*/
-void output_dec_as_word(int dec_inst, FILE *f_out) {
+/*Same as output_weird, but writes the two weird base symbols (and the
+  terminator) into buf.*/
+char *sprint_weird(int dec_inst, char *buf) {
+    buf[1] = weird_base[dec_inst % 32];
+    dec_inst /= 32;
+    buf[0] = weird_base[dec_inst % 32];
+    buf[2] = '\0';
+    
+    return buf;
+}
+
+/*The opposite of sprint_weird, returns the value of the two weird base
+  symbols at str, or -1 if they aren't. Every symbol is a lookup in
+  weird_values, so this is cheap enough for reading whole object files.*/
+int get_weird(const char *str) {
+    unsigned char high = str[0];
+    unsigned char low;
+    
+    if (!weird_values_ready) {
+        init_weird_values();
+    }
+    
+    /*the terminator isn't a digit, so str[1] is only read if it's there*/
+    if (high >= WEIRD_VALUES || weird_values[high] < 0) {
+        return -1;
+    }
+    
+    low = str[1];
+    if (low >= WEIRD_VALUES || weird_values[low] < 0) {
+        return -1;
+    }
+    
+    return weird_values[high]*BASE_32_COUNT + weird_values[low];
+}
+
+/*Fills weird_values from weird_base. get_weird does it on first use,
+  so this only has to be called before get_weird is used by threads.*/
+void init_weird_values(void) {
     int i;
     
-    for (i = WORD_SIZE-1; i >= 0; i--) {
-        if (dec_inst >> i & 1) {
-            fprintf(f_out, "%c", '1');
-        } else {
-            fprintf(f_out, "%c", '0');
-        }
+    for (i = 0; i < WEIRD_VALUES; i++) {
+        weird_values[i] = -1;
     }
+    for (i = 0; i < BASE_32_COUNT; i++) {
+        weird_values[(unsigned char)weird_base[i]] = i;
+    }
+    
+    weird_values_ready = true;
+}
+
+/*Writes dec_inst as a binary word (and the terminator) into buf, which
+  must hold WORD_BITS+1 chars.*/
+static char *sprint_dec_as_word(int dec_inst, char *buf) {
+    int i;
+    
+    for (i = 0; i < WORD_BITS; i++) {
+        buf[i] = (dec_inst >> (WORD_BITS-1-i) & 1) ? '1' : '0';
+    }
+    buf[WORD_BITS] = '\0';
+    
+    return buf;
+}
+
+/*DEBUG*/
+void output_dec_as_word(int dec_inst, FILE *f_out) {
+    char buf[WORD_BITS+1];
+    
+    fputs(sprint_dec_as_word(dec_inst, buf), f_out);
 }
 
 
 /*DEBUG*/
 void print_dec_as_word(int dec_inst) {
-    int i;
+    char buf[WORD_BITS+1];
+    
+    puts(sprint_dec_as_word(dec_inst, buf));
+}
+
+/*DEBUG Prints count words of the image from start, with their indices.*/
+void print_words(word_image *image, unsigned int start, unsigned int count) {
+    unsigned int i;
+    char buf[WORD_BITS+1];
     
-    for (i = WORD_SIZE-1; i >= 0; i--) {
-        (dec_inst >> i & 1) ? putchar('1') : putchar('0');
+    for (i = start; i < start+count && i < image->count; i++) {
+        printf("%u\t%s\n", i, sprint_dec_as_word(get_word(image, i), buf));
     }
+}
+
+/*DEBUG Same as print_words, for the data image.*/
+void print_data_words(data_image *image, unsigned int start,
+                      unsigned int count) {
+    unsigned int i;
+    char buf[WORD_BITS+1];
     
-    putchar('\n');
+    for (i = start; i < start+count && i < image->count; i++) {
+        printf("%u\t%s\n", i,
+               sprint_dec_as_word(get_data_word(image, i), buf));
+    }
 }
 
 /*DEBUG*/
 void print_voidbin_as_word(void *bincode) {
-    int i;
-    
-    for (i = WORD_SIZE-1; i >= 0; i--) {
-        (*((int*)bincode) >> i & 1) ? putchar('1') : putchar('0');
-    }
+    char buf[WORD_BITS+1];
     
-    putchar('\n');
+    puts(sprint_dec_as_word(*(int*)bincode, buf));
 }
 
 /*DEBUG*/
@@ -687,7 +995,7 @@ void print_item_undefid(void *undefid) {
     if (undefid == NULL) {
         return;
     }
-
+    
     printf("%d\t%s\t%d\t<-linenum\n", p_undefid->IC, p_undefid->tok->tokstr,
                                       p_undefid->linenum);
 }
@@ -15,6 +15,7 @@
   for obvious reasons (x + 0 = x)*/
 #define ARE_EXTERN 1
 #define ARE_RELOC  2
+#define ARE_MASK   3 /*the ARE bits of a word*/
 
 /*offsets for moving the bits to their
   relevant locations*/
@@ -25,6 +26,8 @@
 #define SHIFT_8BIT 2 /*shifts an eight bit number two bits to the left*/
 #define SHIFT_REG1 6 /*shifts the code of the source register operand*/
 #define SHIFT_REG2 2 /*shifts the code of the destination register operand*/
+
+#define MAX_ERR_LINES 5 /*line numbers listed for a repeated error*/
 /*9   8   7   6  5  4  3 2 1 0*/
 /*512 256 128 64 32 16 8 4 2 1*/
 
@@ -42,14 +45,28 @@
         char *str;   /*the identifier*/
     } item_out_ent_ext;
     
+    /*container for the errors found after the first pass. Identical errors
+      (same message, same identifier) are merged into a single item.*/
+    typedef struct item_err_assm {
+        token *tok;       /*of the first occurrence*/
+        char *message;    /*not a copy, the messages are literals*/
+        char *title;      /*printed above it, or NULL, a literal as well*/
+        /*the notes of the first few occurrences (see add_note_assm), the
+          first one is printed under the error and the rest with their
+          lines, NULL for none*/
+        char *notes[MAX_ERR_LINES];
+        char *line;       /*source line of the first occurrence, or NULL*/
+        int count;        /*occurrences*/
+        int linenums[MAX_ERR_LINES]; /*of the first few occurrences*/
+    } item_err_assm;
+    
 typedef struct assm_t {
-    /*the instruction machine code, stored as an unsigned decimal int*/
-    /*stores unsigned int* in void *item in the c_list*/
-    c_list *last_instr;
+    /*the instruction machine code, word i is at the address IC_INIT+i*/
+    word_image code;
     
-    /*the data machine code, stored as an unsigned decimal int*/
-    /*stores unsigned int* in void *item in the c_list*/
-    c_list *last_data;
+    /*the data machine code, word i is at DC_INIT+i (before the IC
+      offset)*/
+    data_image data;
     
     /*this list contains all the operands whose addresses
       were not known during their assembly in the first pass*/
@@ -63,28 +80,55 @@ typedef struct assm_t {
     /*extern output file contents*/
     /*stores item_out_ent_ext*/
     c_list *last_out_ext;
+    
+    /*errors waiting to be printed by print_errors_assm*/
+    /*stores item_err_assm*/
+    c_list *last_err;
+    
+    /*the same errors by identifier, for merging them*/
+    c_hash err_table;
+    
+    /*the error that was queued last (or merged into) for its notes*/
+    item_err_assm *last_queued;
 } assm_t;
 
 
 void assemble_line(assm_t *assm, void *stat,
                    line_data *lindat, file_data *filedat);
+void define_line_symbols(void *stat, line_data *lindat, file_data *filedat);
+void assm_stat_instr(assm_t *assm, stat_instr_t *stat, file_data *filedat);
 
 char *init_string(char *str, int length);
 
 item_out_ent_ext *create_item_out_ent_ext(int address, char *str);
+void destroy_item_out_ent_ext(void *item);
+void destroy_item_undefid(void *undefid);
 
 void output_machine_code(assm_t *assm, file_data *filedat, char *filename);
+struct obj_image; /*in objfile.h*/
+void get_obj_image(assm_t *assm, file_data *filedat, struct obj_image *img);
 void output_weird(int dec, FILE *f_out);
+char *sprint_weird(int dec_inst, char *buf);
+int get_weird(const char *str);
+void init_weird_values(void);
 void output_dec_as_word(int dec_inst, FILE *f_out);
 
-void print_tok_error_assm(token *tok, int linenum, char *filename,
-                          file_data *filedat, char *message);
+void add_error_assm(assm_t *assm, token *tok, int linenum,
+                    file_data *filedat, char *message);
+void queue_error_assm(assm_t *assm, token *tok, int linenum, char *message,
+                      char *title);
+void add_note_assm(assm_t *assm, char *note);
+void print_errors_assm(assm_t *assm, char *filename);
+char *get_err_assm_key(void *item);
                       
 void destroy_assm(assm_t *assm);
 
 /*DEBUG*/
 void print_dec_as_word(int dec_inst);
 void print_voidbin_as_word(void *bincode);
+void print_words(word_image *image, unsigned int start, unsigned int count);
+void print_data_words(data_image *image, unsigned int start,
+                      unsigned int count);
 void print_dec_as_b32(int dec_inst);
 
 void print_item_undefid(void *undefid);
@@ -5,46 +5,71 @@
 #include <stdlib.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "clist.h"
 #include "token.h"
 #include "statement.h"
 #include "filedata.h"
 #include "lexer.h"
 #include "parser.h"
+#include "wordimg.h"
 #include "assm.h"
+#include "objfile.h"
+#include "mapfile.h"
+#include "options.h"
+#include "stats.h"
+#include "trace.h"
+#include "probes.h"
 #include "assm_driver.h"
 
 #define EXTENSION_AS ".as"
 
-/*Debug options:
-  --------------
-    #define DEBUG_FPASS - first pass debugger
-    #define DEBUG_SPASS - second pass debugger
+/*Debug output (see --trace-cat):
+  -------------------------------
+    fpass - first pass debugger
+    spass - second pass debugger
 */
 
 static void first_pass(assm_t *assm, file_data *filedat, FILE *f_input);
-static void second_pass(assm_t *assm, file_data *filedat, char *filename);
-static void second_pass_entry(assm_t *assm, file_data *filedat,
-                              char *filename);
-static void second_pass_undefid(assm_t *assm, file_data *filedat,
-                                char *filename);
+static void second_pass_entry(assm_t *assm, file_data *filedat);
+static void second_pass_undefid(assm_t *assm, file_data *filedat);
 
-static void apply_IC_offset(c_list *last_label_def, int IC);
-static void init_run_assm(file_data *filedat, assm_t *assm);
 static bool has_initial_wspace(const char *line);
 static void init_first_pass(line_data *lindat, file_data *filedat,
                             void **statement, char input[MAX_LINE]);
+static void print_line_error(file_data *filedat, char *input,
+                             char *message);
 static void print_line(char *str);
+static void feed_line(assm_ctx *ctx);
+static void trace_counters(file_data *filedat);
+static void print_file_result(file_data *filedat, bool written);
+static void get_file_metrics(file_metrics *metrics, const char *name,
+                             file_data *filedat);
 
 unsigned int ERRORS = 0; /*for debugging*/
 
 /*Main driver for the whole assembler.*/
-void run_assm(int argc, char **argv) {
+void run_assm(int argc, char **argv, run_opts *opts) {
     int cur_file = 1;  /*counts the current argv*/
     assm_t assm;       /*the relevant assembly data on the current file*/
     file_data filedat; /*the relevant data on the current file*/
     FILE *f_input;     /*the input file*/
     char fname_as_ext[MAX_FILE_LENGTH]; /*filename with the .as extension*/
+    file_metrics metrics;
+    bool written; /*the output of the current file*/
+    
+    if (opts->metrics_file != NULL && !open_metrics(opts->metrics_file)) {
+        return;
+    }
+    
+    /*the metrics need the timing and the heap accounting*/
+    STATS       = opts->stats || METRICS;
+    ALLOC_STATS = opts->alloc_stats || METRICS;
+    
+    if (opts->trace_file != NULL && !open_trace(opts->trace_file)) {
+        close_metrics();
+        return;
+    }
     
     while (argc > 1) {
         /*we should be able to fit the extensions after the filename*/
@@ -56,6 +81,12 @@ void run_assm(int argc, char **argv) {
         
         /*initializes filedat and assm*/
         init_run_assm(&filedat, &assm);
+        written = false;
+        filedat.syntax_only = opts->syntax_only;
+        filedat.obj_format  = opts->obj_format;
+        filedat.map_format  = opts->map_format;
+        filedat.max_errors  = opts->max_errors;
+        filedat.err_queue   = &assm;
         
         /*open the input file*/
         init_string(fname_as_ext, MAX_FILE_LENGTH);
@@ -67,174 +98,270 @@ void run_assm(int argc, char **argv) {
             continue;
         }
         
-        printf("\n\nCurrent file:\n~~~~~~~~~~~~~\n%d: %s\n\n",
-               cur_file, argv[cur_file]);
+        if (!opts->quiet) {
+            printf("\n\nCurrent file:\n~~~~~~~~~~~~~\n%d: %s\n\n",
+                   cur_file, argv[cur_file]);
+        }
+        reset_file_peak();
+        TRACE_BEGIN("file", argv[cur_file]);
+        PROBE_FILE_START(argv[cur_file]);
         
         /*First pass*/
+        TRACE_BEGIN("pass", "first pass");
         first_pass(&assm, &filedat, f_input);
+        TRACE_END("pass", "first pass");
         fclose(f_input);
         
-        /*Apply the IC offset to the labels created in data
-          statements (the offset is the last IC).*/
-        apply_IC_offset(filedat.last_label, filedat.IC);
+        /*the errors of the first pass are merged as well, and printed
+          together*/
+        print_errors_assm(&assm, fname_as_ext);
         
-        /*Second pass*/
-        /*this guy needs .as in the filename for the print_tok_error_assm*/
-        second_pass(&assm, &filedat, fname_as_ext); 
+        /*the syntax check is done with the first pass, and there's no
+          point in going on once the error budget is spent*/
+        if (filedat.syntax_only == false &&
+            !is_error_budget_spent(&filedat)) {
+            /*Apply the IC offset to the labels created in data
+              statements (the offset is the last IC).*/
+            STATS_BEGIN(phase_IC_offset);
+            TRACE_BEGIN("pass", "IC offset");
+            apply_IC_offset(filedat.last_label, filedat.IC);
+            TRACE_END("pass", "IC offset");
+            STATS_END(phase_IC_offset);
+            
+            /*Second pass*/
+            /*this guy needs .as in the filename for the
+              print_errors_assm*/
+            STATS_BEGIN(phase_second_pass);
+            TRACE_BEGIN("pass", "second pass");
+            second_pass(&assm, &filedat, fname_as_ext); 
+            TRACE_END("pass", "second pass");
+            STATS_END(phase_second_pass);
+            
+            /*Write output to the relevant files*/
+            if (filedat.error != true) {
+                STATS_BEGIN(phase_output);
+                TRACE_BEGIN("pass", "output");
+                output_machine_code(&assm, &filedat, argv[cur_file]);
+                written = true;
+                TRACE_END("pass", "output");
+                STATS_END(phase_output);
+            }
+        }
         
-        /*Write output to the relevant files*/
-        if (filedat.error != true) {
-            output_machine_code(&assm, &filedat, argv[cur_file]);
+        if (METRICS) {
+            get_file_metrics(&metrics, argv[cur_file], &filedat);
         }
         
         /*cleanup*/
-        destroy_assm(&assm);
-        destroy_clist(&filedat.last_label, &destroy_item_label);
-        destroy_clist(&filedat.last_entry, &destroy_item_entry);
-        destroy_clist(&filedat.last_extern, &destroy_item_extern);
+        destroy_run_assm(&filedat, &assm);
+        PROBE_FILE_END(argv[cur_file], filedat.errors);
+        TRACE_END("file", argv[cur_file]);
         
-        if (filedat.error == true) {
-            puts("\nCompilation failed.");
-            printf("\nErrors found: %u", ERRORS);
-        } else {
-            puts("\nCompilation finished successfully.");
+        if (is_error_budget_spent(&filedat)) {
+            fprintf(stderr, "\nError limit (%d) reached, stopped "
+                            "processing the file.\n", filedat.max_errors);
         }
         
-        printf("\nLines parsed: %d\n", filedat.linenum);
+        if (!opts->quiet) {
+            print_file_result(&filedat, written);
+        }
+        
+        if (METRICS) {
+            write_file_metrics(&metrics);
+        }
+        
+        if (STATS) {
+            end_file_stats(filedat.linenum,
+                           (filedat.IC - IC_INIT) + filedat.DC, opts->stats);
+        }
         
         argc--; cur_file++;
     }
+    
+    if (opts->stats) {
+        print_batch_stats();
+    }
+    
+    if (opts->alloc_stats) {
+        print_alloc_stats(stdout);
+    }
+    
+    close_trace();
+    close_metrics();
 }
 
-/*The goals are to parse the line and write all the relevant information
-  about it to the assmt_t assm (labels are stored it filedat though). That is,
-  the instructions or data codes, and entry or extern declarations.*/
+/*Drives the first pass over the whole input file, line by line.*/
 static void first_pass(assm_t *assm, file_data *filedat, FILE *f_input) {
     char input[MAX_LINE];
     line_ret lineret; /*returned from get_line*/
-    bool exceed_machmem = false; /*a flag*/
+    bool sampled;     /*the line gets a trace span*/
     
-    /*stored here because all the tokens in statement actually
-      belong to filedat->last_token, we only duplicate the relevant
-      ones during the assembly stage*/
-    void *statement; /*stat_instr_t or stat_datadir_t*/
-    line_data lindat; /*data on the current line*/
-    #ifdef DEBUG_FPASS
-        int LAST_IC;
-        int LAST_DC;
-    #endif
-    
-    /*Get a line from the input file. If it's a comment, skip it completely.
-      If not, call the parser - it will attempt to acquire all the relevant
-      data from the line. If it fails, move on to the next line. If we
-      succeed, if the line had a label we add it to the label list,
-      and we sent the statement to assembler in order to convert it
-      to machine code (stored as decimal numbers). We continue until we reach
-      EOF in the input file.*/
-      
-    /*note that lin_out will return line_EOF (defined as 0) upon EOF*/
-    while ((lineret = get_line(f_input, MAX_LINE,
-                               init_string(input, MAX_LINE)))) {
-        init_first_pass(&lindat, filedat, &statement, &input[0]);
+    while (!0) {
+        STATS_BEGIN(phase_read);
+        lineret = get_line(f_input, MAX_LINE, init_string(input, MAX_LINE));
+        STATS_END(phase_read);
         
-        if (is_comment_or_empty_line(&input[0])) {
-            continue;
+        if (lineret == line_EOF) {
+            break;
         }
         
-        if (lineret == line_too_long) {
-            fprintf(stderr, "Line %d: Error, line too long.\n",
-                    filedat->linenum);
-            print_line(input);
-            /*minus one for the terminator*/
-            fprintf(stderr, "\nMax. line length allowed: %d.\n", MAX_LINE-1);
-            ERRORS++;
-            filedat->error = true;
-            continue;
+        /*first_pass_line counts the line*/
+        sampled = TRACE && (filedat->linenum+1) % TRACE_LINE_SAMPLE == 0;
+        if (sampled) {
+            trace_begin_line(filedat->linenum+1);
         }
         
-        #ifdef DEBUG_FPASS
-            printf("\nLine %d:\n", filedat->linenum);
-            print_line(input);
-        #endif
+        first_pass_line(assm, filedat, input, lineret);
         
-        /*lexer*/
-        tokenize_line(filedat);
-        if (filedat->last_token == NULL) { /*lexer error*/
-            destroy_clist(&filedat->last_token, &destroy_clist_token);
-            continue;
+        if (sampled) {
+            trace_end_line(filedat->linenum);
+            trace_counters(filedat);
         }
         
-        #ifdef DEBUG_FPASS
-            print_clist(filedat->last_token, &print_clist_token);
-            putchar('\n');
-        #endif
-        
-        /*parser*/
-        statement = parse_line(&lindat, filedat);
-        
-        #ifdef DEBUG_FPASS
-            print_statement(statement, lindat.stype);
-            LAST_IC = filedat->IC;
-            LAST_DC = filedat->DC;
-        #endif
-        
-        /*assembler*/
-        assemble_line(assm, statement, &lindat, filedat);
-        
-        /*check if we've exceeded MAX_MACHINE_MEM*/
-        if (exceed_machmem == false &&
-            (filedat->IC + filedat->DC) > MAX_MACHINE_MEM) {
-            exceed_machmem = true;
-            fprintf(stderr, "Line %d: Error, machine memory exceeded.\n",
-                    filedat->linenum);
-            print_line(input);
-            ERRORS++;
-            filedat->error = true;
+        if (is_error_budget_spent(filedat)) {
+            break;
         }
-        
-        #ifdef DEBUG_FPASS
-            if (statement != NULL) {
-                switch (lindat.stype) {
-                    case stype_instruction:
-                        print_clist_range(assm->last_instr,
-                                          (LAST_IC-IC_INIT),
-                                          (filedat->IC-IC_INIT),
-                                          &print_voidbin_as_word);
-                        break;
-                    case stype_datadir:
-                        if (((stat_ddir_t*)statement)->datadir != 
-                            datadir_entry &&
-                            ((stat_ddir_t*)statement)->datadir != 
-                            datadir_extern) {
-                            
-                            print_clist_range(assm->last_data,
-                                              (LAST_DC-DC_INIT),
-                                              (filedat->DC-DC_INIT),
-                                              &print_voidbin_as_word);
-                        }
-                        break;
-                    default:
-                        break;
-                }
-            }
-        #endif /*FPASS*/
-        
+    }
+    
+    if (TRACE) {
+        trace_counters(filedat);
+    }
+    
+    if (TRACE_CAT(TRACE_FPASS)) {
+        printf("\nFinal IC+DC: %d\n", filedat->IC+filedat->DC);
+    }
+}
+
+/*The goals are to parse the line and write all the relevant information
+  about it to the assmt_t assm (labels are stored it filedat though). That is,
+  the instructions or data codes, and entry or extern declarations. The
+  input and lineret are what get_line (or get_line_str) produced.*/
+void first_pass_line(assm_t *assm, file_data *filedat, char input[MAX_LINE],
+                     line_ret lineret) {
+    unsigned int prev_mem; /*IC+DC before the line was assembled*/
+    
+    /*stored here because all the tokens in statement actually
+      belong to filedat->last_token, we only duplicate the relevant
+      ones during the assembly stage*/
+    void *statement; /*stat_instr_t or stat_datadir_t*/
+    line_data lindat; /*data on the current line*/
+    int LAST_IC; /*for the fpass trace*/
+    int LAST_DC;
+    
+    /*If the line is a comment, skip it completely. If not, call the
+      parser - it will attempt to acquire all the relevant data from the
+      line. If it fails, move on to the next line. If we succeed, if the
+      line had a label we add it to the label list, and we sent the
+      statement to assembler in order to convert it to machine code
+      (stored as decimal numbers).*/
+    init_first_pass(&lindat, filedat, &statement, &input[0]);
+    PROBE_LINE_START(filedat->linenum);
+    
+    if (is_comment_or_empty_line(&input[0])) {
+        return;
+    }
+    
+    if (lineret == line_too_long) {
+        print_line_error(filedat, input, "Error, line too long.");
+        if (!filedat->collect_diag) {
+            /*minus one for the terminator*/
+            print_error_note(filedat, "Max. line length allowed: %d.\n",
+                             MAX_LINE-1);
+        }
+        return;
+    }
+    
+    if (TRACE_CAT(TRACE_FPASS)) {
+        printf("\nLine %d:\n", filedat->linenum);
+        print_line(input);
+    }
+    
+    /*lexer*/
+    STATS_BEGIN(phase_lexer);
+    tokenize_line(filedat);
+    STATS_END(phase_lexer);
+    STATS_TOKENS(filedat->last_token);
+    if (filedat->last_token == NULL) { /*lexer error*/
+        destroy_clist(&filedat->last_token, &destroy_clist_token);
+        return;
+    }
+    
+    if (TRACE_CAT(TRACE_FPASS)) {
+        print_clist(filedat->last_token, &print_clist_token);
+        putchar('\n');
+    }
+    
+    /*parser*/
+    STATS_BEGIN(phase_parser);
+    statement = parse_line(&lindat, filedat);
+    STATS_END(phase_parser);
+    
+    if (statement != NULL) {
+        PROBE_STATEMENT(filedat->linenum, lindat.stype);
+    }
+    
+    if (TRACE_CAT(TRACE_FPASS)) {
+        print_statement(statement, lindat.stype);
+    }
+    LAST_IC = filedat->IC;
+    LAST_DC = filedat->DC;
+    
+    /*the syntax check needs just the definitions, for the parser*/
+    if (filedat->syntax_only) {
+        define_line_symbols(statement, &lindat, filedat);
         destroy_statement(statement, lindat.stype);
         destroy_clist(&filedat->last_token, &destroy_clist_token);
+        return;
     }
     
-    #ifdef DEBUG_FPASS
-        printf("\nFinal IC+DC: %d\n", filedat->IC+filedat->DC);
-    #endif
+    /*assembler*/
+    prev_mem = filedat->IC + filedat->DC;
+    STATS_BEGIN(phase_assembler);
+    assemble_line(assm, statement, &lindat, filedat);
+    STATS_END(phase_assembler);
+    PROBE_WORDS(filedat->linenum, filedat->IC + filedat->DC - prev_mem);
+    
+    /*check if we've exceeded MAX_MACHINE_MEM, IC+DC never decreases
+      so this triggers only once*/
+    if (prev_mem <= MAX_MACHINE_MEM &&
+        (filedat->IC + filedat->DC) > MAX_MACHINE_MEM) {
+        print_line_error(filedat, input, "Error, machine memory exceeded.");
+    }
+    
+    if (TRACE_CAT(TRACE_FPASS)) {
+        if (statement != NULL) {
+            switch (lindat.stype) {
+                case stype_instruction:
+                    print_words(&assm->code, LAST_IC-IC_INIT,
+                                filedat->IC-LAST_IC);
+                    break;
+                case stype_datadir:
+                    if (((stat_ddir_t*)statement)->datadir != 
+                        datadir_entry &&
+                        ((stat_ddir_t*)statement)->datadir != 
+                        datadir_extern) {
+                        
+                        print_data_words(&assm->data, LAST_DC-DC_INIT,
+                                    filedat->DC-LAST_DC);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    destroy_statement(statement, lindat.stype);
+    destroy_clist(&filedat->last_token, &destroy_clist_token);
 }
 
 /*Driver for the second pass routine.*/
-static void second_pass(assm_t *assm, file_data *filedat, char *filename) {
+void second_pass(assm_t *assm, file_data *filedat, char *filename) {
     c_list *cur_extern;
     item_extern *p_extern;
     
-    second_pass_entry(assm, filedat, filename);
-    second_pass_undefid(assm, filedat, filename);
+    second_pass_entry(assm, filedat);
+    second_pass_undefid(assm, filedat);
     
     /*check if some of the declared externs
       were never used as operands*/
@@ -243,22 +370,28 @@ static void second_pass(assm_t *assm, file_data *filedat, char *filename) {
         p_extern = cur_extern->item;
         
         do {
+            if (is_error_budget_spent(filedat)) {
+                break;
+            }
+            
             if (p_extern->was_used == false) {
-                print_tok_error_assm(p_extern->tok, p_extern->linenum,
-                                     filename, filedat, "Error, declared "
-                                     "extern was never used as an operand.");
+                add_error_assm(assm, p_extern->tok, p_extern->linenum,
+                               filedat, "Error, declared "
+                               "extern was never used as an operand.");
             }
             
             cur_extern = cur_extern->next;
             p_extern = cur_extern->item;
         } while (cur_extern != filedat->last_extern->next);
     }
+    
+    /*all the errors of the second pass are printed together*/
+    print_errors_assm(assm, filename);
 }
 
 /*Populates the last_out_ent_ext with entry items and their final addresses.
   If entry is not found the filedat's label list - an error is printed.*/
-static void second_pass_entry(assm_t *assm, file_data *filedat,
-                              char *filename) {
+static void second_pass_entry(assm_t *assm, file_data *filedat) {
     c_list *cur_entry;
     item_entry *p_entry;
     item_label *p_label;
@@ -271,32 +404,29 @@ static void second_pass_entry(assm_t *assm, file_data *filedat,
     cur_entry = filedat->last_entry->next; /*point to head*/
     p_entry = cur_entry->item;
     do {
-        if ((p_label = find_clist_str(filedat->last_label,
+        if ((p_label = find_chash_str(&filedat->label_table,
                                       &find_item_label,
                                       p_entry->tok->tokstr)) != NULL) {
             
             add_clist(&assm->last_out_ent,
                       create_item_out_ent_ext(p_label->IC,
                                               p_label->tok->tokstr));
+            PROBE_SYMBOL_RESOLVE(p_label->tok->tokstr, p_label->IC);
         } else {
-            print_tok_error_assm(p_entry->tok, p_entry->linenum,
-                                 filename, filedat,
-                                "Error, entry was not defined as a label.");
+            add_error_assm(assm, p_entry->tok, p_entry->linenum, filedat,
+                           "Error, entry was not defined as a label.");
         }
         
         cur_entry = cur_entry->next;
         p_entry = cur_entry->item;
-    } while (cur_entry != filedat->last_entry->next);
+    } while (cur_entry != filedat->last_entry->next &&
+             !is_error_budget_spent(filedat));
 }
 
-/*Sets the proper addresses for the instructions in assm->last_instr. All the
+/*Sets the proper addresses for the instructions in assm->code. All the
   relevant (yet) undefined identifiers were stored in assm->last_undefid.
   Externs are dealt with here as well.*/
-static void second_pass_undefid(assm_t *assm, file_data *filedat,
-                                char *filename) {
-    int IC_counter = IC_INIT; /*targets the appropriate last_instr node*/
-    
-    c_list *instr_node; /*instruction list in assm*/
+static void second_pass_undefid(assm_t *assm, file_data *filedat) {
     c_list *undefid_node; /*undefined identifier list in assm*/
     
     /*item pointers for ease of use*/
@@ -310,66 +440,62 @@ static void second_pass_undefid(assm_t *assm, file_data *filedat,
     }
     
     /*no instructions*/
-    if (assm->last_instr == NULL) {
+    if (assm->code.count == 0) {
         return;
     }
     
-    #ifdef DEBUG_SPASS
+    if (TRACE_CAT(TRACE_SPASS)) {
         puts("Second pass feed:\n-----------------\nUndefid:");
         print_clist(assm->last_undefid, &print_item_undefid);
         puts("\nLabels:");
         print_clist(filedat->last_label, &print_item_label);
-    #endif
+    }
     
-    /*iterate through the undefid list*/
-    instr_node = assm->last_instr->next; /*point to the head*/
+    /*iterate through the undefid list, the dummy word of every one is
+      patched in place*/
     undefid_node = assm->last_undefid->next; /*point to the head*/
     p_undefid = undefid_node->item;
     do {
-        /*point to the relevant instruction in the
-          instruction list based on the IC values*/
-        while (p_undefid->IC != IC_counter) {
-            instr_node = instr_node->next;
-            IC_counter++;
-        }
-        
         /*extern lookup*/
-        if ((p_extern = find_clist_str(filedat->last_extern,
+        if ((p_extern = find_chash_str(&filedat->extern_table,
                                         &find_item_extern,
                                         p_undefid->tok->tokstr)) != NULL) {
             
-            *((int*)instr_node->item) = ARE_EXTERN;
+            set_word(&assm->code, p_undefid->IC-IC_INIT, ARE_EXTERN);
             /*note that tokstr's *pointer* is copied*/
             add_clist(&assm->last_out_ext, 
-                      create_item_out_ent_ext(IC_counter, 
+                      create_item_out_ent_ext(p_undefid->IC, 
                                               p_undefid->tok->tokstr));
             p_extern->was_used = true;
+            PROBE_SYMBOL_RESOLVE(p_undefid->tok->tokstr, 0);
         /*label lookup*/
-        } else if ((p_label = find_clist_str(filedat->last_label,
+        } else if ((p_label = find_chash_str(&filedat->label_table,
                                             &find_item_label,
                                             p_undefid->tok->tokstr)) != NULL) {
-            *((int*)instr_node->item) = (p_label->IC << SHIFT_8BIT) +
-                                        ARE_RELOC;
+            set_word(&assm->code, p_undefid->IC-IC_INIT,
+                     (p_label->IC << SHIFT_8BIT) + ARE_RELOC);
+            PROBE_SYMBOL_RESOLVE(p_undefid->tok->tokstr, p_label->IC);
         /*nope, this one wasn't declared at all*/
         } else {
-            print_tok_error_assm(p_undefid->tok, p_undefid->linenum, filename,
-                             filedat, "Error, undeclared identifier.");
+            add_error_assm(assm, p_undefid->tok, p_undefid->linenum,
+                           filedat, "Error, undeclared identifier.");
         }
         
         undefid_node = undefid_node->next;
         p_undefid = undefid_node->item;
-    } while (undefid_node != assm->last_undefid->next);
+    } while (undefid_node != assm->last_undefid->next &&
+             !is_error_budget_spent(filedat));
 }
 
 /*Applies the passed IC offset to the data statement labels.*/
-static void apply_IC_offset(c_list *last_label, int IC) {
+void apply_IC_offset(c_list *last_label, int IC) {
     c_list *cur_label;
     item_label *p_label;
     
     if (last_label == NULL) {
         return;
     }
-   
+    
     cur_label = last_label->next;
     p_label = (item_label*)cur_label->item;
     do {
@@ -385,21 +511,130 @@ static void apply_IC_offset(c_list *last_label, int IC) {
 /*Initializes the run_assm. Setting the lists to NULL is done as a safety
   precaution since the destroyer should take care of it. But in any case,
   since the overhead is tiny, might as well.*/
-static void init_run_assm(file_data *filedat, assm_t *assm) {
+void init_run_assm(file_data *filedat, assm_t *assm) {
     filedat->IC          = IC_INIT;
     filedat->DC          = DC_INIT;
     filedat->error       = false;
+    filedat->errors      = 0;
+    filedat->max_errors  = 0;
     filedat->linenum     = 0;
     filedat->last_token  = NULL;
     filedat->last_label  = NULL;
     filedat->last_entry  = NULL;
     filedat->last_extern = NULL;
+    init_chash(&filedat->label_table, &get_item_label_key);
+    init_chash(&filedat->entry_table, &get_item_entry_key);
+    init_chash(&filedat->extern_table, &get_item_extern_key);
+    filedat->collect_diag = false;
+    filedat->syntax_only = false;
+    filedat->obj_format  = OBJ_FORMAT_TEXT;
+    filedat->map_format  = MAP_FORMAT_NONE;
+    filedat->last_diag   = NULL;
+    filedat->err_queue   = NULL;
     
-    assm->last_instr     = NULL;
-    assm->last_data      = NULL;
+    init_word_image(&assm->code);
+    init_data_image(&assm->data);
     assm->last_undefid   = NULL;
     assm->last_out_ent   = NULL;
     assm->last_out_ext   = NULL;
+    assm->last_err       = NULL;
+    assm->last_queued    = NULL;
+    init_chash(&assm->err_table, &get_err_assm_key);
+}
+
+/*Cleans up after init_run_assm and the passes.*/
+void destroy_run_assm(file_data *filedat, assm_t *assm) {
+    destroy_assm(assm);
+    destroy_chash(&filedat->label_table);
+    destroy_chash(&filedat->entry_table);
+    destroy_chash(&filedat->extern_table);
+    destroy_clist(&filedat->last_label, &destroy_item_label);
+    destroy_clist(&filedat->last_entry, &destroy_item_entry);
+    destroy_clist(&filedat->last_extern, &destroy_item_extern);
+    destroy_clist(&filedat->last_diag, &destroy_item_diag);
+}
+
+/*Creates the context for an assembly fed with assm_feed. The options in
+  ctx->filedat (max_errors, syntax_only) may be set before the first feed.*/
+assm_ctx *create_assm_ctx(void) {
+    assm_ctx *ctx = mem_alloc(sizeof(assm_ctx), mem_other);
+    if (ctx == NULL) {
+        fprintf(stderr, "Malloc failure in create_assm_ctx.");
+        exit(1);
+    }
+    
+    init_run_assm(&ctx->filedat, &ctx->assm);
+    init_string(ctx->line, MAX_LINE);
+    ctx->length   = 0;
+    ctx->too_long = false;
+    ctx->label    = NULL;
+    
+    return ctx;
+}
+
+/*Runs the first pass on the complete lines in the n bytes, the trailing
+  partial line is kept in ctx until the rest of it is fed. Never waits for
+  more input. Lines that are too long are cut at MAX_LINE (and reported
+  like get_line does), so the buffering never grows.*/
+void assm_feed(assm_ctx *ctx, const char *bytes, int n) {
+    int i;
+    
+    for (i = 0; i < n; i++) {
+        /*there's no point in going on once the error budget is spent,
+          the rest of the input is just dropped*/
+        if (is_error_budget_spent(&ctx->filedat)) {
+            return;
+        }
+        
+        if (bytes[i] == '\n') {
+            feed_line(ctx);
+        } else if (ctx->length < MAX_LINE-1) {
+            ctx->line[ctx->length++] = bytes[i];
+        } else {
+            ctx->too_long = true;
+        }
+    }
+}
+
+/*Runs the first pass on the last line (if it didn't end with \n) and
+  then the second pass. The results are left in ctx->assm, same as after
+  the passes in run_assm. Returns true if no errors were found.*/
+bool assm_finish(assm_ctx *ctx) {
+    if ((ctx->length > 0 || ctx->too_long) &&
+        !is_error_budget_spent(&ctx->filedat)) {
+        feed_line(ctx);
+    }
+    
+    if (ctx->filedat.syntax_only == false &&
+        !is_error_budget_spent(&ctx->filedat)) {
+        apply_IC_offset(ctx->filedat.last_label, ctx->filedat.IC);
+        /*no file to read the erroneous lines from*/
+        second_pass(&ctx->assm, &ctx->filedat, NULL);
+    }
+    
+    return ctx->filedat.error == false;
+}
+
+/*Frees ctx and everything the passes left in it.*/
+void destroy_assm_ctx(assm_ctx *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    
+    destroy_token(ctx->label);
+    destroy_clist(&ctx->filedat.last_token, &destroy_clist_token);
+    destroy_run_assm(&ctx->filedat, &ctx->assm);
+    mem_free(ctx);
+}
+
+/*Sends the buffered line to the first pass and empties the buffer.*/
+static void feed_line(assm_ctx *ctx) {
+    first_pass_line(&ctx->assm, &ctx->filedat, ctx->line,
+                    ctx->too_long ? line_too_long : line_ok);
+    
+    init_string(ctx->line, MAX_LINE);
+    ctx->length   = 0;
+    ctx->too_long = false;
 }
 
 /*Initializes all the relevant passed arguments for the first pass.*/
@@ -433,19 +668,86 @@ static bool has_initial_wspace(const char *line) {
     return false;
 }
 
-/*DEBUG*/
+/*Prints an error that concerns the whole line (as opposed to a token).*/
+static void print_line_error(file_data *filedat, char *input,
+                             char *message) {
+    token *tok;
+    
+    set_error(filedat);
+    
+    if (filedat->collect_diag) {
+        add_diag(filedat, filedat->linenum, 0, strlen(input), message);
+        return;
+    }
+    
+    /*queued under the whole line, as if it were a token*/
+    if (filedat->err_queue != NULL) {
+        tok = create_token(0, strlen(input), input);
+        tok->toktype = toktype_unknown;
+        queue_error_assm(filedat->err_queue, tok, filedat->linenum, message,
+                         NULL);
+        destroy_token(tok);
+        return;
+    }
+    
+    fprintf(stderr, "Line %d: %s\n", filedat->linenum, message);
+    print_line(input);
+}
+
+/*Prints the line without the leading whitespace, and with the tabs as
+  spaces.*/
 static void print_line(char *str) {
+    int i = 0;
+    char line[MAX_LINE];
+    
     while (*str == ' ' || *str == '\t') {
         str++;
     }
     
-    while (*str != '\n' && *str != '\0') {
-        if (*str == '\t') {
-            printf(" ");
-        } else {
-            printf("%c", *str);
-        }
-       str++;
+    while (*str != '\n' && *str != '\0' && i < MAX_LINE-1) {
+        line[i++] = (*str == '\t') ? ' ' : *str;
+        str++;
     }
-    printf("\n----------------------\n");
+    line[i] = '\0';
+    
+    printf("%s\n----------------------\n", line);
+}
+
+/*Traces the growth of the code and of the symbol tables.*/
+static void trace_counters(file_data *filedat) {
+    trace_counter("IC", filedat->IC);
+    trace_counter("DC", filedat->DC);
+    trace_counter("labels", filedat->label_table.count);
+    trace_counter("entries", filedat->entry_table.count);
+    trace_counter("externs", filedat->extern_table.count);
+}
+
+/*Fills the metrics of the file, before filedat is destroyed.*/
+static void get_file_metrics(file_metrics *metrics, const char *name,
+                             file_data *filedat) {
+    metrics->name       = name;
+    metrics->lines      = filedat->linenum;
+    metrics->IC         = filedat->IC;
+    metrics->DC         = filedat->DC;
+    metrics->code_words = filedat->IC - IC_INIT;
+    metrics->data_words = filedat->DC - DC_INIT;
+    metrics->labels     = filedat->label_table.count;
+    metrics->entries    = filedat->entry_table.count;
+    metrics->externs    = filedat->extern_table.count;
+    metrics->errors     = filedat->errors;
+}
+
+/*Prints whether the file was assembled (its output written, unless it's
+  just the syntax check), and the lines it had.*/
+static void print_file_result(file_data *filedat, bool written) {
+    if (filedat->error == true || (!filedat->syntax_only && !written)) {
+        puts(filedat->syntax_only ? "\nSyntax check failed." :
+                                    "\nCompilation failed.");
+        printf("\nErrors found: %u", ERRORS);
+    } else {
+        puts(filedat->syntax_only ? "\nSyntax check passed." :
+                                    "\nCompilation finished successfully.");
+    }
+    
+    printf("\nLines parsed: %d\n", filedat->linenum);
 }
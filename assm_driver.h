@@ -1,6 +1,32 @@
 #ifndef ASSM_DRIVER_H
 #define ASSM_DRIVER_H
 
-void run_assm(int argc, char **argv);
+/*State of an assembly that is fed from memory, in pieces (see assm_feed).
+  Only the current partial line is buffered, everything else is the usual
+  first pass state.*/
+typedef struct assm_ctx {
+    assm_t assm;
+    file_data filedat;
+    char line[MAX_LINE]; /*the current partial line*/
+    int length;          /*chars stored in line*/
+    bool too_long;       /*the current line didn't fit into line*/
+    token *label;        /*for the next emitted statement (builder.c)*/
+} assm_ctx;
+
+void run_assm(int argc, char **argv, run_opts *opts);
+
+/*for running the passes on input that doesn't come from a file*/
+void init_run_assm(file_data *filedat, assm_t *assm);
+void first_pass_line(assm_t *assm, file_data *filedat, char input[MAX_LINE],
+                     line_ret lineret);
+void apply_IC_offset(c_list *last_label, int IC);
+void second_pass(assm_t *assm, file_data *filedat, char *filename);
+void destroy_run_assm(file_data *filedat, assm_t *assm);
+
+/*for input that arrives in pieces*/
+assm_ctx *create_assm_ctx(void);
+void assm_feed(assm_ctx *ctx, const char *bytes, int n);
+bool assm_finish(assm_ctx *ctx);
+void destroy_assm_ctx(assm_ctx *ctx);
                     
 #endif /*ASSM_DRIVER_H*/
@@ -0,0 +1,72 @@
+/*Builds gtest_1.as through the builder (see builder.c) instead of the
+  text, so that its output can be compared with the assembler's.
+  
+  Usage: buildcheck out_name
+  
+  Writes the files of out_name (out_name.ob, .ent and .ext), the same
+  ones that the assembler writes for gtest_1. Exits with 1 if the
+  statements don't assemble. See the check-build target of the Makefile.*/
+
+#include <stdio.h>
+
+#include "bool.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
+#include "assm_driver.h"
+#include "builder.h"
+
+int main(int argc, char **argv) {
+    static const int nums[] = {5, -5, 29, -29, 156};
+    assm_ctx *ctx;
+    bool ok;
+    
+    if (argc != 2) {
+        fprintf(stderr, "Usage: buildcheck out_name\n");
+        return 2;
+    }
+    
+    ctx = create_assm_ctx();
+    
+    declare_entry(ctx, "main");
+    declare_extern(ctx, "str");
+    
+    define_label(ctx, "main");
+    emit_instr(ctx, OP_MOV, build_opd_dir(ctx, "str"), build_opd_reg(1));
+    emit_instr(ctx, OP_SUB, build_opd_reg(1), build_opd_reg(2));
+    emit_instr(ctx, OP_INC, NULL, build_opd_reg(2));
+    emit_instr(ctx, OP_RTS, NULL, NULL);
+    
+    define_label(ctx, "s");
+    emit_struct(ctx, 7, "qwerty");
+    
+    define_label(ctx, "loop");
+    emit_instr(ctx, OP_MOV, build_opd_reg(2), build_opd_reg(3));
+    emit_instr(ctx, OP_NOT, NULL, build_opd_dir(ctx, "str"));
+    emit_instr(ctx, OP_CLR, NULL, build_opd_dir(ctx, "s"));
+    emit_instr(ctx, OP_LEA, build_opd_dir(ctx, "str"),
+               build_opd_dir(ctx, "loop"));
+    emit_instr(ctx, OP_DEC, NULL, build_opd_reg(2));
+    emit_instr(ctx, OP_JMP, NULL, build_opd_dir(ctx, "main"));
+    emit_instr(ctx, OP_BNE, NULL, build_opd_dir(ctx, "loop"));
+    emit_instr(ctx, OP_RED, NULL, build_opd_reg(7));
+    emit_instr(ctx, OP_STOP, NULL, NULL);
+    
+    define_label(ctx, "label");
+    emit_data(ctx, nums, sizeof(nums)/sizeof(nums[0]));
+    
+    emit_string(ctx, "zxcv");
+    
+    ok = assm_finish(ctx);
+    if (ok) {
+        output_machine_code(&ctx->assm, &ctx->filedat, argv[1]);
+    }
+    
+    destroy_assm_ctx(ctx);
+    
+    return ok ? 0 : 1;
+}
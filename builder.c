@@ -0,0 +1,528 @@
+/*Builds the statements directly, bypassing the lexer and the parser. This
+  is for compilers that would otherwise print assembly text just for us to
+  read it back. The statements get the same checks as the parsed ones and
+  go through assemble_line, so the second pass (see assm_finish) and the
+  output can't tell the difference.
+  
+  Every emitted statement counts as a line, the errors are reported with
+  that number. A label from define_label belongs to the next emitted
+  instruction or data statement (entries and externs don't take labels).*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "clist.h"
+#include "token.h"
+#include "statement.h"
+#include "filedata.h"
+#include "parser.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
+#include "assm_driver.h"
+#include "builder.h"
+
+#define MAX_REG 7 /*registers r8 and r9 are reserved words, not registers*/
+
+static token *build_token(const char *str);
+static bool declare_symbol(assm_ctx *ctx, const char *name, data_dir ddir,
+                           char *(*get_error)(file_data*, token*, int*,
+                                              bool*));
+static bool start_statement(assm_ctx *ctx);
+static void drop_statement(assm_ctx *ctx);
+static void assemble_built(assm_ctx *ctx, void *stat, stat_type stype,
+                           bool use_label);
+
+static bool check_operand(assm_ctx *ctx, operand_t *opd,
+                          const int *valid_modes);
+static bool check_name(file_data *filedat, int linenum, token *tok);
+static bool check_string(assm_ctx *ctx, const char *str);
+static char *quote_string(const char *str);
+static void print_build_error(file_data *filedat, int linenum,
+                              char *message);
+static void print_build_warning(file_data *filedat, int linenum,
+                                char *message);
+
+static char empty_line[] = ""; /*current_line of the built statements*/
+
+/*Creates the immediate operand (#num).*/
+operand_t *build_opd_imm(int num) {
+    operand_data *opd_data = mem_alloc(sizeof(operand_data), mem_parser);
+    if (opd_data == NULL) {
+        fprintf(stderr, "Malloc failure in build_opd_imm.");
+        exit(1);
+    }
+    
+    opd_data->number = num;
+    
+    return create_operand(0, 0, addmode_imm, opd_data);
+}
+
+/*Creates the direct operand (a label or an extern).*/
+operand_t *build_opd_dir(assm_ctx *ctx, const char *name) {
+    token *tok = build_token(name);
+    operand_data *opd_data = mem_alloc(sizeof(operand_data), mem_parser);
+    if (opd_data == NULL) {
+        fprintf(stderr, "Malloc failure in build_opd_dir.");
+        exit(1);
+    }
+    
+    /*the statement's tokens live in last_token, same as with the parser*/
+    add_clist(&ctx->filedat.last_token, tok);
+    opd_data->identifier = tok;
+    
+    return create_operand(0, 0, addmode_dir, opd_data);
+}
+
+/*Creates the struct operand (name.field).*/
+operand_t *build_opd_struct(assm_ctx *ctx, const char *name, int field) {
+    token *tok = build_token(name);
+    operand_data *opd_data = mem_alloc(sizeof(operand_data), mem_parser);
+    struct_opd_t *structure = mem_alloc(sizeof(struct_opd_t), mem_parser);
+    if (opd_data == NULL || structure == NULL) {
+        fprintf(stderr, "Malloc failure in build_opd_struct.");
+        exit(1);
+    }
+    
+    add_clist(&ctx->filedat.last_token, tok);
+    structure->field      = field;
+    structure->identifier = tok;
+    opd_data->structure   = structure;
+    
+    return create_operand(0, 0, addmode_struct, opd_data);
+}
+
+/*Creates the register operand (r0 through r7).*/
+operand_t *build_opd_reg(int reg_num) {
+    operand_data *opd_data = mem_alloc(sizeof(operand_data), mem_parser);
+    if (opd_data == NULL) {
+        fprintf(stderr, "Malloc failure in build_opd_reg.");
+        exit(1);
+    }
+    
+    opd_data->reg_num = reg_num;
+    
+    return create_operand(0, 0, addmode_reg, opd_data);
+}
+
+/*Sets the label of the next emitted instruction or data statement.
+  Returns false (and prints an error) if the label can't be defined.*/
+bool define_label(assm_ctx *ctx, const char *name) {
+    token *tok;
+    char *message;
+    int prev_linenum;
+    int linenum = ctx->filedat.linenum+1; /*of the labeled statement*/
+    
+    if (is_error_budget_spent(&ctx->filedat)) {
+        return false;
+    }
+    
+    if (ctx->label != NULL) {
+        print_build_error(&ctx->filedat, linenum,
+                          "Error, statement already has a label.");
+        return false;
+    }
+    
+    tok = build_token(name);
+    if (tok->toktype != toktype_identifier && !is_reserved_word(tok)) {
+        print_build_error(&ctx->filedat, linenum,
+                          "Error, invalid identifier.");
+        destroy_token(tok);
+        return false;
+    }
+    
+    message = get_label_error(&ctx->filedat.label_table, &ctx->filedat, tok,
+                              &prev_linenum);
+    if (message != NULL) {
+        print_build_error(&ctx->filedat, linenum, message);
+        destroy_token(tok);
+        return false;
+    }
+    
+    ctx->label = tok;
+    
+    return true;
+}
+
+/*Emits the instruction. The operands that the opcode doesn't take must
+  be NULL, a single operand is always the destination. The operands are
+  freed either way. Returns false (and prints an error) if the
+  instruction is invalid.*/
+bool emit_instr(assm_ctx *ctx, int opcode, operand_t *src, operand_t *dst) {
+    bool valid;
+    int opds = (src != NULL) + (dst != NULL);
+    
+    if (!start_statement(ctx)) {
+        destroy_operand(src);
+        destroy_operand(dst);
+        return false;
+    }
+    
+    if (opcode < OP_MOV || opcode > OP_STOP) {
+        print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                          "Error, unknown operator.");
+        valid = false;
+    } else if (opds != OPS[opcode].opds || (opds == 1 && src != NULL)) {
+        print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                          "Error, wrong number of operands.");
+        valid = false;
+    } else {
+        valid = check_operand(ctx, src, OPS[opcode].src_mode) &&
+                check_operand(ctx, dst, OPS[opcode].dst_mode);
+    }
+    
+    if (!valid) {
+        destroy_operand(src);
+        destroy_operand(dst);
+        drop_statement(ctx);
+        return false;
+    }
+    
+    assemble_built(ctx, create_stat_inst(opcode, src, dst),
+                   stype_instruction, true);
+    
+    return true;
+}
+
+/*Emits the .data statement with count numbers.*/
+bool emit_data(assm_ctx *ctx, const int *nums, int count) {
+    int i;
+    int num;
+    unsigned int *new_num;
+    c_list *data_list = NULL;
+    
+    if (!start_statement(ctx)) {
+        return false;
+    }
+    
+    if (count <= 0) {
+        print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                          "Error, data statement has no numbers.");
+        drop_statement(ctx);
+        return false;
+    }
+    
+    for (i = 0; i < count; i++) {
+        num = nums[i];
+        if (!is_int_within_bounds(num, numt_tenbit)) {
+            print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                              "Error, number out of bounds.");
+            destroy_clist(&data_list, &mem_free);
+            drop_statement(ctx);
+            return false;
+        }
+        
+        /*get 2s complement*/
+        if (num < 0) {
+            num = num + (TENBIT_MAX+1)*2;
+        }
+        
+        new_num = mem_alloc(sizeof(unsigned int), mem_code);
+        if (new_num == NULL) {
+            fprintf(stderr, "Malloc failure in emit_data.");
+            exit(1);
+        }
+        
+        *new_num = num;
+        add_clist(&data_list, new_num);
+    }
+    
+    assemble_built(ctx, create_stat_ddir(datadir_data,
+                                         create_ddir_data(count, data_list)),
+                   stype_datadir, true);
+    
+    return true;
+}
+
+/*Emits the .string statement, str is given without the quotes.*/
+bool emit_string(assm_ctx *ctx, const char *str) {
+    if (!start_statement(ctx)) {
+        return false;
+    }
+    
+    if (!check_string(ctx, str)) {
+        drop_statement(ctx);
+        return false;
+    }
+    
+    assemble_built(ctx, create_stat_ddir(datadir_string, quote_string(str)),
+                   stype_datadir, true);
+    
+    return true;
+}
+
+/*Emits the .struct statement, str is given without the quotes.*/
+bool emit_struct(assm_ctx *ctx, int num, const char *str) {
+    char *quoted;
+    token *tok;
+    
+    if (!start_statement(ctx)) {
+        return false;
+    }
+    
+    if (!is_int_within_bounds(num, numt_tenbit)) {
+        print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                          "Error, number out of bounds.");
+        drop_statement(ctx);
+        return false;
+    } else if (!check_string(ctx, str)) {
+        drop_statement(ctx);
+        return false;
+    }
+    
+    /*get 2s complement*/
+    if (num < 0) {
+        num = num + (TENBIT_MAX+1)*2;
+    }
+    
+    /*the struct's string isn't freed with the statement, it's
+      supposed to be a token's*/
+    quoted = quote_string(str);
+    tok = build_token(quoted);
+    mem_free(quoted);
+    add_clist(&ctx->filedat.last_token, tok);
+    
+    assemble_built(ctx, create_stat_ddir(datadir_struct,
+                                         create_ddir_struct(num, tok->tokstr)),
+                   stype_datadir, true);
+    
+    return true;
+}
+
+/*Emits the .entry statement.*/
+bool declare_entry(assm_ctx *ctx, const char *name) {
+    return declare_symbol(ctx, name, datadir_entry, &get_entry_error);
+}
+
+/*Emits the .extern statement.*/
+bool declare_extern(assm_ctx *ctx, const char *name) {
+    return declare_symbol(ctx, name, datadir_extern, &get_extern_error);
+}
+
+/*Emits the .entry or .extern statement (ddir), with the checks of the
+  parser (get_error). A declaration that only draws a warning is dropped
+  like in the parser, but it isn't counted as a failure.*/
+static bool declare_symbol(assm_ctx *ctx, const char *name, data_dir ddir,
+                           char *(*get_error)(file_data*, token*, int*,
+                                              bool*)) {
+    token *tok;
+    char *message;
+    int prev_linenum;
+    bool warning;
+    
+    if (!start_statement(ctx)) {
+        return false;
+    }
+    
+    tok = build_token(name);
+    add_clist(&ctx->filedat.last_token, tok);
+    if (!check_name(&ctx->filedat, ctx->filedat.linenum, tok)) {
+        destroy_clist(&ctx->filedat.last_token, &destroy_clist_token);
+        return false;
+    }
+    
+    message = get_error(&ctx->filedat, tok, &prev_linenum, &warning);
+    if (message != NULL) {
+        if (warning) {
+            print_build_warning(&ctx->filedat, ctx->filedat.linenum,
+                                message);
+        } else {
+            print_build_error(&ctx->filedat, ctx->filedat.linenum, message);
+        }
+        print_error_note(&ctx->filedat, "Previously defined at "
+                         "Statement %d.\n", prev_linenum);
+        destroy_clist(&ctx->filedat.last_token, &destroy_clist_token);
+        return warning;
+    }
+    
+    assemble_built(ctx, create_stat_ddir(ddir, tok), stype_datadir, false);
+    
+    return true;
+}
+
+/*Creates a token out of str, with the type the lexer would give it.*/
+static token *build_token(const char *str) {
+    token *tok = create_token(0, strlen(str), (char*)str);
+    
+    tok->toktype = get_toktype(tok);
+    
+    return tok;
+}
+
+/*Counts the new statement. Returns false if there's no point in
+  building it, since the error budget is spent.*/
+static bool start_statement(assm_ctx *ctx) {
+    if (is_error_budget_spent(&ctx->filedat)) {
+        return false;
+    }
+    
+    ctx->filedat.linenum++;
+    ctx->filedat.current_line = empty_line;
+    
+    return true;
+}
+
+/*Cleans up after an invalid statement. Like with the parser, the label
+  goes down with its statement.*/
+static void drop_statement(assm_ctx *ctx) {
+    destroy_token(ctx->label);
+    ctx->label = NULL;
+    destroy_clist(&ctx->filedat.last_token, &destroy_clist_token);
+}
+
+/*The first_pass_line of the built statements: assembles the (valid)
+  statement stat and cleans up after it.*/
+static void assemble_built(assm_ctx *ctx, void *stat, stat_type stype,
+                           bool use_label) {
+    unsigned int prev_mem = ctx->filedat.IC + ctx->filedat.DC;
+    line_data lindat;
+    
+    lindat.label_token        = use_label ? ctx->label : NULL;
+    lindat.valid_label        = (lindat.label_token != NULL);
+    lindat.label_error        = false;
+    lindat.has_initial_wspace = false;
+    lindat.stype              = stype;
+    
+    if (ctx->filedat.syntax_only) {
+        define_line_symbols(stat, &lindat, &ctx->filedat);
+    } else {
+        assemble_line(&ctx->assm, stat, &lindat, &ctx->filedat);
+        
+        if (prev_mem <= MAX_MACHINE_MEM &&
+            (ctx->filedat.IC + ctx->filedat.DC) > MAX_MACHINE_MEM) {
+            print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                              "Error, machine memory exceeded.");
+        }
+    }
+    
+    destroy_statement(stat, stype);
+    if (use_label) {
+        destroy_token(ctx->label);
+        ctx->label = NULL;
+    }
+    destroy_clist(&ctx->filedat.last_token, &destroy_clist_token);
+}
+
+/*Checks the operand against the valid addressing modes of the operator
+  and the limits of the language. An immediate is converted into its 2s
+  complement on the way. NULL operands are fine.*/
+static bool check_operand(assm_ctx *ctx, operand_t *opd,
+                          const int *valid_modes) {
+    file_data *filedat = &ctx->filedat;
+    
+    if (opd == NULL) {
+        return true;
+    }
+    
+    if (!valid_modes[opd->addmode]) {
+        print_build_error(filedat, filedat->linenum,
+                          "Error, invalid addressing mode.");
+        return false;
+    }
+    
+    switch (opd->addmode) {
+        case addmode_imm:
+            if (!is_int_within_bounds(opd->data->number, numt_eightbit)) {
+                print_build_error(filedat, filedat->linenum,
+                                  "Error, number out of bounds.");
+                return false;
+            }
+            
+            if (opd->data->number < 0) {
+                opd->data->number += (EIGHTBIT_MAX+1)*2;
+            }
+            break;
+        case addmode_dir:
+            return check_name(filedat, filedat->linenum,
+                              opd->data->identifier);
+        case addmode_struct:
+            if (opd->data->structure->field != 1 &&
+                opd->data->structure->field != 2) {
+                print_build_error(filedat, filedat->linenum,
+                                  "Error, struct field must be 1 or 2.");
+                return false;
+            }
+            
+            return check_name(filedat, filedat->linenum,
+                              opd->data->structure->identifier);
+        case addmode_reg:
+            if (opd->data->reg_num < 0 || opd->data->reg_num > MAX_REG) {
+                print_build_error(filedat, filedat->linenum,
+                                  "Error, invalid register. Valid registers "
+                                  "are 0 through 7 (inclusive).");
+                return false;
+            }
+            break;
+    }
+    
+    return true;
+}
+
+/*Checks that tok can be used as an identifier, with the checks of the
+  parser.*/
+static bool check_name(file_data *filedat, int linenum, token *tok) {
+    if (is_reserved_word(tok)) {
+        print_build_error(filedat, linenum,
+                          "Error, this token is a reserved word.");
+        return false;
+    } else if (tok->toktype != toktype_identifier) {
+        print_build_error(filedat, linenum, "Error, invalid identifier.");
+        return false;
+    } else if (!is_ident_length_ok(tok->tokstr)) {
+        print_build_error(filedat, linenum, "Error, identifier is too long.");
+        return false;
+    }
+    
+    return true;
+}
+
+/*Checks that str can be put between quotes in the source.*/
+static bool check_string(assm_ctx *ctx, const char *str) {
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || !isprint((unsigned char)*str)) {
+            print_build_error(&ctx->filedat, ctx->filedat.linenum,
+                              "Error, invalid character in string.");
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/*Returns a malloc'd copy of str in quotes, the way the lexer stores the
+  string literals.*/
+static char *quote_string(const char *str) {
+    char *quoted = mem_alloc(sizeof(char)*(strlen(str)+3), mem_parser);
+    if (quoted == NULL) {
+        fprintf(stderr, "Malloc failure in quote_string.");
+        exit(1);
+    }
+    
+    sprintf(quoted, "\"%s\"", str);
+    
+    return quoted;
+}
+
+/*Prints an error of a built statement. There's no source line to show,
+  so only the statement number is given.*/
+static void print_build_error(file_data *filedat, int linenum,
+                              char *message) {
+    set_error(filedat);
+    print_build_warning(filedat, linenum, message);
+}
+
+/*Prints a warning of a built statement, which unlike print_build_error
+  doesn't count as an error.*/
+static void print_build_warning(file_data *filedat, int linenum,
+                                char *message) {
+    if (filedat->collect_diag) {
+        add_diag(filedat, linenum, 0, 0, message);
+        return;
+    }
+    
+    fprintf(stderr, "Statement %d: %s\n", linenum, message);
+}
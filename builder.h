@@ -0,0 +1,19 @@
+#ifndef BUILDER_H
+#define BUILDER_H
+
+/*operands, owned by the emit_instr they're passed to*/
+operand_t *build_opd_imm(int num);
+operand_t *build_opd_dir(assm_ctx *ctx, const char *name);
+operand_t *build_opd_struct(assm_ctx *ctx, const char *name, int field);
+operand_t *build_opd_reg(int reg_num);
+
+/*statements*/
+bool define_label(assm_ctx *ctx, const char *name);
+bool emit_instr(assm_ctx *ctx, int opcode, operand_t *src, operand_t *dst);
+bool emit_data(assm_ctx *ctx, const int *nums, int count);
+bool emit_string(assm_ctx *ctx, const char *str);
+bool emit_struct(assm_ctx *ctx, int num, const char *str);
+bool declare_entry(assm_ctx *ctx, const char *name);
+bool declare_extern(assm_ctx *ctx, const char *name);
+
+#endif /*BUILDER_H*/
@@ -3,15 +3,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "bool.h"
+#include "alloc.h"
 #include "clist.h"
 
+#define CHASH_INIT_SIZE 16
+#define CHASH_MAX_LOAD  1 /*items per bucket before the table grows*/
+
+static void grow_chash(c_hash *table);
+static void keep_item(void *item);
+
 /*Adds a new item to the list. The last node of the list must be provided.
   If the last node is null, this, in effect, creates the first node of
   the list.*/
 void add_clist(c_list **last_node, void *item) {
     c_list *new_node;
-   
-    new_node = malloc(sizeof(c_list));
+    
+    new_node = mem_alloc(sizeof(c_list), mem_lists);
     if (new_node == NULL) {
         fprintf(stderr, "Malloc failure in add_clist.");
         exit(1);
@@ -43,12 +51,12 @@ void destroy_clist(c_list **last_node, void(*item_destroyer)(void *)) {
     /*converts to singly linked list for ease of use*/
     cur_node = (*last_node)->next;
     (*last_node)->next = NULL;
-
+    
     while (cur_node != NULL) {
         next_node = cur_node->next;
         
         (*item_destroyer)(cur_node->item);
-        free(cur_node);
+        mem_free(cur_node);
         
         cur_node = next_node;
     }
@@ -56,13 +64,47 @@ void destroy_clist(c_list **last_node, void(*item_destroyer)(void *)) {
     *last_node = NULL;
 }
 
+/*Removes the nodes after new_last, which is a node of the list and
+  becomes its last one (all of them if new_last is NULL). Requires the
+  appropriate item_destroyer function.*/
+void cut_clist(c_list **last_node, c_list *new_last,
+               void(*item_destroyer)(void *)) {
+    c_list *cur_node;
+    c_list *next_node;
+    
+    if (new_last == NULL) {
+        destroy_clist(last_node, item_destroyer);
+        return;
+    }
+    
+    if (*last_node == new_last) {
+        return;
+    }
+    
+    /*the removed nodes, as a singly linked list*/
+    cur_node = new_last->next;
+    new_last->next = (*last_node)->next;
+    (*last_node)->next = NULL;
+    
+    while (cur_node != NULL) {
+        next_node = cur_node->next;
+        
+        (*item_destroyer)(cur_node->item);
+        mem_free(cur_node);
+        
+        cur_node = next_node;
+    }
+    
+    *last_node = new_last;
+}
+
 /*Finds a string in a given list. Requires the appropriate item_finder
   function.*/
 void *find_clist_str(c_list *last_node, void*(*item_finder)(void *, char*),
                      char *str) {
     c_list *cur_node;
     void *found_item;
-       
+    
     if (last_node == NULL) {
         return NULL;
     }
@@ -79,6 +121,149 @@ void *find_clist_str(c_list *last_node, void*(*item_finder)(void *, char*),
     return NULL;
 }
 
+/*Initializes an empty table, the buckets are allocated by the first
+  add_chash. get_key returns the string an item is looked up by.*/
+void init_chash(c_hash *table, char *(*get_key)(void *)) {
+    table->buckets = NULL;
+    table->size    = 0;
+    table->count   = 0;
+    table->get_key = get_key;
+}
+
+/*Adds an item to the table. Items with the same key are kept in the order
+  they were added, just like in a c_list.*/
+void add_chash(c_hash *table, void *item) {
+    if (table->count >= table->size * CHASH_MAX_LOAD) {
+        grow_chash(table);
+    }
+    
+    add_clist(&table->buckets[hash_str((*table->get_key)(item)) &
+                              (table->size-1)], item);
+    table->count++;
+}
+
+/*Returns the last node of the bucket str falls into (which may hold
+  other keys as well), NULL if it's empty.*/
+c_list *get_chash_bucket(c_hash *table, char *str) {
+    if (table->buckets == NULL) {
+        return NULL;
+    }
+    
+    return table->buckets[hash_str(str) & (table->size-1)];
+}
+
+/*Finds a string in the table, see find_clist_str.*/
+void *find_chash_str(c_hash *table, void*(*item_finder)(void *, char*),
+                     char *str) {
+    return find_clist_str(get_chash_bucket(table, str), item_finder, str);
+}
+
+/*Removes item from the table, if it's there. The item isn't freed.*/
+void remove_chash(c_hash *table, void *item) {
+    c_list **bucket;
+    c_list *prev_node;
+    c_list *cur_node;
+    
+    if (table->buckets == NULL) {
+        return;
+    }
+    
+    bucket = &table->buckets[hash_str((*table->get_key)(item)) &
+                             (table->size-1)];
+    if (*bucket == NULL) {
+        return;
+    }
+    
+    prev_node = *bucket;
+    cur_node  = prev_node->next;
+    while (cur_node->item != item) {
+        if (cur_node == *bucket) {
+            return; /*not in the table*/
+        }
+        
+        prev_node = cur_node;
+        cur_node  = cur_node->next;
+    }
+    
+    if (cur_node == prev_node) {
+        *bucket = NULL;
+    } else {
+        prev_node->next = cur_node->next;
+        if (cur_node == *bucket) {
+            *bucket = prev_node;
+        }
+    }
+    
+    mem_free(cur_node);
+    table->count--;
+}
+
+/*Frees the buckets, but not the items.*/
+void destroy_chash(c_hash *table) {
+    int i;
+    
+    for (i = 0; i < table->size; i++) {
+        destroy_clist(&table->buckets[i], &keep_item);
+    }
+    
+    mem_free(table->buckets);
+    init_chash(table, table->get_key);
+}
+
+/*djb2, the hash of the keys of a c_hash.*/
+unsigned int hash_str(char *str) {
+    unsigned int hash = 5381;
+    
+    while (*str != '\0') {
+        hash = hash*33 + (unsigned char)*str;
+        str++;
+    }
+    
+    return hash;
+}
+
+/*Doubles the amount of buckets and rehashes the items into them.*/
+static void grow_chash(c_hash *table) {
+    int i;
+    c_list **old_buckets = table->buckets;
+    int old_size = table->size;
+    c_list *cur_node;
+    
+    table->size = (old_size == 0) ? CHASH_INIT_SIZE : old_size*2;
+    table->buckets = mem_alloc(sizeof(c_list*)*table->size, mem_lists);
+    if (table->buckets == NULL) {
+        fprintf(stderr, "Malloc failure in grow_chash.");
+        exit(1);
+    }
+    
+    for (i = 0; i < table->size; i++) {
+        table->buckets[i] = NULL;
+    }
+    
+    /*the old buckets are walked from their heads to keep the order*/
+    for (i = 0; i < old_size; i++) {
+        if (old_buckets[i] == NULL) {
+            continue;
+        }
+        
+        cur_node = old_buckets[i]->next;
+        do {
+            add_clist(&table->buckets[hash_str((*table->get_key)(
+                          cur_node->item)) & (table->size-1)],
+                      cur_node->item);
+            cur_node = cur_node->next;
+        } while (cur_node != old_buckets[i]->next);
+        
+        destroy_clist(&old_buckets[i], &keep_item);
+    }
+    
+    mem_free(old_buckets);
+}
+
+/*The items of a c_hash belong to someone else.*/
+static void keep_item(void *item) {
+}
+
 /*DEBUG*/
 void print_clist(c_list *last_node, void(*item_printer)(void *)) {
     c_list *cur_node;
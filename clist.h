@@ -6,13 +6,34 @@ typedef struct c_list {
     struct c_list *next;
 } c_list;
 
+/*Hash table of c_lists, for lookups of strings that don't walk the whole
+  list. The items are only referenced, the list that owns them destroys
+  them.*/
+typedef struct c_hash {
+    c_list **buckets;             /*NULL until the first item is added*/
+    int size;                     /*amount of buckets, a power of two*/
+    int count;                    /*amount of items*/
+    char *(*get_key)(void *item); /*the string the item is found by*/
+} c_hash;
+
 
 void add_clist(c_list **last_node, void *item);
 void destroy_clist(c_list **last_node, void(*item_destroyer)(void *));
+void cut_clist(c_list **last_node, c_list *new_last,
+               void(*item_destroyer)(void *));
 
 void *find_clist_str(c_list *last_node, void*(*item_finder)(void *, char*),
                      char *str);
                      
+void init_chash(c_hash *table, char *(*get_key)(void *));
+void add_chash(c_hash *table, void *item);
+c_list *get_chash_bucket(c_hash *table, char *str);
+void remove_chash(c_hash *table, void *item);
+void *find_chash_str(c_hash *table, void*(*item_finder)(void *, char*),
+                     char *str);
+void destroy_chash(c_hash *table);
+unsigned int hash_str(char *str);
+
 void print_clist(c_list *last_node, void(*item_printer)(void *));
 void print_clist_range(c_list *last_node, int start, int length,
                        void(*item_printer)(void *));
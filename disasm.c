@@ -0,0 +1,638 @@
+/*Disassembler of the object files of the assembler (see objfile.c), back
+  into a source that assembles to the same code.
+  
+  Usage: disassembler [--from text|bin] [--map] name
+  
+  Options:
+    --from FORMAT   text reads name.ob (with name.ent and name.ext, if
+                    there are), bin reads name.obj (of either kind),
+                    text is the default
+    --map           names the labels as in name.map, the binary symbol
+                    map of the assembler's --map=bin (see mapfile.c)
+  
+  The source is written to stdout. Every first word of an instruction is
+  decoded by a single lookup in decode_table, which is built from OPS
+  (token.h) up front, so nothing is searched for per instruction. The
+  labels are the entries, named as in the .ent, and the targets of the
+  relocated operands, named L<address>, or with --map all the labels of
+  the source, named as in it. The data is written as .data, and a code
+  word that doesn't start an instruction as a comment. Exits with 1 if
+  the input can't be read.
+  
+  The lines are put together without printf, which would take most of
+  the time on images of millions of words.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "mapfile.h"
+
+#define MAX_WORD 1024   /*2^10, all the first words*/
+#define MODE_MASK 3     /*of an addressing mode*/
+#define REG_MASK 7      /*of a register number, r0 to r7*/
+#define IMM_BITS 8      /*of an immediate, a struct field or an address*/
+#define MAX_TARGET (1 << IMM_BITS) /*the addresses an operand can hold*/
+#define DATA_PER_LINE 8 /*words of a .data line, so that it fits MAX_LINE*/
+#define MAX_LABEL 40    /*printed of a name, more than any label needs*/
+#define MAX_OPERAND 48  /*as printed, a label and a field*/
+#define LABELS_INIT_SIZE 64
+#define OUT_BUFFER_SIZE 65536
+
+    /*what a first word decodes to*/
+    typedef struct decoded_instr {
+        int opcode;   /*index into OPS, -1 if it isn't an instruction*/
+        int opds;
+        add_mode src_mode;
+        add_mode dst_mode;
+        int src_word; /*offset of the word of the source, 0 if none*/
+        int dst_word; /*offset of the word of the destination, 0 if none*/
+        int length;   /*words, with the operands*/
+    } decoded_instr;
+    
+    /*a label of the source*/
+    typedef struct dis_label {
+        unsigned int address;
+        const char *name; /*of the entry, or NULL for L<address>*/
+        bool placed;      /*if it was written in front of a line*/
+    } dis_label;
+
+typedef struct disasm_t {
+    obj_image img;
+    symbol_map map;  /*of --map, or empty*/
+    word_image data; /*the data image, with the runs expanded*/
+    
+    dis_label *labels; /*by address, one per address*/
+    unsigned int label_count;
+    unsigned int label_capacity;
+    unsigned int next_label; /*the first one not yet written*/
+    
+    obj_symbol **externs; /*by address*/
+    unsigned int next_extern;
+    unsigned int unknown_externs; /*operands that aren't in the .ext*/
+} disasm_t;
+
+static void init_decode_table(void);
+static decoded_instr decode_word(unsigned int word);
+static int get_mode_length(add_mode mode);
+static bool is_label_operand(add_mode mode);
+
+static void collect_labels(disasm_t *dis);
+static void add_label(disasm_t *dis, unsigned int address, const char *name);
+static void collect_externs(disasm_t *dis);
+static int cmp_label(const void *a, const void *b);
+static int cmp_label_address(const void *a, const void *b);
+static int cmp_symbol_address(const void *a, const void *b);
+static int cmp_symbol_name(const void *a, const void *b);
+
+static void write_declarations(disasm_t *dis);
+static void write_code(disasm_t *dis);
+static void write_instr(disasm_t *dis, unsigned int i,
+                        decoded_instr *p_instr);
+static void write_data(disasm_t *dis);
+static void write_line_label(disasm_t *dis, unsigned int address);
+static char *sprint_operand(disasm_t *dis, char *buf, add_mode mode,
+                            unsigned int i, int reg_shift);
+static char *sprint_label(disasm_t *dis, char *buf, unsigned int address);
+static const char *get_extern_name(disasm_t *dis, unsigned int address);
+static int get_signed(unsigned int value, int bits);
+static char *sprint_int(long value, char *buf);
+
+static decoded_instr decode_table[MAX_WORD];
+
+int main(int argc, char **argv) {
+    int i;
+    char *from = "text";
+    char *name = NULL;
+    char buf[MAX_OPERAND];
+    bool map = false;
+    bool read_ok;
+    disasm_t dis;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--from") == 0 && i+1 < argc) {
+            from = argv[++i];
+        } else if (strncmp(argv[i], "--from=", 7) == 0) {
+            from = argv[i] + 7;
+        } else if (strcmp(argv[i], "--map") == 0) {
+            map = true;
+        } else if (argv[i][0] != '-' && name == NULL) {
+            name = argv[i];
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (name == NULL ||
+        (strcmp(from, "text") != 0 && strcmp(from, "bin") != 0)) {
+        fprintf(stderr, "Usage: disassembler [--from text|bin] [--map] "
+                        "name\n");
+        return 2;
+    }
+    
+    init_decode_table();
+    
+    read_ok = strcmp(from, "text") == 0 ? read_obj_text(&dis.img, name) :
+                                          read_obj_bin(&dis.img, name);
+    if (read_ok && map) {
+        read_ok = read_map_bin(&dis.map, name);
+    } else {
+        dis.map.symbols = NULL;
+        dis.map.count   = 0;
+        dis.map.names   = NULL;
+    }
+    if (!read_ok) {
+        destroy_symbol_map(&dis.map);
+        destroy_obj_image(&dis.img);
+        return 1;
+    }
+    
+    setvbuf(stdout, NULL, _IOFBF, OUT_BUFFER_SIZE);
+    
+    init_word_image(&dis.data);
+    append_data_words(&dis.data, &dis.img.data);
+    collect_labels(&dis);
+    collect_externs(&dis);
+    
+    write_declarations(&dis);
+    write_code(&dis);
+    write_data(&dis);
+    
+    /*the labels that point into an instruction, or out of the image*/
+    for (i = 0; i < (int)dis.label_count; i++) {
+        if (!dis.labels[i].placed) {
+            printf("; %s isn't at the start of a line\n",
+                   sprint_label(&dis, buf, dis.labels[i].address));
+        }
+    }
+    
+    if (dis.unknown_externs > 0) {
+        fprintf(stderr, "Warning, %u extern operands aren't in %s%s\n",
+                dis.unknown_externs, name, EXTENSION_EXT);
+    }
+    
+    mem_free(dis.labels);
+    mem_free(dis.externs);
+    destroy_symbol_map(&dis.map);
+    destroy_word_image(&dis.data);
+    destroy_obj_image(&dis.img);
+    
+    return 0;
+}
+
+/*Decodes every possible first word into decode_table.*/
+static void init_decode_table(void) {
+    unsigned int word;
+    
+    for (word = 0; word < MAX_WORD; word++) {
+        decode_table[word] = decode_word(word);
+    }
+}
+
+/*Returns what word decodes to as the first word of an instruction. It
+  isn't one (the opcode is -1) if the ARE bits are set, or an operand
+  has a mode the instruction doesn't allow, or the instruction doesn't
+  have the operand and its mode isn't zero.*/
+static decoded_instr decode_word(unsigned int word) {
+    decoded_instr instr;
+    int opc = word >> SHIFT_OPC;
+    
+    instr.opcode   = -1;
+    instr.opds     = 0;
+    instr.src_mode = (word >> SHIFT_SRC) & MODE_MASK;
+    instr.dst_mode = (word >> SHIFT_DST) & MODE_MASK;
+    instr.src_word = 0;
+    instr.dst_word = 0;
+    instr.length   = 1;
+    
+    if ((word & ARE_MASK) != 0 ||
+        opc >= (int)(sizeof(OPS)/sizeof(OPS[0]))) {
+        return instr;
+    }
+    
+    instr.opds = OPS[opc].opds;
+    if ((instr.opds < 2 && instr.src_mode != 0) ||
+        (instr.opds < 1 && instr.dst_mode != 0) ||
+        (instr.opds == 2 && !OPS[opc].src_mode[instr.src_mode]) ||
+        (instr.opds >= 1 && !OPS[opc].dst_mode[instr.dst_mode])) {
+        return instr;
+    }
+    
+    instr.opcode = opc;
+    if (instr.opds == 2 && instr.src_mode == addmode_reg &&
+        instr.dst_mode == addmode_reg) {
+        /*both registers share a word*/
+        instr.src_word = 1;
+        instr.dst_word = 1;
+        instr.length   = 2;
+    } else {
+        if (instr.opds == 2) {
+            instr.src_word = instr.length;
+            instr.length  += get_mode_length(instr.src_mode);
+        }
+        if (instr.opds >= 1) {
+            instr.dst_word = instr.length;
+            instr.length  += get_mode_length(instr.dst_mode);
+        }
+    }
+    
+    return instr;
+}
+
+/*Returns the words of an operand of mode.*/
+static int get_mode_length(add_mode mode) {
+    return mode == addmode_struct ? 2 : 1;
+}
+
+/*If the first word of an operand of mode is an address.*/
+static bool is_label_operand(add_mode mode) {
+    return mode == addmode_dir || mode == addmode_struct;
+}
+
+/*Collects the entries, the labels of the map and the targets of the
+  relocated operands into dis->labels, sorted by address. A named label
+  wins over a target at the same address.*/
+static void collect_labels(disasm_t *dis) {
+    unsigned int i, j;
+    unsigned int word;
+    unsigned int length; /*of the instruction at i*/
+    decoded_instr *p_instr;
+    const word_image *code = &dis->img.code;
+    bool targeted[MAX_TARGET]; /*so that every target is added once*/
+    
+    memset(targeted, 0, sizeof(targeted));
+    dis->labels         = NULL;
+    dis->label_count    = 0;
+    dis->label_capacity = 0;
+    dis->next_label     = 0;
+    
+    for (i = 0; i < dis->img.entry_count; i++) {
+        add_label(dis, dis->img.entries[i].address,
+                  dis->img.entries[i].name);
+    }
+    for (i = 0; i < dis->map.count; i++) {
+        add_label(dis, dis->map.symbols[i].address,
+                  dis->map.symbols[i].name);
+    }
+    
+    for (i = 0; i < code->count; i += length) {
+        p_instr = &decode_table[get_word(code, i)];
+        length  = p_instr->length;
+        if (p_instr->opcode < 0 || i + length > code->count) {
+            length = 1; /*not an instruction, see write_code*/
+            continue;
+        }
+        
+        if (is_label_operand(p_instr->src_mode) && p_instr->src_word > 0) {
+            word = get_word(code, i + p_instr->src_word);
+            if ((word & ARE_MASK) == ARE_RELOC &&
+                !targeted[word >> SHIFT_8BIT]) {
+                targeted[word >> SHIFT_8BIT] = true;
+                add_label(dis, word >> SHIFT_8BIT, NULL);
+            }
+        }
+        if (is_label_operand(p_instr->dst_mode) && p_instr->dst_word > 0) {
+            word = get_word(code, i + p_instr->dst_word);
+            if ((word & ARE_MASK) == ARE_RELOC &&
+                !targeted[word >> SHIFT_8BIT]) {
+                targeted[word >> SHIFT_8BIT] = true;
+                add_label(dis, word >> SHIFT_8BIT, NULL);
+            }
+        }
+    }
+    
+    if (dis->label_count > 0) {
+        qsort(dis->labels, dis->label_count, sizeof(dis_label), &cmp_label);
+        for (i = 1, j = 0; i < dis->label_count; i++) {
+            if (dis->labels[i].address != dis->labels[j].address) {
+                dis->labels[++j] = dis->labels[i];
+            }
+        }
+        dis->label_count = j + 1;
+    }
+}
+
+static void add_label(disasm_t *dis, unsigned int address, const char *name) {
+    dis_label *new_labels;
+    
+    if (dis->label_count == dis->label_capacity) {
+        dis->label_capacity = dis->label_capacity == 0 ? LABELS_INIT_SIZE :
+                                                         dis->label_capacity*2;
+        new_labels = mem_alloc(sizeof(dis_label)*dis->label_capacity,
+                               mem_output);
+        if (new_labels == NULL) {
+            fprintf(stderr, "Malloc failure in add_label.");
+            exit(1);
+        }
+        
+        if (dis->labels != NULL) {
+            memcpy(new_labels, dis->labels,
+                   sizeof(dis_label)*dis->label_count);
+            mem_free(dis->labels);
+        }
+        dis->labels = new_labels;
+    }
+    
+    dis->labels[dis->label_count].address = address;
+    dis->labels[dis->label_count].name    = name;
+    dis->labels[dis->label_count].placed  = false;
+    dis->label_count++;
+}
+
+/*Points dis->externs at the externs of the image, sorted by address.*/
+static void collect_externs(disasm_t *dis) {
+    unsigned int i;
+    
+    dis->externs = mem_alloc(sizeof(obj_symbol*)*(dis->img.extern_count+1),
+                             mem_output);
+    if (dis->externs == NULL) {
+        fprintf(stderr, "Malloc failure in collect_externs.");
+        exit(1);
+    }
+    
+    for (i = 0; i < dis->img.extern_count; i++) {
+        dis->externs[i] = &dis->img.externs[i];
+    }
+    qsort(dis->externs, dis->img.extern_count, sizeof(obj_symbol*),
+          &cmp_symbol_address);
+    
+    dis->next_extern     = 0;
+    dis->unknown_externs = 0;
+}
+
+/*By address, the named labels first.*/
+static int cmp_label(const void *a, const void *b) {
+    int result = cmp_label_address(a, b);
+    
+    if (result != 0) {
+        return result;
+    }
+    
+    return (((dis_label*)a)->name == NULL) - (((dis_label*)b)->name == NULL);
+}
+
+static int cmp_label_address(const void *a, const void *b) {
+    unsigned int addr_a = ((dis_label*)a)->address;
+    unsigned int addr_b = ((dis_label*)b)->address;
+    
+    return addr_a < addr_b ? -1 : addr_a > addr_b;
+}
+
+/*On obj_symbol pointers.*/
+static int cmp_symbol_address(const void *a, const void *b) {
+    unsigned int addr_a = (*(obj_symbol**)a)->address;
+    unsigned int addr_b = (*(obj_symbol**)b)->address;
+    
+    return addr_a < addr_b ? -1 : addr_a > addr_b;
+}
+
+/*On obj_symbol pointers.*/
+static int cmp_symbol_name(const void *a, const void *b) {
+    return strcmp((*(obj_symbol**)a)->name, (*(obj_symbol**)b)->name);
+}
+
+/*Writes the .entry of every entry and the .extern of every extern, once
+  per name.*/
+static void write_declarations(disasm_t *dis) {
+    unsigned int i;
+    obj_symbol **by_name;
+    
+    for (i = 0; i < dis->img.entry_count; i++) {
+        printf(".entry %s\n", dis->img.entries[i].name);
+    }
+    
+    by_name = mem_alloc(sizeof(obj_symbol*)*(dis->img.extern_count+1),
+                        mem_output);
+    if (by_name == NULL) {
+        fprintf(stderr, "Malloc failure in write_declarations.");
+        exit(1);
+    }
+    
+    memcpy(by_name, dis->externs, sizeof(obj_symbol*)*dis->img.extern_count);
+    qsort(by_name, dis->img.extern_count, sizeof(obj_symbol*),
+          &cmp_symbol_name);
+    for (i = 0; i < dis->img.extern_count; i++) {
+        if (i == 0 || strcmp(by_name[i]->name, by_name[i-1]->name) != 0) {
+            printf(".extern %s\n", by_name[i]->name);
+        }
+    }
+    mem_free(by_name);
+    
+    if (dis->img.entry_count > 0 || dis->img.extern_count > 0) {
+        putchar('\n');
+    }
+}
+
+/*Writes the instructions of the code image, a line each.*/
+static void write_code(disasm_t *dis) {
+    unsigned int i;
+    unsigned int word;
+    unsigned int length; /*of the instruction at i*/
+    decoded_instr *p_instr;
+    const word_image *code = &dis->img.code;
+    
+    for (i = 0; i < code->count; i += length) {
+        word    = get_word(code, i);
+        p_instr = &decode_table[word];
+        length  = p_instr->length;
+        write_line_label(dis, dis->img.base + i);
+        
+        /*the rest is still decoded, from the next word*/
+        if (p_instr->opcode < 0 || i + length > code->count) {
+            printf("; %u isn't an instruction\n", word);
+            length = 1;
+        } else {
+            write_instr(dis, i, p_instr);
+        }
+    }
+}
+
+/*Writes the instruction that starts at word i of the code.*/
+static void write_instr(disasm_t *dis, unsigned int i,
+                        decoded_instr *p_instr) {
+    char src[MAX_OPERAND];
+    char dst[MAX_OPERAND];
+    
+    fputs(OPS[p_instr->opcode].opname, stdout);
+    if (p_instr->opds == 2) {
+        putchar(' ');
+        fputs(sprint_operand(dis, src, p_instr->src_mode,
+                             i + p_instr->src_word, SHIFT_REG1), stdout);
+        putchar(',');
+    }
+    if (p_instr->opds >= 1) {
+        putchar(' ');
+        fputs(sprint_operand(dis, dst, p_instr->dst_mode,
+                             i + p_instr->dst_word, SHIFT_REG2), stdout);
+    }
+    putchar('\n');
+}
+
+/*Writes the data image as .data lines, a new one at every label.*/
+static void write_data(disasm_t *dis) {
+    unsigned int i;
+    unsigned int address = dis->img.base + dis->img.code.count;
+    int in_line = 0; /*numbers on the current line*/
+    char buf[MAX_OPERAND];
+    
+    for (i = 0; i < dis->data.count; i++, address++) {
+        if (in_line == DATA_PER_LINE ||
+            (in_line > 0 && dis->next_label < dis->label_count &&
+             dis->labels[dis->next_label].address == address)) {
+            putchar('\n');
+            in_line = 0;
+        }
+        
+        if (in_line == 0) {
+            write_line_label(dis, address);
+            fputs(".data ", stdout);
+        } else {
+            fputs(", ", stdout);
+        }
+        fputs(sprint_int(get_signed(get_word(&dis->data, i), WORD_BITS),
+                         buf), stdout);
+        in_line++;
+    }
+    
+    if (in_line > 0) {
+        putchar('\n');
+    }
+}
+
+/*Writes the label at address (and a tab) in front of a line, or just the
+  tab if there's none. The labels are written in the order of the
+  addresses, so only the next one is looked at.*/
+static void write_line_label(disasm_t *dis, unsigned int address) {
+    char buf[MAX_OPERAND];
+    
+    while (dis->next_label < dis->label_count &&
+           dis->labels[dis->next_label].address < address) {
+        dis->next_label++; /*inside an instruction, or before the image*/
+    }
+    
+    if (dis->next_label < dis->label_count &&
+        dis->labels[dis->next_label].address == address) {
+        fputs(sprint_label(dis, buf, address), stdout);
+        fputs(":\t", stdout);
+        dis->labels[dis->next_label++].placed = true;
+    } else {
+        putchar('\t');
+    }
+}
+
+/*Prints into buf the operand of mode, whose (first) word is word i of
+  the code. Returns buf.*/
+static char *sprint_operand(disasm_t *dis, char *buf, add_mode mode,
+                            unsigned int i, int reg_shift) {
+    unsigned int word = get_word(&dis->img.code, i);
+    unsigned int address = dis->img.base + i;
+    char *p_end;
+    
+    switch (mode) {
+        case addmode_imm:
+            buf[0] = '#';
+            sprint_int(get_signed(word >> SHIFT_8BIT, IMM_BITS), buf+1);
+            break;
+        case addmode_reg:
+            buf[0] = 'r';
+            buf[1] = '0' + ((word >> reg_shift) & REG_MASK);
+            buf[2] = '\0';
+            break;
+        case addmode_dir:
+        case addmode_struct:
+            if ((word & ARE_MASK) == ARE_EXTERN) {
+                buf[0] = '\0';
+                strncat(buf, get_extern_name(dis, address), MAX_LABEL);
+            } else {
+                sprint_label(dis, buf, word >> SHIFT_8BIT);
+            }
+            
+            if (mode == addmode_struct) {
+                p_end = buf + strlen(buf);
+                *p_end++ = '.';
+                sprint_int(get_signed(get_word(&dis->img.code, i+1) >>
+                                      SHIFT_8BIT, IMM_BITS), p_end);
+            }
+            break;
+    }
+    
+    return buf;
+}
+
+/*Prints into buf the name of the label at address. Returns buf.*/
+static char *sprint_label(disasm_t *dis, char *buf, unsigned int address) {
+    dis_label key;
+    dis_label *p_label;
+    
+    key.address = address;
+    p_label = bsearch(&key, dis->labels, dis->label_count, sizeof(dis_label),
+                      &cmp_label_address);
+    
+    if (p_label != NULL && p_label->name != NULL) {
+        buf[0] = '\0';
+        strncat(buf, p_label->name, MAX_LABEL);
+    } else {
+        buf[0] = 'L';
+        sprint_int(address, buf+1);
+    }
+    
+    return buf;
+}
+
+/*Returns the name of the extern used by the operand word at address, or
+  "?" if it's not in the .ext. The operands are looked up in the order
+  of the addresses, so only the next extern is looked at.*/
+static const char *get_extern_name(disasm_t *dis, unsigned int address) {
+    while (dis->next_extern < dis->img.extern_count &&
+           dis->externs[dis->next_extern]->address < address) {
+        dis->next_extern++;
+    }
+    
+    if (dis->next_extern < dis->img.extern_count &&
+        dis->externs[dis->next_extern]->address == address) {
+        return dis->externs[dis->next_extern]->name;
+    }
+    
+    dis->unknown_externs++;
+    return "?";
+}
+
+/*Returns the value of the low bits of value, as two's complement.*/
+static int get_signed(unsigned int value, int bits) {
+    value &= (1u << bits) - 1;
+    
+    return value >= (1u << (bits-1)) ? (int)value - (1 << bits) : (int)value;
+}
+
+/*Prints value in decimal into buf. Returns buf.*/
+static char *sprint_int(long value, char *buf) {
+    char digits[24]; /*more than a long has, backwards*/
+    int count = 0;
+    char *p_buf = buf;
+    unsigned long magnitude = value < 0 ? -(unsigned long)value : value;
+    
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    
+    if (value < 0) {
+        *p_buf++ = '-';
+    }
+    while (count > 0) {
+        *p_buf++ = digits[--count];
+    }
+    *p_buf = '\0';
+    
+    return buf;
+}
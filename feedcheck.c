@@ -0,0 +1,76 @@
+/*Assembles a source file by feeding it in small pieces (see assm_feed),
+  so that its output can be compared with the assembler's.
+  
+  Usage: feedcheck name out_name [chunk]
+  
+  Reads name.as chunk bytes at a time (7 if it's not given), and writes
+  the files of out_name (out_name.ob, .ent and .ext), the same ones that
+  the assembler writes for name. Exits with 1 if the file can't be read
+  or doesn't assemble. See the check-feed target of the Makefile.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
+#include "assm_driver.h"
+
+#define DEFAULT_CHUNK 7
+
+int main(int argc, char **argv) {
+    int chunk = DEFAULT_CHUNK;
+    int n;
+    char *filename;
+    char *bytes;
+    FILE *fp;
+    assm_ctx *ctx;
+    bool ok;
+    
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: feedcheck name out_name [chunk]\n");
+        return 2;
+    } else if (argc == 4 && (chunk = atoi(argv[3])) <= 0) {
+        fprintf(stderr, "Error, invalid chunk size: %s\n", argv[3]);
+        return 2;
+    }
+    
+    filename = mem_alloc(sizeof(char)*(strlen(argv[1])+4), mem_other);
+    bytes = mem_alloc(sizeof(char)*chunk, mem_other);
+    if (filename == NULL || bytes == NULL) {
+        fprintf(stderr, "Malloc failure in main.");
+        exit(1);
+    }
+    
+    sprintf(filename, "%s.as", argv[1]);
+    if ((fp = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "Error, can't open %s.\n", filename);
+        mem_free(filename);
+        mem_free(bytes);
+        return 1;
+    }
+    
+    ctx = create_assm_ctx();
+    while ((n = fread(bytes, sizeof(char), chunk, fp)) > 0) {
+        assm_feed(ctx, bytes, n);
+    }
+    fclose(fp);
+    
+    ok = assm_finish(ctx);
+    if (ok) {
+        output_machine_code(&ctx->assm, &ctx->filedat, argv[2]);
+    }
+    
+    destroy_assm_ctx(ctx);
+    mem_free(filename);
+    mem_free(bytes);
+    
+    return ok ? 0 : 1;
+}
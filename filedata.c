@@ -3,20 +3,30 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "token.h"
 #include "clist.h"
+#include "statement.h"
 #include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "probes.h"
 
 extern unsigned int ERRORS;
 
+static void print_tok_message(token *tok, file_data *filedat,
+                              char *message);
+static void add_diag_note(file_data *filedat, char *note);
+
 /*Note that we create a copy of the passed token tok.*/
 item_label *create_item_label(token *tok, int address, int linenum,
                               stat_type stype) {
     item_label *new_label;
     
-    new_label = malloc(sizeof(item_label));
+    new_label = mem_alloc(sizeof(item_label), mem_symbols);
     if (new_label == NULL) {
         fprintf(stderr, "Malloc failure in create_item_label.");
         exit(1);
@@ -30,6 +40,13 @@ item_label *create_item_label(token *tok, int address, int linenum,
     return new_label;
 }
 
+/*Adds the label to the list and the table of filedat.*/
+void add_item_label(file_data *filedat, item_label *p_label) {
+    add_clist(&filedat->last_label, p_label);
+    add_chash(&filedat->label_table, p_label);
+    PROBE_SYMBOL_DEFINE(p_label->tok->tokstr, p_label->linenum);
+}
+
 /*Finder for use with clist.*/
 void *find_item_label(void *item, char *str) {
     if (item == NULL) {
@@ -43,6 +60,11 @@ void *find_item_label(void *item, char *str) {
     return NULL;
 }
 
+/*Key getter for use with c_hash.*/
+char *get_item_label_key(void *item) {
+    return ((item_label*)item)->tok->tokstr;
+}
+
 /*Destroyer for use with clist.*/
 void destroy_item_label(void *item) {
     if (item == NULL) {
@@ -50,14 +72,14 @@ void destroy_item_label(void *item) {
     }
     
     destroy_token(((item_label*)item)->tok);
-    free(item);
+    mem_free(item);
 }
 
 /*Note that we create a copy of the passed token tok.*/
 item_entry *create_item_entry(token *tok, int linenum) {
     item_entry *new_entry;
     
-    new_entry = malloc(sizeof(item_entry));
+    new_entry = mem_alloc(sizeof(item_entry), mem_symbols);
     if (new_entry == NULL) {
         fprintf(stderr, "Malloc failure in create_ent_ext.");
         exit(1);
@@ -69,6 +91,13 @@ item_entry *create_item_entry(token *tok, int linenum) {
     return new_entry;
 }
 
+/*Adds the entry to the list and the table of filedat.*/
+void add_item_entry(file_data *filedat, item_entry *p_entry) {
+    add_clist(&filedat->last_entry, p_entry);
+    add_chash(&filedat->entry_table, p_entry);
+    PROBE_SYMBOL_DEFINE(p_entry->tok->tokstr, p_entry->linenum);
+}
+
 /*Finder for use with clist.*/
 void *find_item_entry(void *item, char *str) {
     if (item == NULL) {
@@ -82,6 +111,11 @@ void *find_item_entry(void *item, char *str) {
     return NULL;
 }
 
+/*Key getter for use with c_hash.*/
+char *get_item_entry_key(void *item) {
+    return ((item_entry*)item)->tok->tokstr;
+}
+
 /*Destroyer for use with clist.*/
 void destroy_item_entry(void *item) {
     if (item == NULL) {
@@ -89,14 +123,14 @@ void destroy_item_entry(void *item) {
     }
     
     destroy_token(((item_entry*)item)->tok);
-    free(item);
+    mem_free(item);
 }
 
 /*Note that we create a copy of the passed token tok.*/
 item_extern *create_item_extern(token *tok, int linenum) {
     item_extern *new_item_extern;
     
-    new_item_extern = malloc(sizeof(item_extern));
+    new_item_extern = mem_alloc(sizeof(item_extern), mem_symbols);
     if (new_item_extern == NULL) {
         fprintf(stderr, "Malloc failure in create_item_extern.");
         exit(1);
@@ -109,6 +143,13 @@ item_extern *create_item_extern(token *tok, int linenum) {
     return new_item_extern;
 }
 
+/*Adds the extern to the list and the table of filedat.*/
+void add_item_extern(file_data *filedat, item_extern *p_extern) {
+    add_clist(&filedat->last_extern, p_extern);
+    add_chash(&filedat->extern_table, p_extern);
+    PROBE_SYMBOL_DEFINE(p_extern->tok->tokstr, p_extern->linenum);
+}
+
 /*Finder for use with clist.*/
 void *find_item_extern(void *item, char *str) {
     if (item == NULL) {
@@ -122,6 +163,11 @@ void *find_item_extern(void *item, char *str) {
     return NULL;
 }
 
+/*Key getter for use with c_hash.*/
+char *get_item_extern_key(void *item) {
+    return ((item_extern*)item)->tok->tokstr;
+}
+
 /*Destroyer for use with clist.*/
 void destroy_item_extern(void *item) {
     if (item == NULL) {
@@ -129,7 +175,40 @@ void destroy_item_extern(void *item) {
     }
     
     destroy_token(((item_extern*)item)->tok);
-    free(item);
+    mem_free(item);
+}
+
+/*Note that we create a copy of the passed message.*/
+void add_diag(file_data *filedat, int linenum, int starting_index,
+              int length, char *message) {
+    item_diag *new_diag;
+    char *new_message;
+    
+    new_diag = mem_alloc(sizeof(item_diag), mem_output);
+    new_message = mem_alloc(sizeof(char)*(strlen(message)+1), mem_output);
+    if (new_diag == NULL || new_message == NULL) {
+        fprintf(stderr, "Malloc failure in add_diag.");
+        exit(1);
+    }
+    
+    strcpy(new_message, message);
+    
+    new_diag->linenum        = linenum;
+    new_diag->starting_index = starting_index;
+    new_diag->length         = length;
+    new_diag->message        = new_message;
+    
+    add_clist(&filedat->last_diag, new_diag);
+}
+
+/*Destroyer for use with clist.*/
+void destroy_item_diag(void *item) {
+    if (item == NULL) {
+        return;
+    }
+    
+    mem_free(((item_diag*)item)->message);
+    mem_free(item);
 }
 
 /*Reads a line from p_file and writes at most length chars into *line.
@@ -173,6 +252,48 @@ line_ret get_line(FILE *p_file, int length, char *line) {
     return line_too_long;
 }
 
+/*Same as get_line, but reads from the string that *p_text points at
+  and advances *p_text past the line. Once the terminator is reached,
+  *p_text is set to NULL, which is our equivalent of feof.*/
+line_ret get_line_str(const char **p_text, int length, char *line) {
+    int i;
+    const char *text = *p_text;
+    
+    if (text == NULL) {
+        return line_EOF;
+    }
+    
+    /*the first length chars*/
+    for (i = 0; i < length-1; i++, text++) {
+        if (*text == '\n') {
+            *p_text = text+1;
+            return line_ok;
+        } else if (*text == '\0') {
+            *p_text = NULL;
+            return line_ok;
+        }
+        
+        line[i] = *text;
+    }
+    
+    /*so, what is the length+1 character?*/
+    if (*text == '\n') {
+        *p_text = text+1;
+        return line_ok;
+    } else if (*text == '\0') {
+        *p_text = NULL;
+        return line_ok;
+    }
+    
+    /*fast forward until end of line or end of text*/
+    while (*text != '\n' && *text != '\0') {
+        text++;
+    }
+    *p_text = (*text == '\0') ? NULL : text+1;
+    
+    return line_too_long;
+}
+
 /*Does literally what it says. Skips the initial whitespace and if the
   first char after that whitespace is ; or \0 or \n - returns true.
   Otherwise false is returned.*/
@@ -188,14 +309,56 @@ bool is_comment_or_empty_line(char *input) {
     return false;
 }
 
+/*Every error goes through here - marks the file as erroneous and
+  counts the error towards the file's error budget.*/
+void set_error(file_data *filedat) {
+    ERRORS++;
+    filedat->errors++;
+    filedat->error = true;
+    PROBE_ERROR(filedat->linenum, filedat->errors);
+}
+
+/*True if the file has as many errors as it's allowed to (see max_errors
+  in file_data), in which case its processing should stop.*/
+bool is_error_budget_spent(file_data *filedat) {
+    if (filedat->max_errors > 0 && filedat->errors >= filedat->max_errors) {
+        return true;
+    }
+    
+    return false;
+}
+
 /*Prints an error that is relevant to the passed token tok.*/
 void print_tok_error(token *tok, file_data *filedat, char *message) {
+    set_error(filedat);
+    print_tok_message(tok, filedat, message);
+}
+
+/*Prints a warning that is relevant to the passed token tok. Warnings are
+  printed just like the errors, but they don't make the file erroneous
+  and they don't count towards the error budget.*/
+void print_tok_warning(token *tok, file_data *filedat, char *message) {
+    print_tok_message(tok, filedat, message);
+}
+
+/*Prints the message, with the line and tok marked in it (or collects or
+  queues it, see collect_diag and err_queue).*/
+static void print_tok_message(token *tok, file_data *filedat,
+                              char *message) {
     int i = 0;
     char *line = filedat->current_line;
     
-    ERRORS++;
-
-    filedat->error = true;
+    if (filedat->collect_diag) {
+        add_diag(filedat, filedat->linenum, tok->starting_index,
+                 tok->length, message);
+        return;
+    }
+    
+    if (filedat->err_queue != NULL) {
+        queue_error_assm(filedat->err_queue, tok, filedat->linenum, message,
+                         NULL);
+        return;
+    }
     
     while (*line == ' ' || *line == '\t') {
         line++; i++;
@@ -220,10 +383,62 @@ void print_tok_error(token *tok, file_data *filedat, char *message) {
     for (; i < (tok->length)+(tok->starting_index); i++) {
         fprintf(stderr, "~");
     }
-
+    
     fprintf(stderr, "\n");
 }
 
+/*Prints a note on the error that was just printed, like the expected
+  bounds of a number. If the errors are collected or queued (see
+  collect_diag and err_queue), the note goes with that error instead.*/
+void print_error_note(file_data *filedat, char *format, ...) {
+    char note[MAX_NOTE];
+    va_list args;
+    
+    va_start(args, format);
+    vsprintf(note, format, args);
+    va_end(args);
+    
+    if (filedat->collect_diag) {
+        add_diag_note(filedat, note);
+        return;
+    }
+    
+    if (filedat->err_queue != NULL) {
+        add_note_assm(filedat->err_queue, note);
+        return;
+    }
+    
+    fprintf(stderr, "%s", note);
+}
+
+/*Appends the note to the message of the last collected diagnostic, on a
+  line of its own.*/
+static void add_diag_note(file_data *filedat, char *note) {
+    item_diag *diag;
+    char *new_message;
+    int length = strlen(note);
+    
+    if (filedat->last_diag == NULL) {
+        return;
+    }
+    
+    diag = (item_diag*)filedat->last_diag->item;
+    if (length > 0 && note[length-1] == '\n') {
+        length--;
+    }
+    
+    new_message = mem_alloc(sizeof(char)*(strlen(diag->message)+length+2),
+                            mem_output);
+    if (new_message == NULL) {
+        fprintf(stderr, "Malloc failure in add_diag_note.");
+        exit(1);
+    }
+    
+    sprintf(new_message, "%s\n%.*s", diag->message, length, note);
+    mem_free(diag->message);
+    diag->message = new_message;
+}
+
 /*DEBUG*/
 void print_item_label(void *item) {
     item_label *p_label = (item_label*)item;
@@ -2,6 +2,7 @@
 #define FILEDATA_H
 
 #define MAX_LINE 81 /*plus one for the terminator*/
+#define MAX_NOTE 160 /*of a note on an error, see print_error_note*/
 
 /*return from get_line*/
 typedef enum {
@@ -35,10 +36,22 @@ typedef enum {
         bool was_used;
     } item_extern;
     
+    /*container for the diagnostics that are collected instead of
+      being printed (see collect_diag in file_data)*/
+    typedef struct item_diag {
+        int linenum;        /*line number*/
+        int starting_index; /*of the offending part of the line*/
+        int length;         /*of the offending part of the line*/
+        char *message;
+    } item_diag;
+    
 /*Contains relevant data on the current assembly file.*/
 typedef struct file_data {
     unsigned int IC, DC;
-    bool error;         /*any call to print_tok_error* will set this to true*/
+    bool error;         /*any call to print_tok_error* will set this to true,
+                          the warnings (print_tok_warning) don't*/
+    int errors;         /*the amount of errors found in the file*/
+    int max_errors;     /*stop processing the file at this many, 0 if never*/
     int linenum;        /*current line number in the file*/
     char *current_line; /*contents of the current line in file*/
     
@@ -57,31 +70,78 @@ typedef struct file_data {
     /*definitions of externs*/
     /*stores item_extern*/
     c_list *last_extern;
+    
+    /*the same definitions by name, for the lookups (see add_item_label
+      and friends, which add to both)*/
+    c_hash label_table;
+    c_hash entry_table;
+    c_hash extern_table;
+    
+    /*if true, the error printing functions store their diagnostics in
+      last_diag and print nothing (used by the language server)*/
+    bool collect_diag;
+    
+    /*stores item_diag*/
+    c_list *last_diag;
+    
+    /*if not NULL, the errors of the first pass are queued there instead
+      of being printed at once, so that the identical ones are merged
+      (see queue_error_assm in assm.c)*/
+    struct assm_t *err_queue;
+    
+    /*if true, only the lexer and parser checks are run (see
+      define_line_symbols in assm.c)*/
+    bool syntax_only;
+    
+    /*the OBJ_FORMAT_* of the output (see output_machine_code in assm.c
+      and objfile.h)*/
+    int obj_format;
+    
+    /*the MAP_FORMAT_* of the symbol map, written with the output (see
+      mapfile.h)*/
+    int map_format;
 } file_data;
 
 
 /*item_label*/
 item_label *create_item_label(token *tok, int address,
                               int linenum, stat_type stype);
+void add_item_label(file_data *filedat, item_label *p_label);
 void *find_item_label(void *item, char *str);
+char *get_item_label_key(void *item);
 void destroy_item_label(void *item);
 void print_item_label(void *item);
 
 /*item_entry*/
 item_entry *create_item_entry(token *tok, int linenum);
+void add_item_entry(file_data *filedat, item_entry *p_entry);
 void *find_item_entry(void *item, char *str);
+char *get_item_entry_key(void *item);
 void destroy_item_entry(void *item);
 void print_item_entry(void *item);
 
 /*item_extern*/
 item_extern *create_item_extern(token *tok, int linenum);
+void add_item_extern(file_data *filedat, item_extern *p_extern);
 void *find_item_extern(void *item, char *str);
+char *get_item_extern_key(void *item);
 void destroy_item_extern(void *item);
 void print_item_extern(void *item);
 
+/*item_diag*/
+void add_diag(file_data *filedat, int linenum, int starting_index,
+              int length, char *message);
+void destroy_item_diag(void *item);
+
+void set_error(file_data *filedat);
+bool is_error_budget_spent(file_data *filedat);
+
 line_ret get_line(FILE *p_file, int length, char *line);
+line_ret get_line_str(const char **p_text, int length, char *line);
 bool is_comment_or_empty_line(char *input);
 
 void print_tok_error(token *tok, file_data *filedat, char *message);
+void print_tok_warning(token *tok, file_data *filedat, char *message);
+void print_error_note(file_data *filedat, char *format, ...);
 
 #endif /*FILEDATA_H*/
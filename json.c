@@ -0,0 +1,343 @@
+/*Minimal JSON support. Reading works directly on the raw text - values
+  are located by pointer and decoded on demand, no tree is built. This is
+  all the language server (and the various reports) really need. The
+  strings and buffers are on the account of the language server, see
+  --alloc-stats.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "json.h"
+
+#define JSON_BUF_INIT 256 /*initial size of json_buf*/
+
+static const char *skip_string(const char *p);
+static void json_buf_reserve(json_buf *buf, int length);
+
+/*Skips whitespace.*/
+const char *json_skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    
+    return p;
+}
+
+/*Skips the string that p points at (p must point at the opening quote).
+  Returns the pointer past the closing quote, NULL if malformed.*/
+static const char *skip_string(const char *p) {
+    p++;
+    while (*p != '"') {
+        if (*p == '\0') {
+            return NULL;
+        } else if (*p == '\\') {
+            p++;
+            if (*p == '\0') {
+                return NULL;
+            }
+        }
+        p++;
+    }
+    
+    return p+1;
+}
+
+/*Skips a single value (and the whitespace in front of it). Returns the
+  pointer past the value, NULL if the value is malformed.*/
+const char *json_skip_value(const char *p) {
+    int depth = 0; /*nesting of objects and arrays*/
+    
+    if (p == NULL) {
+        return NULL;
+    }
+    
+    p = json_skip_ws(p);
+    do {
+        if (*p == '"') {
+            if ((p = skip_string(p)) == NULL) {
+                return NULL;
+            }
+            continue;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        } else if (*p == '\0') {
+            return NULL;
+        } else if (depth == 0) {
+            /*number or literal, runs until a delimiter*/
+            while (*p != ',' && *p != '}' && *p != ']' && *p != '\0' &&
+                   *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                p++;
+            }
+            return p;
+        }
+        p++;
+    } while (depth > 0);
+    
+    return p;
+}
+
+/*Returns the pointer to the value of the member key of the object obj,
+  NULL if obj is not an object or there is no such member.*/
+const char *json_get(const char *obj, const char *key) {
+    int key_length = strlen(key);
+    const char *p_key;
+    
+    if (obj == NULL) {
+        return NULL;
+    }
+    
+    obj = json_skip_ws(obj);
+    if (*obj != '{') {
+        return NULL;
+    }
+    
+    obj = json_skip_ws(obj+1);
+    while (*obj == '"') {
+        p_key = obj+1;
+        if ((obj = skip_string(obj)) == NULL) {
+            return NULL;
+        }
+        
+        obj = json_skip_ws(obj);
+        if (*obj != ':') {
+            return NULL;
+        }
+        obj = json_skip_ws(obj+1);
+        
+        /*keys with escapes never match, which is fine for our use*/
+        if (obj - p_key >= key_length+1 &&
+            strncmp(p_key, key, key_length) == 0 &&
+            p_key[key_length] == '"') {
+            return obj;
+        }
+        
+        if ((obj = json_skip_value(obj)) == NULL) {
+            return NULL;
+        }
+        obj = json_skip_ws(obj);
+        if (*obj == ',') {
+            obj = json_skip_ws(obj+1);
+        }
+    }
+    
+    return NULL;
+}
+
+/*Returns the pointer to the first element of the array arr, NULL if
+  arr is not an array or it's empty.*/
+const char *json_array_first(const char *arr) {
+    if (arr == NULL) {
+        return NULL;
+    }
+    
+    arr = json_skip_ws(arr);
+    if (*arr != '[') {
+        return NULL;
+    }
+    
+    arr = json_skip_ws(arr+1);
+    if (*arr == ']') {
+        return NULL;
+    }
+    
+    return arr;
+}
+
+/*Returns the pointer to the array element that follows elem, NULL if
+  elem is the last one.*/
+const char *json_array_next(const char *elem) {
+    if ((elem = json_skip_value(elem)) == NULL) {
+        return NULL;
+    }
+    
+    elem = json_skip_ws(elem);
+    if (*elem != ',') {
+        return NULL;
+    }
+    
+    return json_skip_ws(elem+1);
+}
+
+/*Reads the number at val into *num. Returns false if val is not
+  a number.*/
+bool json_get_int(const char *val, long *num) {
+    char *end;
+    
+    if (val == NULL) {
+        return false;
+    }
+    
+    *num = strtol(val, &end, 10);
+    if (end == val) {
+        return false;
+    }
+    
+    return true;
+}
+
+/*Decodes the string at val into a newly malloc'd string. Returns NULL if
+  val is not a string. Escaped code points above 0x7f are encoded as
+  UTF-8 (surrogate pairs aren't combined, we don't need them).*/
+char *json_get_string(const char *val) {
+    int i = 0;
+    unsigned long code;
+    const char *end;
+    char *new_str;
+    char hex[5] = {0};
+    
+    if (val == NULL || *val != '"' || (end = skip_string(val)) == NULL) {
+        return NULL;
+    }
+    
+    /*the decoded string is never longer than the encoded one*/
+    new_str = mem_alloc(sizeof(char)*(end-val), mem_lsp);
+    if (new_str == NULL) {
+        fprintf(stderr, "Malloc failure in json_get_string.");
+        exit(1);
+    }
+    
+    for (val++; val < end-1; val++) {
+        if (*val != '\\') {
+            new_str[i++] = *val;
+            continue;
+        }
+        
+        val++;
+        switch (*val) {
+            case 'n': new_str[i++] = '\n'; break;
+            case 't': new_str[i++] = '\t'; break;
+            case 'r': new_str[i++] = '\r'; break;
+            case 'b': new_str[i++] = '\b'; break;
+            case 'f': new_str[i++] = '\f'; break;
+            case 'u':
+                strncpy(hex, val+1, 4);
+                code = strtoul(hex, NULL, 16);
+                val += 4;
+                
+                if (code < 0x80) {
+                    new_str[i++] = (char)code;
+                } else if (code < 0x800) {
+                    new_str[i++] = (char)(0xc0 | (code >> 6));
+                    new_str[i++] = (char)(0x80 | (code & 0x3f));
+                } else {
+                    new_str[i++] = (char)(0xe0 | (code >> 12));
+                    new_str[i++] = (char)(0x80 | ((code >> 6) & 0x3f));
+                    new_str[i++] = (char)(0x80 | (code & 0x3f));
+                }
+                break;
+            default: /*quote, backslash and slash*/
+                new_str[i++] = *val;
+                break;
+        }
+    }
+    new_str[i] = '\0';
+    
+    return new_str;
+}
+
+/*Initializes buf to an empty string.*/
+void init_json_buf(json_buf *buf) {
+    buf->str = mem_alloc(sizeof(char)*JSON_BUF_INIT, mem_lsp);
+    if (buf->str == NULL) {
+        fprintf(stderr, "Malloc failure in init_json_buf.");
+        exit(1);
+    }
+    
+    buf->str[0] = '\0';
+    buf->length = 0;
+    buf->size   = JSON_BUF_INIT;
+}
+
+/*Frees the contents of buf.*/
+void destroy_json_buf(json_buf *buf) {
+    mem_free(buf->str);
+    buf->str    = NULL;
+    buf->length = 0;
+    buf->size   = 0;
+}
+
+/*Makes sure that length more chars (plus the terminator) fit in buf.*/
+static void json_buf_reserve(json_buf *buf, int length) {
+    char *new_str;
+    
+    if (buf->length + length + 1 <= buf->size) {
+        return;
+    }
+    
+    while (buf->length + length + 1 > buf->size) {
+        buf->size *= 2;
+    }
+    
+    new_str = mem_realloc(buf->str, buf->size, mem_lsp);
+    if (new_str == NULL) {
+        fprintf(stderr, "Realloc failure in json_buf_reserve.");
+        exit(1);
+    }
+    buf->str = new_str;
+}
+
+/*Appends str as is.*/
+void json_buf_add(json_buf *buf, const char *str) {
+    int length = strlen(str);
+    
+    json_buf_reserve(buf, length);
+    strcpy(&buf->str[buf->length], str);
+    buf->length += length;
+}
+
+/*Appends num in decimal.*/
+void json_buf_add_int(json_buf *buf, long num) {
+    char num_buf[24];
+    
+    sprintf(num_buf, "%ld", num);
+    json_buf_add(buf, num_buf);
+}
+
+/*Appends str as a quoted and escaped JSON string.*/
+void json_buf_add_string(json_buf *buf, const char *str) {
+    char esc_buf[8];
+    
+    json_buf_add(buf, "\"");
+    for (; *str != '\0'; str++) {
+        json_buf_reserve(buf, 6);
+        
+        if (*str == '"' || *str == '\\') {
+            buf->str[buf->length++] = '\\';
+            buf->str[buf->length++] = *str;
+        } else if (*str == '\n') {
+            buf->str[buf->length++] = '\\';
+            buf->str[buf->length++] = 'n';
+        } else if ((unsigned char)*str < 0x20) {
+            sprintf(esc_buf, "\\u%04x", (unsigned char)*str);
+            strcpy(&buf->str[buf->length], esc_buf);
+            buf->length += 6;
+        } else {
+            buf->str[buf->length++] = *str;
+        }
+    }
+    buf->str[buf->length] = '\0';
+    json_buf_add(buf, "\"");
+}
+
+/*Writes str into f_out as a quoted and escaped JSON string.*/
+void json_fput_string(const char *str, FILE *f_out) {
+    putc('"', f_out);
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            putc('\\', f_out);
+            putc(*str, f_out);
+        } else if (*str == '\n') {
+            fputs("\\n", f_out);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(f_out, "\\u%04x", (unsigned char)*str);
+        } else {
+            putc(*str, f_out);
+        }
+    }
+    putc('"', f_out);
+}
@@ -0,0 +1,29 @@
+#ifndef JSON_H
+#define JSON_H
+
+/*growable character buffer, used for building JSON text in memory*/
+typedef struct json_buf {
+    char *str;  /*always '\0' terminated*/
+    int length; /*not counting the terminator*/
+    int size;   /*allocated size*/
+} json_buf;
+
+
+/*reading*/
+const char *json_skip_ws(const char *p);
+const char *json_skip_value(const char *p);
+const char *json_get(const char *obj, const char *key);
+const char *json_array_first(const char *arr);
+const char *json_array_next(const char *elem);
+bool json_get_int(const char *val, long *num);
+char *json_get_string(const char *val);
+
+/*writing*/
+void init_json_buf(json_buf *buf);
+void destroy_json_buf(json_buf *buf);
+void json_buf_add(json_buf *buf, const char *str);
+void json_buf_add_int(json_buf *buf, long num);
+void json_buf_add_string(json_buf *buf, const char *str);
+void json_fput_string(const char *str, FILE *f_out);
+
+#endif /*JSON_H*/
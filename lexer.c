@@ -7,11 +7,14 @@
 #include "bool.h"
 #include "token.h"
 #include "clist.h"
+#include "statement.h"
 #include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "trace.h"
+#include "probes.h"
 #include "lexer.h"
 
-extern unsigned int ERRORS;
-
 static token *get_next_token(token *prev_token, file_data *filedat);
 static char *skip_wspace(char *str);
 static void print_errlex(int index, file_data *filedat, char *message);
@@ -30,6 +33,7 @@ void tokenize_line(file_data *filedat) {
         }
         
         add_clist(&filedat->last_token, tok);
+        PROBE_TOKEN(filedat->linenum, tok->toktype);
         
         if (tok->toktype == toktype_EOL) {
             break;
@@ -172,10 +176,10 @@ static token *get_next_token(token *prev_token, file_data *filedat) {
         next_token->toktype = get_toktype(next_token);
     }
     
-    #ifdef DEBUG_LEXER
-        printf("TOKEN: %s\t%s\n",
-               new_tokstr, toktype_strings[next_token->toktype]);
-    #endif /*DEBUG*/
+    if (TRACE_CAT(TRACE_LEX)) {
+        printf("TOKEN: %s\t%s\n", next_token->tokstr,
+               get_toktype_string(next_token->toktype));
+    }
     
     return next_token;
 }
@@ -194,10 +198,24 @@ static char *skip_wspace(char *str) {
 static void print_errlex(int index, file_data *filedat, char *message) {
     int i = 0;
     char *line = filedat->current_line;
+    token *tok;
     
-    filedat->error = true;
+    set_error(filedat);
     
-    ERRORS++;
+    if (filedat->collect_diag) {
+        add_diag(filedat, filedat->linenum, index, 1, message);
+        return;
+    }
+    
+    /*queued under the character it's at*/
+    if (filedat->err_queue != NULL) {
+        tok = create_token(index, 1, filedat->current_line);
+        tok->toktype = toktype_unknown;
+        queue_error_assm(filedat->err_queue, tok, filedat->linenum, message,
+                         "Lexer error.");
+        destroy_token(tok);
+        return;
+    }
     
     while (*line == ' ' || *line == '\t') {
         line++; i++;
@@ -226,7 +244,7 @@ static void print_errlex(int index, file_data *filedat, char *message) {
         fprintf(stderr, "~");
         i++;
     }
-
+    
     fprintf(stderr, "\n");
 }
 
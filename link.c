@@ -0,0 +1,590 @@
+/*The link of assembled modules into a single image.
+
+  Every module was assembled on its own, with its code at IC_INIT and its
+  data right after the code. The link lays the code of all the modules
+  out first, one after the other from IC_INIT, and the data of all of
+  them after that, so every module has a base for its code and one for
+  its data. Then:
+    every word of the code with ARE_RELOC holds an address of its own
+    module, which is moved to where that word of the module went
+    every word listed in a .ext refers to an entry of some module, found
+    in a hash table of all the entries, and becomes a relocated word with
+    its linked address
+  Both take a pass over the words and a lookup per extern, so the link
+  is linear in the words and the symbols. An entry of two modules, or an
+  extern that isn't an entry of any, is an error, and so is an address
+  that doesn't fit in the 8 bits of an operand. The linked image has the
+  entries of all the modules and no externs.
+  
+  The work is split between lnk->jobs threads, phase by phase (see
+  run_link_pool): the modules are loaded and their entries added to the
+  symbol table a module per job, and the code is patched PATCH_CHUNK
+  words per job, straight into the code of the linked image. The table
+  is split into LINK_SHARDS shards by the hash of the name, each with its
+  own lock, so the threads rarely wait for each other. Since the chunks
+  are a whole number of 5 byte groups of the packed code, no two threads
+  write the same byte. Whatever depends on the order (which of two equal
+  entries is kept, the entries of the linked image) is by the order of
+  the modules, so the result is the same with any number of threads.*/
+
+#define _POSIX_C_SOURCE 200112L /*for the threads*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+
+#define SHARD_SHIFT 26      /*the top bits of the hash pick the shard, the
+                              low ones are the buckets of its c_hash*/
+#define PATCH_CHUNK 16384   /*words, a multiple of 4 (a 5 byte group)*/
+
+    /*a phase of the link, done by the threads a job at a time*/
+    typedef struct link_pool {
+        link_t *lnk;
+        obj_image *out;
+        char **names; /*of the modules, to load them*/
+        bool bin;
+        void (*run_job)(struct link_pool *pool, unsigned int job,
+                        unsigned int *errors);
+        unsigned int job_count;
+        unsigned int next_job;
+        pthread_mutex_t lock; /*of next_job*/
+    } link_pool;
+    
+    typedef struct link_worker {
+        link_pool *pool;
+        pthread_t thread;
+        unsigned int errors; /*diagnosed by its jobs*/
+    } link_worker;
+
+static void run_link_pool(link_pool *pool);
+static void *run_link_worker(void *arg);
+static void load_module_job(link_pool *pool, unsigned int job,
+                            unsigned int *errors);
+static void prepare_module_job(link_pool *pool, unsigned int job,
+                               unsigned int *errors);
+static void patch_chunk_job(link_pool *pool, unsigned int job,
+                            unsigned int *errors);
+
+static void layout_link(link_t *lnk);
+static void clear_link_symbols(link_t *lnk);
+static void add_link_symbol(link_t *lnk, link_symbol *p_symbol);
+static void report_duplicates(link_t *lnk);
+static void patch_link_range(link_t *lnk, link_module *mod, obj_image *out,
+                             unsigned int start, unsigned int end,
+                             unsigned int *errors);
+static link_shard *get_link_shard(link_t *lnk, char *name);
+static link_symbol *find_link_name(link_t *lnk, char *name);
+static int cmp_obj_symbol_address(const void *a, const void *b);
+static char *get_link_symbol_key(void *item);
+static void *find_link_symbol(void *item, char *str);
+
+/*Prepares lnk for module_count modules, which are loaded by
+  load_link_module(s). With mem_cap, a link that doesn't fit in the
+  machine memory is an error, as is an operand that refers past it.
+  Without it (linkbench, which times links bigger than any machine) the
+  addresses are cut to the bits of the operand. jobs is the threads the
+  link is done by (at least 1, at most LINK_MAX_JOBS).*/
+void init_link(link_t *lnk, unsigned int module_count, bool mem_cap,
+               int jobs) {
+    unsigned int i;
+    
+    lnk->modules = mem_alloc(sizeof(link_module)*(module_count+1),
+                             mem_output);
+    if (lnk->modules == NULL) {
+        fprintf(stderr, "Malloc failure in init_link.");
+        exit(1);
+    }
+    
+    for (i = 0; i < module_count; i++) {
+        lnk->modules[i].name = NULL;
+        init_obj_image(&lnk->modules[i].img, IC_INIT, 0, 0);
+    }
+    
+    for (i = 0; i < LINK_SHARDS; i++) {
+        init_chash(&lnk->shards[i].table, &get_link_symbol_key);
+        pthread_mutex_init(&lnk->shards[i].lock, NULL);
+    }
+    
+    lnk->module_count    = module_count;
+    lnk->module_capacity = module_count + 1;
+    lnk->symbols         = NULL;
+    lnk->symbol_count    = 0;
+    lnk->code_count      = 0;
+    lnk->data_count      = 0;
+    lnk->error_count     = 0;
+    lnk->mem_cap         = mem_cap;
+    lnk->jobs            = jobs < 1 ? 1 :
+                           jobs > LINK_MAX_JOBS ? LINK_MAX_JOBS : jobs;
+}
+
+/*Adds a module named name after the others (for one of an archive, see
+  pull_archive_modules), and returns its index. Its image is empty, for
+  the caller to read it into.*/
+unsigned int add_link_module(link_t *lnk, char *name) {
+    link_module *modules;
+    
+    if (lnk->module_count == lnk->module_capacity) {
+        lnk->module_capacity *= 2;
+        modules = mem_alloc(sizeof(link_module)*lnk->module_capacity,
+                            mem_output);
+        if (modules == NULL) {
+            fprintf(stderr, "Malloc failure in add_link_module.");
+            exit(1);
+        }
+        
+        memcpy(modules, lnk->modules, sizeof(link_module)*lnk->module_count);
+        mem_free(lnk->modules);
+        lnk->modules = modules;
+    }
+    
+    lnk->modules[lnk->module_count].name = name;
+    init_obj_image(&lnk->modules[lnk->module_count].img, IC_INIT, 0, 0);
+    
+    return lnk->module_count++;
+}
+
+/*Reads module i from the object files of name, the binary object if bin
+  is set. Returns false (and prints why) if they can't be read.*/
+bool load_link_module(link_t *lnk, unsigned int i, char *name, bool bin) {
+    link_module *mod = &lnk->modules[i];
+    
+    destroy_obj_image(&mod->img);
+    mod->name = name;
+    
+    return bin ? read_obj_bin(&mod->img, name) :
+                 read_obj_text(&mod->img, name);
+}
+
+/*Reads all the modules, module i from names[i], on the threads of the
+  link. Returns false if any of them can't be read.*/
+bool load_link_modules(link_t *lnk, char **names, bool bin) {
+    unsigned int errors = lnk->error_count;
+    link_pool pool;
+    
+    init_weird_values(); /*before the threads read the text objects*/
+    
+    pool.names     = names;
+    pool.bin       = bin;
+    pool.run_job   = &load_module_job;
+    pool.job_count = lnk->module_count;
+    pool.lnk       = lnk;
+    pool.out       = NULL;
+    run_link_pool(&pool);
+    
+    return lnk->error_count == errors;
+}
+
+/*Links the loaded modules into out, which is initialized by the call.
+  Returns false if there were errors (printed as they're found), out is
+  left incomplete then. A link can be done again, after some of the
+  modules were loaded again.*/
+bool link_modules(link_t *lnk, obj_image *out) {
+    unsigned int i, j;
+    link_pool pool;
+    
+    clear_link_symbols(lnk);
+    layout_link(lnk);
+    if (lnk->mem_cap &&
+        IC_INIT + lnk->code_count + lnk->data_count > MAX_MACHINE_MEM) {
+        fprintf(stderr, "Error, machine memory exceeded, the link takes "
+                        "%u words.\n", lnk->code_count + lnk->data_count);
+        lnk->error_count++;
+    }
+    
+    pool.lnk       = lnk;
+    pool.out       = out;
+    pool.names     = NULL;
+    pool.bin       = false;
+    pool.run_job   = &prepare_module_job;
+    pool.job_count = lnk->module_count;
+    run_link_pool(&pool);
+    report_duplicates(lnk);
+    
+    /*the code, which out gets the room for first*/
+    init_obj_image(out, IC_INIT, lnk->symbol_count, 0);
+    set_word_count(&out->code, lnk->code_count);
+    pool.run_job   = &patch_chunk_job;
+    pool.job_count = (lnk->code_count + PATCH_CHUNK-1) / PATCH_CHUNK;
+    run_link_pool(&pool);
+    
+    for (i = 0; i < lnk->module_count; i++) {
+        append_data_image(&out->data, &lnk->modules[i].img.data);
+    }
+    
+    for (i = 0, j = 0; i < lnk->symbol_count; i++) {
+        if (!lnk->symbols[i].duplicate) {
+            set_obj_symbol(&out->entries[j++], lnk->symbols[i].address,
+                           lnk->symbols[i].name,
+                           strlen(lnk->symbols[i].name));
+        }
+    }
+    out->entry_count = j;
+    
+    return lnk->error_count == 0;
+}
+
+/*Frees the modules and the symbol table.*/
+void destroy_link(link_t *lnk) {
+    unsigned int i;
+    
+    for (i = 0; i < lnk->module_count; i++) {
+        destroy_obj_image(&lnk->modules[i].img);
+    }
+    
+    clear_link_symbols(lnk);
+    for (i = 0; i < LINK_SHARDS; i++) {
+        pthread_mutex_destroy(&lnk->shards[i].lock);
+    }
+    
+    mem_free(lnk->modules);
+    lnk->modules      = NULL;
+    lnk->module_count = 0;
+}
+
+/*Runs the jobs of pool on lnk->jobs threads (the calling one being one
+  of them), each taking the next job until there are none. The errors
+  of the jobs are added to the link's.*/
+static void run_link_pool(link_pool *pool) {
+    int i;
+    int started = 1; /*the workers that run, the calling thread's first*/
+    link_worker workers[LINK_MAX_JOBS];
+    
+    pool->next_job = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    
+    for (i = 0; i < pool->lnk->jobs; i++) {
+        workers[i].pool   = pool;
+        workers[i].errors = 0;
+    }
+    
+    /*a worker that can't be started leaves its jobs to the others*/
+    for (i = 1; i < pool->lnk->jobs; i++) {
+        if (pthread_create(&workers[started].thread, NULL,
+                           &run_link_worker, &workers[started]) == 0) {
+            started++;
+        }
+    }
+    
+    run_link_worker(&workers[0]);
+    for (i = 0; i < started; i++) {
+        if (i > 0) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        pool->lnk->error_count += workers[i].errors;
+    }
+    
+    pthread_mutex_destroy(&pool->lock);
+}
+
+static void *run_link_worker(void *arg) {
+    link_worker *worker = arg;
+    link_pool *pool = worker->pool;
+    unsigned int job;
+    
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        job = pool->next_job < pool->job_count ? pool->next_job++ :
+                                                 pool->job_count;
+        pthread_mutex_unlock(&pool->lock);
+        
+        if (job == pool->job_count) {
+            return NULL;
+        }
+        
+        (*pool->run_job)(pool, job, &worker->errors);
+    }
+}
+
+static void load_module_job(link_pool *pool, unsigned int job,
+                            unsigned int *errors) {
+    if (!load_link_module(pool->lnk, job, pool->names[job], pool->bin)) {
+        (*errors)++;
+    }
+}
+
+/*Adds the entries of module job to the symbol table, and sorts its
+  externs by address for patch_link_range. An extern that isn't at an
+  extern operand of the module is an error.*/
+static void prepare_module_job(link_pool *pool, unsigned int job,
+                               unsigned int *errors) {
+    unsigned int i;
+    link_module *mod = &pool->lnk->modules[job];
+    link_symbol *p_symbol;
+    obj_symbol *p_extern;
+    
+    for (i = 0; i < mod->img.entry_count; i++) {
+        p_symbol = &pool->lnk->symbols[mod->first_symbol + i];
+        p_symbol->name      = mod->img.entries[i].name;
+        p_symbol->address   = get_linked_address(mod,
+                                  mod->img.entries[i].address);
+        p_symbol->module    = mod;
+        p_symbol->duplicate = false;
+        add_link_symbol(pool->lnk, p_symbol);
+    }
+    
+    qsort(mod->img.externs, mod->img.extern_count, sizeof(obj_symbol),
+          &cmp_obj_symbol_address);
+    for (i = 0; i < mod->img.extern_count; i++) {
+        p_extern = &mod->img.externs[i];
+        if (p_extern->address < mod->img.base ||
+            p_extern->address - mod->img.base >= mod->img.code.count ||
+            (get_word(&mod->img.code, p_extern->address - mod->img.base) &
+             ARE_MASK) != ARE_EXTERN) {
+            fprintf(stderr, "Error, %s uses %s at %u, which isn't an "
+                            "extern operand\n", mod->name, p_extern->name,
+                    p_extern->address);
+            (*errors)++;
+        }
+    }
+}
+
+/*Patches the words of chunk job of the linked code, of whichever
+  modules they're from.*/
+static void patch_chunk_job(link_pool *pool, unsigned int job,
+                            unsigned int *errors) {
+    link_t *lnk = pool->lnk;
+    unsigned int start = job * PATCH_CHUNK;
+    unsigned int end = start + PATCH_CHUNK;
+    int low = 0;
+    int high = (int)lnk->module_count - 1;
+    int mid;
+    int first = lnk->module_count; /*the first module that ends after start*/
+    link_module *mod;
+    
+    if (end > lnk->code_count) {
+        end = lnk->code_count;
+    }
+    
+    while (low <= high) {
+        mid = (low + high) / 2;
+        mod = &lnk->modules[mid];
+        if (mod->code_base - IC_INIT + mod->img.code.count > start) {
+            first = mid;
+            high  = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    
+    for (mod = &lnk->modules[first];
+         mod < &lnk->modules[lnk->module_count] &&
+         mod->code_base - IC_INIT < end; mod++) {
+        patch_link_range(lnk, mod, pool->out, start, end, errors);
+    }
+}
+
+/*Sets the bases of the modules, and the words of the link. The entries
+  of every module get their place in lnk->symbols as well.*/
+static void layout_link(link_t *lnk) {
+    unsigned int i;
+    unsigned int address = IC_INIT;
+    
+    lnk->code_count   = 0;
+    lnk->data_count   = 0;
+    lnk->symbol_count = 0;
+    for (i = 0; i < lnk->module_count; i++) {
+        lnk->modules[i].code_base    = address;
+        lnk->modules[i].first_symbol = lnk->symbol_count;
+        address           += lnk->modules[i].img.code.count;
+        lnk->code_count   += lnk->modules[i].img.code.count;
+        lnk->symbol_count += lnk->modules[i].img.entry_count;
+    }
+    
+    for (i = 0; i < lnk->module_count; i++) {
+        lnk->modules[i].data_base = address;
+        address         += lnk->modules[i].img.data.count;
+        lnk->data_count += lnk->modules[i].img.data.count;
+    }
+    
+    lnk->symbols = mem_alloc(sizeof(link_symbol)*(lnk->symbol_count+1),
+                             mem_output);
+    if (lnk->symbols == NULL) {
+        fprintf(stderr, "Malloc failure in layout_link.");
+        exit(1);
+    }
+}
+
+/*Empties the symbol table, of a previous link.*/
+static void clear_link_symbols(link_t *lnk) {
+    int i;
+    
+    for (i = 0; i < LINK_SHARDS; i++) {
+        destroy_chash(&lnk->shards[i].table);
+    }
+    
+    mem_free(lnk->symbols);
+    lnk->symbols      = NULL;
+    lnk->symbol_count = 0;
+}
+
+/*Adds p_symbol to its shard of the table. If there's an entry of the
+  same name, the one of the earlier module stays in the table, and the
+  other one is marked as a duplicate (reported by report_duplicates).*/
+static void add_link_symbol(link_t *lnk, link_symbol *p_symbol) {
+    link_shard *shard = get_link_shard(lnk, p_symbol->name);
+    link_symbol *p_found;
+    c_list *cur_node;
+    
+    pthread_mutex_lock(&shard->lock);
+    
+    p_found = find_chash_str(&shard->table, &find_link_symbol,
+                             p_symbol->name);
+    if (p_found == NULL) {
+        add_chash(&shard->table, p_symbol);
+    } else if (p_found->module <= p_symbol->module) {
+        p_symbol->duplicate = true;
+    } else {
+        /*the one in the table is swapped for p_symbol*/
+        p_found->duplicate = true;
+        cur_node = get_chash_bucket(&shard->table, p_symbol->name);
+        while (cur_node->item != p_found) {
+            cur_node = cur_node->next;
+        }
+        cur_node->item = p_symbol;
+    }
+    
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/*Prints the entries that are duplicates, in the order of the modules.*/
+static void report_duplicates(link_t *lnk) {
+    unsigned int i;
+    link_symbol *p_symbol;
+    
+    for (i = 0; i < lnk->symbol_count; i++) {
+        p_symbol = &lnk->symbols[i];
+        if (p_symbol->duplicate) {
+            fprintf(stderr, "Error, %s is an entry of both %s and %s\n",
+                    p_symbol->name,
+                    find_link_name(lnk, p_symbol->name)->module->name,
+                    p_symbol->module->name);
+            lnk->error_count++;
+        }
+    }
+}
+
+/*Moves the words of mod from start to end (indexes of the linked code)
+  into out, with the relocated words moved along and the externs
+  resolved.*/
+static void patch_link_range(link_t *lnk, link_module *mod, obj_image *out,
+                             unsigned int start, unsigned int end,
+                             unsigned int *errors) {
+    unsigned int i;
+    unsigned int word;
+    unsigned int address;
+    unsigned int offset = mod->code_base - IC_INIT; /*of mod in out*/
+    unsigned int low = 0;
+    unsigned int high = mod->img.extern_count;
+    unsigned int mid;
+    obj_symbol *p_extern;
+    link_symbol *p_symbol;
+    word_image *code = &mod->img.code;
+    
+    /*the part of mod in the range, by the indexes of mod*/
+    start = start > offset ? start - offset : 0;
+    end   = end - offset < code->count ? end - offset : code->count;
+    
+    for (i = start; i < end; i++) {
+        word = get_word(code, i);
+        if ((word & ARE_MASK) == ARE_RELOC) {
+            address = get_linked_address(mod, word >> SHIFT_8BIT);
+            if (address >= MAX_MACHINE_MEM && lnk->mem_cap) {
+                fprintf(stderr, "Error, the operand at %u in %s refers to "
+                                "%u, past the machine memory\n",
+                        mod->img.base + i, mod->name, address);
+                (*errors)++;
+            }
+            word = (address << SHIFT_8BIT) + ARE_RELOC;
+        }
+        
+        set_word(&out->code, offset + i, word);
+    }
+    
+    /*the first extern in the range, they're by address*/
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (mod->img.externs[mid].address < mod->img.base + start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    for (i = low; i < mod->img.extern_count &&
+                  mod->img.externs[i].address < mod->img.base + end; i++) {
+        p_extern = &mod->img.externs[i];
+        if ((get_word(code, p_extern->address - mod->img.base) &
+             ARE_MASK) != ARE_EXTERN) {
+            continue; /*reported by prepare_module_job*/
+        }
+        
+        if ((p_symbol = find_link_name(lnk, p_extern->name)) == NULL) {
+            fprintf(stderr, "Error, undefined symbol %s in %s\n",
+                    p_extern->name, mod->name);
+            (*errors)++;
+            continue;
+        } else if (p_symbol->address >= MAX_MACHINE_MEM && lnk->mem_cap) {
+            fprintf(stderr, "Error, %s in %s is at %u, past the machine "
+                            "memory\n", p_extern->name, mod->name,
+                    p_symbol->address);
+            (*errors)++;
+        }
+        
+        set_word(&out->code, offset + p_extern->address - mod->img.base,
+                 (p_symbol->address << SHIFT_8BIT) + ARE_RELOC);
+    }
+}
+
+/*Returns where the word at address of mod (as it was assembled) is in
+  the link. The end of mod counts as in it, the addresses after it are
+  left as they are.*/
+unsigned int get_linked_address(link_module *mod, unsigned int address) {
+    unsigned int offset = address - mod->img.base;
+    
+    if (address < mod->img.base ||
+        offset > mod->img.code.count + mod->img.data.count) {
+        return address;
+    } else if (offset < mod->img.code.count) {
+        return mod->code_base + offset;
+    }
+    
+    return mod->data_base + offset - mod->img.code.count;
+}
+
+static link_shard *get_link_shard(link_t *lnk, char *name) {
+    return &lnk->shards[(hash_str(name) >> SHARD_SHIFT) & (LINK_SHARDS-1)];
+}
+
+/*Returns the symbol of the table named name, NULL if there's none. Only
+  once the table is complete, it's not locked.*/
+static link_symbol *find_link_name(link_t *lnk, char *name) {
+    return find_chash_str(&get_link_shard(lnk, name)->table,
+                          &find_link_symbol, name);
+}
+
+static int cmp_obj_symbol_address(const void *a, const void *b) {
+    unsigned int addr_a = ((obj_symbol*)a)->address;
+    unsigned int addr_b = ((obj_symbol*)b)->address;
+    
+    return addr_a < addr_b ? -1 : addr_a > addr_b;
+}
+
+static char *get_link_symbol_key(void *item) {
+    return ((link_symbol*)item)->name;
+}
+
+static void *find_link_symbol(void *item, char *str) {
+    return strcmp(((link_symbol*)item)->name, str) == 0 ? item : NULL;
+}
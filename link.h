@@ -0,0 +1,58 @@
+#ifndef LINK_H
+#define LINK_H
+
+#define LINK_SHARDS 64   /*of the symbol table, a power of two*/
+#define LINK_MAX_JOBS 64 /*threads of a link*/
+
+    /*an assembled module, and where the link puts it*/
+    typedef struct link_module {
+        char *name;             /*as given, without an extension*/
+        obj_image img;
+        unsigned int code_base; /*linked address of the first code word*/
+        unsigned int data_base; /*linked address of the first data word*/
+        unsigned int first_symbol; /*of its entries, in symbols*/
+    } link_module;
+    
+    /*an entry of a module, at its linked address*/
+    typedef struct link_symbol {
+        char *name;             /*the module's, not a copy*/
+        unsigned int address;
+        link_module *module;
+        bool duplicate;         /*of an entry of an earlier module*/
+    } link_symbol;
+    
+    /*a part of the symbol table, with its own lock*/
+    typedef struct link_shard {
+        c_hash table;           /*of the symbols, by name*/
+        pthread_mutex_t lock;
+    } link_shard;
+
+/*Modules linked into a single image: the code of all of them from
+  IC_INIT on, in the order they're given, then the data of all of them
+  in the same order. See link.c.*/
+typedef struct link_t {
+    link_module *modules;
+    unsigned int module_count;
+    unsigned int module_capacity;
+    
+    link_symbol *symbols;     /*the entries of all the modules, in order*/
+    unsigned int symbol_count;
+    link_shard shards[LINK_SHARDS]; /*by the hash of the name*/
+    
+    unsigned int code_count;  /*words, of all the modules*/
+    unsigned int data_count;
+    unsigned int error_count; /*diagnosed so far*/
+    bool mem_cap;             /*if the image has to fit in the machine*/
+    int jobs;                 /*threads that do the work*/
+} link_t;
+
+void init_link(link_t *lnk, unsigned int module_count, bool mem_cap,
+               int jobs);
+unsigned int add_link_module(link_t *lnk, char *name);
+bool load_link_module(link_t *lnk, unsigned int i, char *name, bool bin);
+bool load_link_modules(link_t *lnk, char **names, bool bin);
+bool link_modules(link_t *lnk, obj_image *out);
+unsigned int get_linked_address(link_module *mod, unsigned int address);
+void destroy_link(link_t *lnk);
+
+#endif /*LINK_H*/
@@ -0,0 +1,193 @@
+/*Speedup of the linker over its threads, run by make bench-link. A set
+  of modules is made up in memory (so that reading the files doesn't get
+  in the way) and linked with 1, 2, 4, 8 and 16 threads, up to --jobs.
+  The median wall time of the runs and the speedup over a single thread
+  are reported for each.
+  
+  Usage: linkbench [options]
+  
+  Options:
+    --modules N   modules of the link (default 2048)
+    --words N     code words of every module (default 4096)
+    --runs N      links with each number of threads, the median is taken
+                  (default 5)
+    --jobs N      the most threads (default 16)
+  
+  Every module has an entry per ENTRY_STEP words, a relocated word and an
+  extern operand in every group of 4 words, and a few data words, so
+  that all the phases of the link have their share of the work. The
+  externs are the entries of the next module.*/
+
+#define _POSIX_C_SOURCE 200112L /*for clock_gettime and the threads*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+
+#define ENTRY_STEP 64    /*code words per entry*/
+#define DATA_WORDS 16    /*of every module*/
+#define MAX_RUNS 101
+#define MAX_NAME 32
+
+static void make_module(link_module *mod, unsigned int i,
+                        unsigned int modules, unsigned int words);
+static double time_link(link_t *lnk, int jobs, int runs);
+static int cmp_double(const void *a, const void *b);
+static double get_wall_time(void);
+
+int main(int argc, char **argv) {
+    int i;
+    unsigned int modules = 2048;
+    unsigned int words = 4096;
+    int runs = 5;
+    int max_jobs = 16;
+    int jobs;
+    double single = 0;
+    double median;
+    link_t lnk;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--modules") == 0 && i+1 < argc) {
+            modules = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--words") == 0 && i+1 < argc) {
+            words = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--runs") == 0 && i+1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i+1 < argc) {
+            max_jobs = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (modules < 1 || words < ENTRY_STEP || runs < 1 || runs > MAX_RUNS ||
+        max_jobs < 1 || max_jobs > LINK_MAX_JOBS) {
+        fprintf(stderr, "Usage: linkbench [--modules N] [--words N] "
+                        "[--runs N] [--jobs N]\n");
+        return 2;
+    }
+    
+    init_link(&lnk, modules, false, 1);
+    for (i = 0; i < (int)modules; i++) {
+        make_module(&lnk.modules[i], i, modules, words);
+    }
+    
+    printf("%u modules, %lu code words, %lu entries, %lu externs\n\n",
+           modules, (unsigned long)modules * words,
+           (unsigned long)modules * (words / ENTRY_STEP),
+           (unsigned long)modules * (words / 4));
+    printf("%-8s %12s %10s\n", "threads", "ms", "speedup");
+    
+    for (jobs = 1; jobs <= max_jobs; jobs *= 2) {
+        median = time_link(&lnk, jobs, runs);
+        if (jobs == 1) {
+            single = median;
+        }
+        
+        printf("%-8d %12.2f %10.2f\n", jobs, median * 1000,
+               median > 0 ? single / median : 0);
+        fflush(stdout);
+    }
+    
+    destroy_link(&lnk);
+    
+    return 0;
+}
+
+/*Makes up module i of modules, with words code words.*/
+static void make_module(link_module *mod, unsigned int i,
+                        unsigned int modules, unsigned int words) {
+    unsigned int j;
+    unsigned int entries = words / ENTRY_STEP;
+    char name[MAX_NAME];
+    
+    destroy_obj_image(&mod->img);
+    init_obj_image(&mod->img, IC_INIT, entries, words / 4);
+    mod->name = "module";
+    
+    for (j = 0; j < entries; j++) {
+        sprintf(name, "e%u_%u", i, j);
+        set_obj_symbol(&mod->img.entries[j], IC_INIT + j*ENTRY_STEP, name,
+                       strlen(name));
+    }
+    
+    for (j = 0; j < words; j++) {
+        switch (j % 4) {
+            case 0: /*the instruction*/
+                append_word(&mod->img.code, OP_CMP << SHIFT_OPC |
+                                            addmode_dir << SHIFT_SRC |
+                                            addmode_imm << SHIFT_DST);
+                break;
+            case 1:
+                append_word(&mod->img.code,
+                            ((IC_INIT + j*7 % words) << SHIFT_8BIT) +
+                            ARE_RELOC);
+                break;
+            case 2:
+                sprintf(name, "e%u_%u", (i+1) % modules, j % entries);
+                set_obj_symbol(&mod->img.externs[j/4], IC_INIT + j, name,
+                               strlen(name));
+                append_word(&mod->img.code, ARE_EXTERN);
+                break;
+            default: /*an immediate*/
+                append_word(&mod->img.code, j << SHIFT_8BIT);
+                break;
+        }
+    }
+    
+    for (j = 0; j < DATA_WORDS; j++) {
+        append_data_run(&mod->img.data, j, 1);
+    }
+}
+
+/*Returns the median wall time of runs links on jobs threads.*/
+static double time_link(link_t *lnk, int jobs, int runs) {
+    int i;
+    double times[MAX_RUNS];
+    double start;
+    obj_image out;
+    
+    lnk->jobs = jobs;
+    for (i = 0; i < runs; i++) {
+        start = get_wall_time();
+        if (!link_modules(lnk, &out)) {
+            fprintf(stderr, "Error, the link failed.\n");
+            exit(1);
+        }
+        times[i] = get_wall_time() - start;
+        destroy_obj_image(&out);
+    }
+    
+    qsort(times, runs, sizeof(double), &cmp_double);
+    
+    return times[runs/2];
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double d_a = *(double*)a;
+    double d_b = *(double*)b;
+    
+    return d_a < d_b ? -1 : d_a > d_b;
+}
+
+/*Returns the monotonic time in seconds.*/
+static double get_wall_time(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
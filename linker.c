@@ -0,0 +1,198 @@
+/*Linker of the object files of the assembler into a single one (see
+  link.c for how).
+  
+  Usage: linker [options] -o out_name name...
+  
+  Options:
+    -o NAME         the linked object, written like the assembler writes
+                    one (default linked)
+    --from FORMAT   text reads name.ob (with name.ent and name.ext, if
+                    there are), bin reads name.obj (of either kind),
+                    text is the default
+    --format FORMAT text writes out_name.ob and out_name.ent, bin or runs
+                    out_name.obj, as in the assembler's --format
+    --jobs N        threads to load and link the modules with (default
+                    1), the result is the same with any number of them
+    --incremental   keep the link in out_name.lnk, and relink from it when
+                    the same modules are linked again: only the ones
+                    assembled again since are read and patched in, as
+                    long as they have as many words as they had (see
+                    relink.c)
+    --lib NAME      an archive (NAME.lib, see archiver.c) to take the
+                    modules from that have the entries the ones given
+                    don't, after them; can be given more than once, the
+                    first archive with an entry is the one it's taken
+                    from. Not with --incremental
+  
+  The linked image has to fit in the machine memory, as its addresses
+  have to fit in the operands. The names are given without an extension.
+  Exits with 1 if a module can't be read or the link has errors, nothing
+  is written then (nor the .lnk, the one of the last link is kept).*/
+
+#define _POSIX_C_SOURCE 200112L /*for the threads*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+#include "relink.h"
+#include "archive.h"
+
+static bool link_full(link_t *lnk, char **names, bool bin,
+                      archive_t *archives, int archive_count,
+                      obj_image *out);
+
+int main(int argc, char **argv) {
+    int i;
+    char *from = "text";
+    char *format = "text";
+    char *out_name = "linked";
+    bool incremental = false;
+    bool bin;
+    int jobs = 1;
+    int relink = RELINK_FULL;
+    bool link_ok;
+    unsigned int changed_count;
+    int first_name = 0; /*of the modules, which are the rest of argv*/
+    char **lib_names;
+    int archive_count = 0;
+    archive_t *archives;
+    link_t lnk;
+    link_cache cache;
+    obj_image out;
+    
+    lib_names = mem_alloc(sizeof(char*) * argc, mem_output);
+    archives  = mem_alloc(sizeof(archive_t) * argc, mem_output);
+    if (lib_names == NULL || archives == NULL) {
+        fprintf(stderr, "Malloc failure in main.");
+        exit(1);
+    }
+    
+    for (i = 1; i < argc && first_name == 0; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+            out_name = argv[++i];
+        } else if (strcmp(argv[i], "--from") == 0 && i+1 < argc) {
+            from = argv[++i];
+        } else if (strncmp(argv[i], "--from=", 7) == 0) {
+            from = argv[i] + 7;
+        } else if (strcmp(argv[i], "--format") == 0 && i+1 < argc) {
+            format = argv[++i];
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            format = argv[i] + 9;
+        } else if (strcmp(argv[i], "--jobs") == 0 && i+1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = true;
+        } else if (strcmp(argv[i], "--lib") == 0 && i+1 < argc) {
+            lib_names[archive_count++] = argv[++i];
+        } else if (argv[i][0] != '-') {
+            first_name = i;
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (first_name == 0 || jobs < 1 || jobs > LINK_MAX_JOBS ||
+        (incremental && archive_count > 0) ||
+        (strcmp(from, "text") != 0 && strcmp(from, "bin") != 0) ||
+        (strcmp(format, "text") != 0 && strcmp(format, "bin") != 0 &&
+         strcmp(format, "runs") != 0)) {
+        fprintf(stderr, "Usage: linker [--from text|bin] "
+                        "[--format text|bin|runs] [--jobs N] "
+                        "[--incremental | --lib NAME...] "
+                        "[-o out_name] name...\n");
+        return 2;
+    }
+    
+    bin = strcmp(from, "bin") == 0;
+    init_link(&lnk, argc - first_name, true, jobs);
+    init_link_cache(&cache);
+    
+    for (i = 0; i < archive_count; i++) {
+        if (!open_archive(&archives[i], lib_names[i])) {
+            relink = RELINK_FAILED; /*nor is anything linked*/
+        }
+    }
+    
+    if (incremental && read_link_cache(&cache, out_name) &&
+        cache.bin == bin && cache.mem_cap) {
+        relink = relink_modules(&cache, &argv[first_name], argc - first_name,
+                                &changed_count);
+    }
+    
+    if (relink == RELINK_DONE) {
+        get_link_cache_image(&cache, &out);
+        printf("Relinked %u of %d modules.\n", changed_count,
+               argc - first_name);
+        link_ok = true;
+    } else if (relink == RELINK_FULL) {
+        link_ok = link_full(&lnk, &argv[first_name], bin, archives,
+                            archive_count, &out);
+        if (link_ok && incremental) {
+            destroy_link_cache(&cache);
+            set_link_cache(&cache, &lnk, &out, bin);
+            printf("Linked %d modules.\n", argc - first_name);
+        }
+    } else {
+        link_ok = false; /*what can't be read is printed*/
+    }
+    
+    if (link_ok) {
+        if (strcmp(format, "text") == 0) {
+            write_obj_text(&out, out_name);
+        } else {
+            write_obj_bin(&out, out_name, strcmp(format, "runs") == 0);
+        }
+        if (incremental) {
+            write_link_cache(&cache, out_name);
+        }
+        destroy_obj_image(&out);
+    }
+    
+    if (lnk.error_count > 0) {
+        fprintf(stderr, "Errors found: %u\n", lnk.error_count);
+    }
+    destroy_link_cache(&cache);
+    destroy_link(&lnk);
+    for (i = 0; i < archive_count; i++) {
+        close_archive(&archives[i]);
+    }
+    mem_free(archives);
+    mem_free(lib_names);
+    
+    return link_ok ? 0 : 1;
+}
+
+/*Loads all the modules of names, and the members of the archives they
+  need, and links them into out. Returns false if any can't be read or
+  the link has errors, out is of no link then.*/
+static bool link_full(link_t *lnk, char **names, bool bin,
+                      archive_t *archives, int archive_count,
+                      obj_image *out) {
+    bool link_ok = load_link_modules(lnk, names, bin);
+    
+    if (link_ok && archive_count > 0) {
+        link_ok = pull_archive_modules(lnk, archives, archive_count);
+    }
+    
+    if (link_ok) {
+        link_ok = link_modules(lnk, out);
+        if (!link_ok) {
+            destroy_obj_image(out);
+        }
+    }
+    
+    return link_ok;
+}
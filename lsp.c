@@ -0,0 +1,946 @@
+/*Language server mode. Speaks the Language Server Protocol over stdio:
+  publishes diagnostics, resolves definitions of labels and externs, and
+  shows the assembled addresses and words of a line on hover.
+  
+  The documents are kept in memory and every change (full or ranged) is
+  applied to the stored text, which is then run through the very same
+  first pass and second pass as the files given on the command line -
+  there is no temporary file and no child process. The error printing
+  functions store their diagnostics in file_data instead of printing them
+  (see collect_diag), and the results of the last run are kept around
+  until the next change, so definition and hover requests are answered
+  without running anything at all.
+  
+  A change doesn't run the whole document again. The state of the first
+  pass before every line is kept (the counters, and the last node of each
+  list, which the first pass only appends to), so the results are rewound
+  to the first changed line, and the first pass goes on from there. The
+  second pass, which is over the undefined identifiers alone, is undone
+  and run again.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
+#include "assm_driver.h"
+#include "json.h"
+#include "lsp.h"
+
+#define WORD_SIZE 10           /*the word size of the machine*/
+#define MAX_HEADER_LINE 256    /*of a single header line in the message*/
+#define LSP_SOURCE "assembler" /*reported as the source of diagnostics*/
+
+/*diagnostic severities*/
+#define SEVERITY_ERROR   1
+#define SEVERITY_WARNING 2
+
+/*error codes*/
+#define ERR_METHOD_NOT_FOUND (-32601)
+
+/*what was assembled from a single line of the document*/
+typedef enum {
+    sect_none,
+    sect_code,
+    sect_data
+} line_sect;
+
+    /*the state of the first pass before a line, see rewind_doc*/
+    typedef struct line_state {
+        unsigned int IC, DC;
+        int errors;
+        bool error;
+        
+        /*the last nodes of the lists*/
+        c_list *last_label;
+        c_list *last_entry;
+        c_list *last_extern;
+        c_list *last_undefid;
+        c_list *last_out_ext;
+        c_list *last_diag;
+    } line_state;
+    
+    typedef struct line_info {
+        line_sect sect;
+        unsigned int address; /*of the first word, final for code only*/
+        int count;            /*amount of words*/
+        line_state before;
+    } line_info;
+
+/*An open document and the results of the last run over it.*/
+typedef struct lsp_doc {
+    char *uri;
+    char *text;
+    
+    assm_t assm;
+    file_data filedat;
+    
+    line_info *lines;   /*indexed by line number minus one*/
+    int num_lines;
+} lsp_doc;
+
+static char *read_message(void);
+static void send_message(json_buf *body);
+static void send_result(const char *id, json_buf *result);
+static void send_error(const char *id, int code, char *message);
+
+static void handle_did_open(const char *params);
+static void handle_did_change(const char *params);
+static void handle_did_close(const char *params);
+static void handle_definition(const char *id, const char *params);
+static void handle_hover(const char *id, const char *params);
+
+static lsp_doc *get_doc(const char *params);
+static void *find_lsp_doc(void *item, char *str);
+static void destroy_lsp_doc(void *item);
+static void run_doc(lsp_doc *doc, int first_line);
+static void rewind_doc(lsp_doc *doc, int linenum);
+static void cut_doc_list(c_list **last_node, c_list *new_last,
+                         c_hash *table, void(*item_destroyer)(void *));
+static void save_line_state(lsp_doc *doc, line_state *state);
+static void clear_doc_results(lsp_doc *doc);
+static void publish_diagnostics(lsp_doc *doc);
+static void apply_change(lsp_doc *doc, const char *change, long *first_line);
+
+static int pos_to_offset(const char *text, long line, long character);
+static char *get_word_at(lsp_doc *doc, long line, long character);
+static bool get_position(const char *params, long *line, long *character);
+static void add_range(json_buf *buf, int line, int start, int end);
+static void add_word_line(json_buf *buf, unsigned int address,
+                          unsigned int word);
+
+static c_list *last_doc = NULL; /*stores lsp_doc*/
+
+/*Driver for the language server. Returns when the client sends exit
+  (or closes stdin). Of the options only --alloc-stats applies, the
+  stats go to stderr since stdout is the client's.*/
+void run_lsp(run_opts *opts) {
+    int id_length;
+    char *message;
+    char *method;
+    char *id;
+    const char *p_id;
+    const char *params;
+    bool got_shutdown = false;
+    json_buf result;
+    
+    ALLOC_STATS = opts->alloc_stats;
+    
+    while ((message = read_message()) != NULL) {
+        method = json_get_string(json_get(message, "method"));
+        params = json_get(message, "params");
+        id     = NULL;
+        
+        /*the id is echoed back as is, it may be a number or a string*/
+        if ((p_id = json_get(message, "id")) != NULL) {
+            id_length = json_skip_value(p_id) - p_id;
+            id = mem_alloc(sizeof(char)*(id_length+1), mem_lsp);
+            if (id == NULL) {
+                fprintf(stderr, "Malloc failure in run_lsp.");
+                exit(1);
+            }
+            strncpy(id, p_id, id_length);
+            id[id_length] = '\0';
+        }
+        
+        if (method == NULL) {
+            ; /*a response to us, we never send requests though*/
+        } else if (strcmp(method, "initialize") == 0) {
+            init_json_buf(&result);
+            json_buf_add(&result, "{\"capabilities\":{"
+                                  "\"textDocumentSync\":{"
+                                  "\"openClose\":true,\"change\":2},"
+                                  "\"definitionProvider\":true,"
+                                  "\"hoverProvider\":true},"
+                                  "\"serverInfo\":{\"name\":");
+            json_buf_add_string(&result, LSP_SOURCE);
+            json_buf_add(&result, "}}");
+            send_result(id, &result);
+            destroy_json_buf(&result);
+        } else if (strcmp(method, "shutdown") == 0) {
+            got_shutdown = true;
+            init_json_buf(&result);
+            json_buf_add(&result, "null");
+            send_result(id, &result);
+            destroy_json_buf(&result);
+        } else if (strcmp(method, "exit") == 0) {
+            mem_free(method);
+            mem_free(id);
+            mem_free(message);
+            break;
+        } else if (strcmp(method, "textDocument/didOpen") == 0) {
+            handle_did_open(params);
+        } else if (strcmp(method, "textDocument/didChange") == 0) {
+            handle_did_change(params);
+        } else if (strcmp(method, "textDocument/didClose") == 0) {
+            handle_did_close(params);
+        } else if (strcmp(method, "textDocument/definition") == 0) {
+            handle_definition(id, params);
+        } else if (strcmp(method, "textDocument/hover") == 0) {
+            handle_hover(id, params);
+        } else if (id != NULL) {
+            send_error(id, ERR_METHOD_NOT_FOUND, "Method not found.");
+        }
+        /*unknown notifications are ignored*/
+        
+        mem_free(method);
+        mem_free(id);
+        mem_free(message);
+    }
+    
+    if (!got_shutdown) {
+        fprintf(stderr, "Exit without shutdown request.\n");
+    }
+    
+    destroy_clist(&last_doc, &destroy_lsp_doc);
+    
+    if (opts->alloc_stats) {
+        print_alloc_stats(stderr);
+    }
+}
+
+/*Reads the next message from stdin. Returns the malloc'd content, NULL
+  upon EOF or a malformed header.*/
+static char *read_message(void) {
+    long length = -1;
+    char header[MAX_HEADER_LINE];
+    char *content;
+    
+    /*headers end with an empty line*/
+    while (!0) {
+        if (fgets(header, MAX_HEADER_LINE, stdin) == NULL) {
+            return NULL;
+        }
+        
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+            break;
+        }
+        
+        if (strncmp(header, "Content-Length:", 15) == 0) {
+            length = atol(&header[15]);
+        }
+    }
+    
+    if (length < 0) {
+        fprintf(stderr, "Error, message without Content-Length.\n");
+        return NULL;
+    }
+    
+    content = mem_alloc(sizeof(char)*(length+1), mem_lsp);
+    if (content == NULL) {
+        fprintf(stderr, "Malloc failure in read_message.");
+        exit(1);
+    }
+    
+    if (fread(content, sizeof(char), length, stdin) != (size_t)length) {
+        mem_free(content);
+        return NULL;
+    }
+    content[length] = '\0';
+    
+    return content;
+}
+
+/*Writes body to stdout as a single message.*/
+static void send_message(json_buf *body) {
+    printf("Content-Length: %d\r\n\r\n", body->length);
+    fwrite(body->str, sizeof(char), body->length, stdout);
+    fflush(stdout);
+}
+
+/*Sends the response with the passed result (raw JSON) to request id.*/
+static void send_result(const char *id, json_buf *result) {
+    json_buf body;
+    
+    init_json_buf(&body);
+    json_buf_add(&body, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_buf_add(&body, id != NULL ? id : "null");
+    json_buf_add(&body, ",\"result\":");
+    json_buf_add(&body, result->str);
+    json_buf_add(&body, "}");
+    
+    send_message(&body);
+    destroy_json_buf(&body);
+}
+
+/*Sends the error response to request id.*/
+static void send_error(const char *id, int code, char *message) {
+    json_buf body;
+    
+    init_json_buf(&body);
+    json_buf_add(&body, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_buf_add(&body, id);
+    json_buf_add(&body, ",\"error\":{\"code\":");
+    json_buf_add_int(&body, code);
+    json_buf_add(&body, ",\"message\":");
+    json_buf_add_string(&body, message);
+    json_buf_add(&body, "}}");
+    
+    send_message(&body);
+    destroy_json_buf(&body);
+}
+
+/*textDocument/didOpen*/
+static void handle_did_open(const char *params) {
+    const char *text_doc = json_get(params, "textDocument");
+    lsp_doc *doc;
+    
+    doc = get_doc(params);
+    if (doc == NULL) {
+        doc = mem_alloc(sizeof(lsp_doc), mem_lsp);
+        if (doc == NULL) {
+            fprintf(stderr, "Malloc failure in handle_did_open.");
+            exit(1);
+        }
+        
+        doc->uri   = json_get_string(json_get(text_doc, "uri"));
+        doc->text  = NULL;
+        doc->lines = NULL;
+        doc->num_lines = 0;
+        init_run_assm(&doc->filedat, &doc->assm);
+        
+        if (doc->uri == NULL) {
+            mem_free(doc);
+            return;
+        }
+        
+        add_clist(&last_doc, doc);
+    }
+    
+    mem_free(doc->text);
+    doc->text = json_get_string(json_get(text_doc, "text"));
+    if (doc->text == NULL) {
+        doc->text = mem_alloc(sizeof(char), mem_lsp);
+        if (doc->text == NULL) {
+            fprintf(stderr, "Malloc failure in handle_did_open.");
+            exit(1);
+        }
+        doc->text[0] = '\0';
+    }
+    
+    run_doc(doc, 1);
+    publish_diagnostics(doc);
+}
+
+/*textDocument/didChange*/
+static void handle_did_change(const char *params) {
+    const char *change;
+    long first_line; /*zero based, the first one that changed*/
+    lsp_doc *doc = get_doc(params);
+    
+    if (doc == NULL) {
+        return;
+    }
+    
+    first_line = doc->num_lines;
+    change = json_array_first(json_get(params, "contentChanges"));
+    for (; change != NULL; change = json_array_next(change)) {
+        apply_change(doc, change, &first_line);
+    }
+    
+    run_doc(doc, first_line+1);
+    publish_diagnostics(doc);
+}
+
+/*textDocument/didClose*/
+static void handle_did_close(const char *params) {
+    c_list *cur_node;
+    c_list *prev_node;
+    lsp_doc *doc = get_doc(params);
+    
+    if (doc == NULL) {
+        return;
+    }
+    
+    /*clear the diagnostics on the client's side*/
+    clear_doc_results(doc);
+    publish_diagnostics(doc);
+    
+    /*unlink the document from the list*/
+    prev_node = last_doc;
+    cur_node  = last_doc->next;
+    while (cur_node->item != doc) {
+        prev_node = cur_node;
+        cur_node  = cur_node->next;
+    }
+    
+    if (cur_node == prev_node) {
+        last_doc = NULL;
+    } else {
+        prev_node->next = cur_node->next;
+        if (cur_node == last_doc) {
+            last_doc = prev_node;
+        }
+    }
+    
+    destroy_lsp_doc(doc);
+    mem_free(cur_node); /*allocated by add_clist*/
+}
+
+/*textDocument/definition - labels and externs.*/
+static void handle_definition(const char *id, const char *params) {
+    long line, character;
+    char *word = NULL;
+    token *def_tok = NULL;
+    int def_linenum = 0;
+    item_label *p_label;
+    item_extern *p_extern;
+    lsp_doc *doc = get_doc(params);
+    json_buf result;
+    
+    if (doc != NULL && get_position(params, &line, &character)) {
+        word = get_word_at(doc, line, character);
+    }
+    
+    if (word != NULL) {
+        if ((p_label = find_chash_str(&doc->filedat.label_table,
+                                      &find_item_label, word)) != NULL) {
+            def_tok     = p_label->tok;
+            def_linenum = p_label->linenum;
+        } else if ((p_extern = find_chash_str(&doc->filedat.extern_table,
+                                              &find_item_extern,
+                                              word)) != NULL) {
+            def_tok     = p_extern->tok;
+            def_linenum = p_extern->linenum;
+        }
+    }
+    
+    init_json_buf(&result);
+    if (def_tok != NULL) {
+        json_buf_add(&result, "{\"uri\":");
+        json_buf_add_string(&result, doc->uri);
+        json_buf_add(&result, ",");
+        add_range(&result, def_linenum-1, def_tok->starting_index,
+                  def_tok->starting_index + def_tok->length);
+        json_buf_add(&result, "}");
+    } else {
+        json_buf_add(&result, "null");
+    }
+    
+    send_result(id, &result);
+    destroy_json_buf(&result);
+    mem_free(word);
+}
+
+/*textDocument/hover - shows what the symbol under the cursor resolved
+  to, and the words that the line was assembled into.*/
+static void handle_hover(const char *id, const char *params) {
+    int i;
+    long line, character;
+    char *word = NULL;
+    char num_buf[32];
+    char b32_buf[3];
+    item_label *p_label = NULL;
+    item_extern *p_extern = NULL;
+    line_info *p_line = NULL;
+    unsigned int first; /*index of the first word of the line*/
+    unsigned int address;
+    lsp_doc *doc = get_doc(params);
+    json_buf value;
+    json_buf result;
+    
+    if (doc != NULL && get_position(params, &line, &character)) {
+        word = get_word_at(doc, line, character);
+        
+        if (line >= 0 && line < doc->num_lines &&
+            doc->lines[line].sect != sect_none) {
+            p_line = &doc->lines[line];
+        }
+    }
+    
+    init_json_buf(&value);
+    
+    /*the symbol*/
+    if (word != NULL) {
+        if ((p_label = find_chash_str(&doc->filedat.label_table,
+                                      &find_item_label, word)) != NULL) {
+            json_buf_add(&value, "`");
+            json_buf_add(&value, word);
+            json_buf_add(&value, p_label->stype == stype_instruction ?
+                                 "` code label, address " :
+                                 "` data label, address ");
+            sprintf(num_buf, "%u (`%s`)", p_label->IC,
+                    sprint_weird(p_label->IC, b32_buf));
+            json_buf_add(&value, num_buf);
+        } else if ((p_extern = find_chash_str(&doc->filedat.extern_table,
+                                              &find_item_extern,
+                                              word)) != NULL) {
+            json_buf_add(&value, "`");
+            json_buf_add(&value, word);
+            json_buf_add(&value, "` extern, resolved at link time");
+        }
+    }
+    
+    /*the words of the line*/
+    if (p_line != NULL) {
+        if (value.length > 0) {
+            json_buf_add(&value, "\n\n");
+        }
+        
+        json_buf_add(&value, "```\n");
+        if (p_line->sect == sect_code) {
+            address = p_line->address;
+            first   = address-IC_INIT;
+            for (i = 0; i < p_line->count; i++) {
+                add_word_line(&value, address+i,
+                              get_word(&doc->assm.code, first+i));
+            }
+        } else {
+            address = p_line->address + doc->filedat.IC;
+            first   = p_line->address-DC_INIT;
+            for (i = 0; i < p_line->count; i++) {
+                add_word_line(&value, address+i,
+                              get_data_word(&doc->assm.data, first+i));
+            }
+        }
+        json_buf_add(&value, "```");
+    }
+    
+    init_json_buf(&result);
+    if (value.length > 0) {
+        json_buf_add(&result, "{\"contents\":{\"kind\":\"markdown\","
+                              "\"value\":");
+        json_buf_add_string(&result, value.str);
+        json_buf_add(&result, "}}");
+    } else {
+        json_buf_add(&result, "null");
+    }
+    
+    send_result(id, &result);
+    destroy_json_buf(&result);
+    destroy_json_buf(&value);
+    mem_free(word);
+}
+
+/*Returns the document that params->textDocument->uri refers to, NULL if
+  it's not open.*/
+static lsp_doc *get_doc(const char *params) {
+    lsp_doc *doc;
+    char *uri = json_get_string(json_get(json_get(params, "textDocument"),
+                                         "uri"));
+    
+    if (uri == NULL) {
+        return NULL;
+    }
+    
+    doc = find_clist_str(last_doc, &find_lsp_doc, uri);
+    mem_free(uri);
+    
+    return doc;
+}
+
+/*Finder for use with clist.*/
+static void *find_lsp_doc(void *item, char *str) {
+    if (item == NULL) {
+        return NULL;
+    }
+    
+    if (strcmp(((lsp_doc*)item)->uri, str) == 0) {
+        return item;
+    }
+    
+    return NULL;
+}
+
+/*Destroyer for use with clist.*/
+static void destroy_lsp_doc(void *item) {
+    lsp_doc *doc = item;
+    
+    if (item == NULL) {
+        return;
+    }
+    
+    clear_doc_results(doc);
+    mem_free(doc->uri);
+    mem_free(doc->text);
+    mem_free(doc);
+}
+
+/*Runs the first pass over the document text from line first_line (one
+  based) on, over the results of the previous run up to that line, and
+  then the second pass. The results of a line of the previous run are
+  kept only if the line didn't change, so first_line is the first line
+  that did (or any line before it).*/
+static void run_doc(lsp_doc *doc, int first_line) {
+    unsigned int IC, DC;
+    int num_lines = 1;
+    char input[MAX_LINE];
+    const char *p_text = doc->text;
+    const char *p_char;
+    line_ret lineret;
+    line_info *p_line;
+    line_info *new_lines;
+    
+    if (first_line > doc->num_lines) {
+        first_line = doc->num_lines;
+    }
+    
+    if (first_line <= 1) {
+        clear_doc_results(doc);
+        init_run_assm(&doc->filedat, &doc->assm);
+        doc->filedat.collect_diag = true;
+        first_line = 1;
+    } else {
+        rewind_doc(doc, first_line);
+    }
+    
+    /*get_line_str produces one line per newline, plus the last one*/
+    for (p_char = strchr(doc->text, '\n'); p_char != NULL;
+         p_char = strchr(p_char+1, '\n')) {
+        num_lines++;
+        if (num_lines == first_line) {
+            p_text = p_char+1;
+        }
+    }
+    
+    new_lines = mem_realloc(doc->lines, sizeof(line_info)*num_lines, mem_lsp);
+    if (new_lines == NULL) {
+        fprintf(stderr, "Malloc failure in run_doc.");
+        exit(1);
+    }
+    doc->lines     = new_lines;
+    doc->num_lines = num_lines;
+    
+    while ((lineret = get_line_str(&p_text, MAX_LINE,
+                                   init_string(input, MAX_LINE)))) {
+        IC = doc->filedat.IC;
+        DC = doc->filedat.DC;
+        p_line = &doc->lines[doc->filedat.linenum];
+        save_line_state(doc, &p_line->before);
+        
+        first_pass_line(&doc->assm, &doc->filedat, input, lineret);
+        
+        p_line->sect = sect_none;
+        if (doc->filedat.IC != IC) {
+            p_line->sect    = sect_code;
+            p_line->address = IC;
+            p_line->count   = doc->filedat.IC - IC;
+        } else if (doc->filedat.DC != DC) {
+            p_line->sect    = sect_data;
+            p_line->address = DC;
+            p_line->count   = doc->filedat.DC - DC;
+        }
+    }
+    
+    apply_IC_offset(doc->filedat.last_label, doc->filedat.IC);
+    second_pass(&doc->assm, &doc->filedat, NULL);
+}
+
+/*Brings the results of the last run back to the state the first pass
+  was in before line linenum, which must be one of the lines of that
+  run. The second pass is undone along.*/
+static void rewind_doc(lsp_doc *doc, int linenum) {
+    c_list *cur_node;
+    item_undefid *p_undefid;
+    item_out_ent_ext *p_out;
+    item_extern *p_extern;
+    line_state *state = &doc->lines[linenum-1].before;
+    file_data *filedat = &doc->filedat;
+    assm_t *assm = &doc->assm;
+    
+    /*the second pass, the rest of it goes with the lists*/
+    apply_IC_offset(filedat->last_label, -(int)filedat->IC);
+    destroy_clist(&assm->last_out_ent, &destroy_item_out_ent_ext);
+    
+    cut_doc_list(&filedat->last_label, state->last_label,
+                 &filedat->label_table, &destroy_item_label);
+    cut_doc_list(&filedat->last_entry, state->last_entry,
+                 &filedat->entry_table, &destroy_item_entry);
+    cut_doc_list(&filedat->last_extern, state->last_extern,
+                 &filedat->extern_table, &destroy_item_extern);
+    cut_doc_list(&assm->last_undefid, state->last_undefid, NULL,
+                 &destroy_item_undefid);
+    cut_doc_list(&assm->last_out_ext, state->last_out_ext, NULL,
+                 &destroy_item_out_ent_ext);
+    cut_doc_list(&filedat->last_diag, state->last_diag, NULL,
+                 &destroy_item_diag);
+    
+    set_word_count(&assm->code, state->IC - IC_INIT);
+    drop_data_words(&assm->data, assm->data.count - (state->DC - DC_INIT));
+    
+    filedat->IC      = state->IC;
+    filedat->DC      = state->DC;
+    filedat->errors  = state->errors;
+    filedat->error   = state->error;
+    filedat->linenum = linenum-1;
+    
+    /*the dummy words the second pass filled in*/
+    if (assm->last_undefid != NULL) {
+        cur_node = assm->last_undefid;
+        do {
+            cur_node = cur_node->next;
+            p_undefid = cur_node->item;
+            set_word(&assm->code, p_undefid->IC-IC_INIT, ARE_RELOC);
+        } while (cur_node != assm->last_undefid);
+    }
+    
+    /*the externs are used by the lines that are kept alone now*/
+    if (filedat->last_extern != NULL) {
+        cur_node = filedat->last_extern;
+        do {
+            cur_node = cur_node->next;
+            ((item_extern*)cur_node->item)->was_used = false;
+        } while (cur_node != filedat->last_extern);
+    }
+    
+    if (assm->last_out_ext != NULL) {
+        cur_node = assm->last_out_ext;
+        do {
+            cur_node = cur_node->next;
+            p_out = cur_node->item;
+            if ((p_extern = find_chash_str(&filedat->extern_table,
+                                           &find_item_extern,
+                                           p_out->str)) != NULL) {
+                p_extern->was_used = true;
+            }
+        } while (cur_node != assm->last_out_ext);
+    }
+}
+
+/*Cuts the list after new_last (see cut_clist), and removes the items
+  that are cut from table as well, unless it's NULL.*/
+static void cut_doc_list(c_list **last_node, c_list *new_last,
+                         c_hash *table, void(*item_destroyer)(void *)) {
+    c_list *cur_node;
+    
+    if (table != NULL && *last_node != NULL && *last_node != new_last) {
+        cur_node = (new_last == NULL) ? *last_node : new_last;
+        do {
+            cur_node = cur_node->next;
+            remove_chash(table, cur_node->item);
+        } while (cur_node != *last_node);
+    }
+    
+    cut_clist(last_node, new_last, item_destroyer);
+}
+
+/*Stores the state of the first pass into state.*/
+static void save_line_state(lsp_doc *doc, line_state *state) {
+    state->IC           = doc->filedat.IC;
+    state->DC           = doc->filedat.DC;
+    state->errors       = doc->filedat.errors;
+    state->error        = doc->filedat.error;
+    state->last_label   = doc->filedat.last_label;
+    state->last_entry   = doc->filedat.last_entry;
+    state->last_extern  = doc->filedat.last_extern;
+    state->last_undefid = doc->assm.last_undefid;
+    state->last_out_ext = doc->assm.last_out_ext;
+    state->last_diag    = doc->filedat.last_diag;
+}
+
+/*Frees the results of the last run over the document.*/
+static void clear_doc_results(lsp_doc *doc) {
+    destroy_run_assm(&doc->filedat, &doc->assm);
+    
+    mem_free(doc->lines);
+    doc->lines     = NULL;
+    doc->num_lines = 0;
+}
+
+/*Sends the diagnostics collected during the last run.*/
+static void publish_diagnostics(lsp_doc *doc) {
+    bool first = true;
+    c_list *cur_node;
+    item_diag *p_diag;
+    json_buf body;
+    
+    init_json_buf(&body);
+    json_buf_add(&body, "{\"jsonrpc\":\"2.0\","
+                        "\"method\":\"textDocument/publishDiagnostics\","
+                        "\"params\":{\"uri\":");
+    json_buf_add_string(&body, doc->uri);
+    json_buf_add(&body, ",\"diagnostics\":[");
+    
+    if (doc->filedat.last_diag != NULL) {
+        cur_node = doc->filedat.last_diag->next;
+        do {
+            p_diag = cur_node->item;
+            
+            if (!first) {
+                json_buf_add(&body, ",");
+            }
+            first = false;
+            
+            json_buf_add(&body, "{");
+            add_range(&body, p_diag->linenum-1, p_diag->starting_index,
+                      p_diag->starting_index +
+                      (p_diag->length > 0 ? p_diag->length : 1));
+            json_buf_add(&body, ",\"severity\":");
+            json_buf_add_int(&body,
+                             strncmp(p_diag->message, "Warning", 7) == 0 ?
+                             SEVERITY_WARNING : SEVERITY_ERROR);
+            json_buf_add(&body, ",\"source\":");
+            json_buf_add_string(&body, LSP_SOURCE);
+            json_buf_add(&body, ",\"message\":");
+            json_buf_add_string(&body, p_diag->message);
+            json_buf_add(&body, "}");
+            
+            cur_node = cur_node->next;
+        } while (cur_node != doc->filedat.last_diag->next);
+    }
+    
+    json_buf_add(&body, "]}}");
+    send_message(&body);
+    destroy_json_buf(&body);
+}
+
+/*Applies a single TextDocumentContentChangeEvent to the document text.
+  Without a range, the change replaces the whole text. *first_line is
+  lowered to the line the change starts at (zero based), if it's below.*/
+static void apply_change(lsp_doc *doc, const char *change, long *first_line) {
+    int start, end;
+    long line, character;
+    int text_length = strlen(doc->text);
+    int new_length;
+    char *new_text;
+    char *change_text = json_get_string(json_get(change, "text"));
+    const char *range = json_get(change, "range");
+    
+    if (change_text == NULL) {
+        return;
+    }
+    
+    if (range == NULL) {
+        mem_free(doc->text);
+        doc->text = change_text;
+        *first_line = 0;
+        return;
+    }
+    
+    start = end = text_length;
+    if (json_get_int(json_get(json_get(range, "start"), "line"), &line) &&
+        json_get_int(json_get(json_get(range, "start"), "character"),
+                     &character)) {
+        start = pos_to_offset(doc->text, line, character);
+        if (line < *first_line) {
+            *first_line = line;
+        }
+    }
+    if (json_get_int(json_get(json_get(range, "end"), "line"), &line) &&
+        json_get_int(json_get(json_get(range, "end"), "character"),
+                     &character)) {
+        end = pos_to_offset(doc->text, line, character);
+    }
+    if (end < start) {
+        end = start;
+    }
+    
+    new_length = text_length - (end-start) + strlen(change_text);
+    new_text = mem_alloc(sizeof(char)*(new_length+1), mem_lsp);
+    if (new_text == NULL) {
+        fprintf(stderr, "Malloc failure in apply_change.");
+        exit(1);
+    }
+    
+    strncpy(new_text, doc->text, start);
+    strcpy(&new_text[start], change_text);
+    strcat(new_text, &doc->text[end]);
+    
+    mem_free(doc->text);
+    mem_free(change_text);
+    doc->text = new_text;
+}
+
+/*Converts a zero based line and character into an offset in text. The
+  positions past the end of a line (or the text) are clamped.*/
+static int pos_to_offset(const char *text, long line, long character) {
+    const char *p_char = text;
+    const char *p_newline;
+    
+    for (; line > 0 && (p_newline = strchr(p_char, '\n')) != NULL; line--) {
+        p_char = p_newline+1;
+    }
+    
+    if (line > 0) {
+        p_char += strlen(p_char); /*past the last line*/
+    }
+    
+    for (; character > 0 && *p_char != '\0' && *p_char != '\n'; p_char++) {
+        character--;
+    }
+    
+    return p_char - text;
+}
+
+/*Returns a malloc'd copy of the identifier-like word at the position,
+  NULL if there isn't one.*/
+static char *get_word_at(lsp_doc *doc, long line, long character) {
+    int start, end;
+    int line_offset = pos_to_offset(doc->text, line, 0);
+    int offset = pos_to_offset(doc->text, line, character);
+    char *word;
+    
+    start = end = offset;
+    while (start > line_offset && isalnum((unsigned char)doc->text[start-1])) {
+        start--;
+    }
+    while (isalnum((unsigned char)doc->text[end])) {
+        end++;
+    }
+    
+    if (start == end || !isalpha((unsigned char)doc->text[start])) {
+        return NULL;
+    }
+    
+    word = mem_alloc(sizeof(char)*(end-start+1), mem_lsp);
+    if (word == NULL) {
+        fprintf(stderr, "Malloc failure in get_word_at.");
+        exit(1);
+    }
+    strncpy(word, &doc->text[start], end-start);
+    word[end-start] = '\0';
+    
+    return word;
+}
+
+/*Reads params->position. Returns false if it's missing.*/
+static bool get_position(const char *params, long *line, long *character) {
+    const char *position = json_get(params, "position");
+    
+    return json_get_int(json_get(position, "line"), line) &&
+           json_get_int(json_get(position, "character"), character);
+}
+
+/*Appends "range":{...} covering [start, end) of the zero based line.*/
+static void add_range(json_buf *buf, int line, int start, int end) {
+    json_buf_add(buf, "\"range\":{\"start\":{\"line\":");
+    json_buf_add_int(buf, line);
+    json_buf_add(buf, ",\"character\":");
+    json_buf_add_int(buf, start);
+    json_buf_add(buf, "},\"end\":{\"line\":");
+    json_buf_add_int(buf, line);
+    json_buf_add(buf, ",\"character\":");
+    json_buf_add_int(buf, end);
+    json_buf_add(buf, "}}");
+}
+
+/*Appends "ADDRESS WORD(base 32) WORD(binary)" as a single line.*/
+static void add_word_line(json_buf *buf, unsigned int address,
+                          unsigned int word) {
+    int i;
+    char line_buf[64];
+    char b32_address[3];
+    char b32_word[3];
+    char *p_bin;
+    
+    sprintf(line_buf, "%u  %s  %s  ", address,
+            sprint_weird(address, b32_address), sprint_weird(word, b32_word));
+    
+    p_bin = &line_buf[strlen(line_buf)];
+    for (i = WORD_SIZE-1; i >= 0; i--) {
+        *p_bin++ = (word >> i & 1) ? '1' : '0';
+    }
+    *p_bin++ = '\n';
+    *p_bin   = '\0';
+    
+    json_buf_add(buf, line_buf);
+}
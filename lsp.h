@@ -0,0 +1,6 @@
+#ifndef LSP_H
+#define LSP_H
+
+void run_lsp(run_opts *opts);
+
+#endif /*LSP_H*/
@@ -1,7 +1,34 @@
 /*Assembler for the made-up language as described in 2018a workbook
   of the 20465 course.
   
-  Usage: assembler [filename1] [filename2] ... [filenameN]
+  Usage: assembler [options] [filename1] [filename2] ... [filenameN]
+         assembler --lsp [--alloc-stats]
+  
+  Options:
+    --syntax-only   run just the lexer and the parser checks (no second
+                    pass and no output files), for linting
+    --max-errors N  stop processing a file once N errors were found
+    --stats         print the time spent in each phase and the throughput,
+                    per file and for all the files together
+    --alloc-stats   print the allocations, bytes and peak live heap of
+                    each subsystem, for all the files together (or for
+                    the whole session of --lsp, to stderr)
+    --trace FILE    write Chrome trace events (spans of the files, passes,
+                    output files and sampled lines, and counters of IC, DC
+                    and the symbols) into FILE
+    --trace-cat L   print the debug output of the comma separated
+                    categories L: lex, parse, fpass, spass, out (or all)
+    --metrics-json FILE
+                    write a JSON record of every file into FILE, one per
+                    line (see write_file_metrics in stats.c)
+    --quiet         print nothing but the errors
+    --format F      the output format F: text (the .ob, .ent and .ext
+                    files, the default), bin (a single .obj file, see
+                    objfile.c) or runs (the .obj with the runs of equal
+                    data words compressed), objconv converts between them
+    --map F         also write the symbol map, every label with its final
+                    address, kind and line sorted by address, as text or
+                    bin into filename.map (see mapfile.c)
   
   The assembler demands that the passed file with the name filename* has a
   .as extension, while the argument itself must not have one. That is,
@@ -33,7 +60,17 @@
 
 #include <stdio.h>
 
+#include "bool.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "options.h"
 #include "assm_driver.h"
+#include "trace.h"
+#include "lsp.h"
 
 /*General description:
   --------------------
@@ -201,8 +238,11 @@
   And that's mostly it really. All that's left is for run_assm to call the
   output_machine_code function in assm.c, which does just that - outputs
   the machine code (provided we didn't encounter any errors during the
-  compilation, of course) to the relevant files. Then we go to the next
-  argv (if there is one) and repeat this whole process all over again.*/
+  compilation, of course) to the relevant files. The code, the data and
+  the entry and extern tables are gathered into an obj_image first, which
+  objfile.c writes as the text files or as the binary object. Then we go
+  to the next argv (if there is one) and repeat this whole process all
+  over again.*/
 
 
 /*---------------------------------------------------------------------------*/
@@ -239,6 +279,11 @@
   
   --------------
   
+  The language server (assembler --lsp) runs the very same passes over
+  the documents that the editor holds in memory, see lsp.c.
+  
+  --------------
+  
   Registers r8 and r9 are considered reserved words. It wasn't at all clear
   what to do with these, and this seemed like the most reasonable course
   of action. If used as a register operand, an error will be triggered.
@@ -258,20 +303,40 @@
 
 int main(int argc, char **argv) {
     int i;
-
+    run_opts opts;
+    
+    if ((argc = parse_options(argc, argv, &opts)) == -1) {
+        return 1;
+    }
+    
+    /*language server mode, see lsp.c*/
+    if (opts.lsp) {
+        run_lsp(&opts);
+        return 0;
+    }
+    
     if (argc == 1) {
         printf("Error, no input arguments.\n");
         return 0;
     }
     
-    puts("Queued files:");
-    for (i = 1; i < argc; i++) {
-         printf("%d: %s\n", i, argv[i]);
+    /*before anything is printed, it may change the buffering of stdout*/
+    if (opts.trace_cats != NULL && !set_trace_cats(opts.trace_cats)) {
+        return 1;
     }
     
-    run_assm(argc, argv); /*in assm_driver.c*/
+    if (!opts.quiet) {
+        puts("Queued files:");
+        for (i = 1; i < argc; i++) {
+             printf("%d: %s\n", i, argv[i]);
+        }
+    }
+    
+    run_assm(argc, argv, &opts); /*in assm_driver.c*/
     
-    putchar('\n');
+    if (!opts.quiet) {
+        putchar('\n');
+    }
     
     return 0;
 }
@@ -0,0 +1,271 @@
+/*The symbol map of an assembled file (--map), every label with its final
+  address, kind and line, sorted by address. With it, an address of the
+  image is named by a binary search (see find_map_symbol), without the
+  source or the .ent.
+  
+  The text map (name.map, --map=text) is for reading, a line per label:
+    "ADDRESS" TABSTOP "KIND" TABSTOP "LINE" TABSTOP "LABEL"
+  with the numbers in decimal and the kind being code or data.
+  
+  The binary map (name.map as well, --map=bin) is for the tools, with the
+  numbers as in the binary object (see objfile.c):
+    magic "AMAP", version (16 bits), word size (16 bits)
+    symbol count, names size (32 bits each)
+    the symbols: address, line (32 bits each), kind, name length (16 bits
+                 each), offset of the name in the names (32 bits)
+    the names, each with a terminator
+  The symbols are all of MAP_RECORD_SIZE bytes, so a tool can search the
+  file itself as well. The two are told apart by the magic.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "mapfile.h"
+#include "trace.h"
+
+#define MAP_MAGIC "AMAP"
+#define MAP_MAGIC_LENGTH 4
+#define MAP_VERSION 1
+#define MAP_RECORD_SIZE 16 /*bytes of a symbol of the binary map*/
+
+static void add_map_labels(symbol_map *map, c_list *last_label,
+                           stat_type stype, unsigned long *names_end);
+static void alloc_symbol_map(symbol_map *map, unsigned int count,
+                             unsigned long names_size);
+static const char *get_kind_name(int kind);
+
+/*Fills map (which is initialized by the call) with the labels of the
+  list, once the IC offset is applied to them. The labels are listed
+  in the order they're defined, so the code labels are by address and so
+  are the data labels, which are all after the code: taking the code
+  labels first and the data labels next sorts them without a sort.*/
+void get_symbol_map(c_list *last_label, symbol_map *map) {
+    unsigned int count = 0;
+    unsigned long names_size = 0;
+    c_list *cur_label;
+    item_label *p_label;
+    
+    if (last_label != NULL) {
+        cur_label = last_label;
+        do {
+            p_label = cur_label->item;
+            count++;
+            names_size += strlen(p_label->tok->tokstr) + 1;
+            cur_label = cur_label->next;
+        } while (cur_label != last_label);
+    }
+    
+    alloc_symbol_map(map, count, names_size);
+    names_size = 0;
+    add_map_labels(map, last_label, stype_instruction, &names_size);
+    add_map_labels(map, last_label, stype_datadir, &names_size);
+}
+
+/*Appends the labels of the list that are of stype to map, in order, their
+  names from *names_end on.*/
+static void add_map_labels(symbol_map *map, c_list *last_label,
+                           stat_type stype, unsigned long *names_end) {
+    size_t length;
+    c_list *cur_label;
+    item_label *p_label;
+    map_symbol *p_sym;
+    
+    if (last_label == NULL) {
+        return;
+    }
+    
+    cur_label = last_label->next;
+    do {
+        p_label = cur_label->item;
+        if (p_label->stype == stype) {
+            p_sym = &map->symbols[map->count++];
+            length = strlen(p_label->tok->tokstr);
+            
+            p_sym->address = p_label->IC;
+            p_sym->kind    = stype == stype_instruction ? MAP_CODE : MAP_DATA;
+            p_sym->linenum = p_label->linenum;
+            p_sym->name    = map->names + *names_end;
+            memcpy(p_sym->name, p_label->tok->tokstr, length + 1);
+            *names_end += length + 1;
+        }
+        
+        cur_label = cur_label->next;
+    } while (cur_label != last_label->next);
+}
+
+/*Writes map into filename.map as text.*/
+void write_map_text(symbol_map *map, char *filename) {
+    unsigned int i;
+    char fname_buf[MAX_FILE_LENGTH];
+    FILE *f_out = open_obj_file(fname_buf, filename, EXTENSION_MAP, "w");
+    
+    TRACE_BEGIN("output", fname_buf);
+    
+    for (i = 0; i < map->count; i++) {
+        fprintf(f_out, "%u%s%s%s%d%s%s\n", map->symbols[i].address, TABSTOP,
+                get_kind_name(map->symbols[i].kind), TABSTOP,
+                map->symbols[i].linenum, TABSTOP, map->symbols[i].name);
+    }
+    
+    fclose(f_out);
+    TRACE_END("output", fname_buf);
+}
+
+/*Writes map into filename.map as the binary map.*/
+void write_map_bin(symbol_map *map, char *filename) {
+    unsigned int i;
+    char fname_buf[MAX_FILE_LENGTH];
+    FILE *f_out = open_obj_file(fname_buf, filename, EXTENSION_MAP, "wb");
+    
+    TRACE_BEGIN("output", fname_buf);
+    
+    fwrite(MAP_MAGIC, 1, MAP_MAGIC_LENGTH, f_out);
+    put_u16(MAP_VERSION, f_out);
+    put_u16(WORD_BITS, f_out);
+    put_u32(map->count, f_out);
+    put_u32(map->names_size, f_out);
+    
+    for (i = 0; i < map->count; i++) {
+        put_u32(map->symbols[i].address, f_out);
+        put_u32(map->symbols[i].linenum, f_out);
+        put_u16(map->symbols[i].kind, f_out);
+        put_u16(strlen(map->symbols[i].name), f_out);
+        put_u32(map->symbols[i].name - map->names, f_out);
+    }
+    
+    if (map->names_size > 0) {
+        fwrite(map->names, 1, map->names_size, f_out);
+    }
+    
+    fclose(f_out);
+    TRACE_END("output", fname_buf);
+}
+
+/*Reads the binary map of filename into map, which is initialized by the
+  call. Returns false (and prints why) if the file can't be read, isn't
+  a binary map, is cut short or isn't sorted, map is left empty then.*/
+bool read_map_bin(symbol_map *map, char *filename) {
+    char magic[MAP_MAGIC_LENGTH];
+    char fname_buf[MAX_FILE_LENGTH];
+    unsigned int i;
+    unsigned int version, word_size, count, names_size;
+    unsigned int linenum, kind, length, offset;
+    bool read_ok = true;
+    FILE *f_in = open_obj_file(fname_buf, filename, EXTENSION_MAP, "rb");
+    
+    map->symbols    = NULL;
+    map->count      = 0;
+    map->names      = NULL;
+    map->names_size = 0;
+    
+    if (f_in == NULL) {
+        fprintf(stderr, "Error, can't read %s\n", fname_buf);
+        return false;
+    }
+    
+    if (fread(magic, 1, MAP_MAGIC_LENGTH, f_in) != MAP_MAGIC_LENGTH ||
+        memcmp(magic, MAP_MAGIC, MAP_MAGIC_LENGTH) != 0 ||
+        !get_u16(f_in, &version) || !get_u16(f_in, &word_size) ||
+        !get_u32(f_in, &count) || !get_u32(f_in, &names_size)) {
+        fprintf(stderr, "Error, %s is not a binary map.\n", fname_buf);
+        fclose(f_in);
+        return false;
+    }
+    
+    if (version != MAP_VERSION || word_size != WORD_BITS) {
+        fprintf(stderr, "Error, %s is of version %u (word size %u), "
+                        "expected %d (word size %d).\n", fname_buf,
+                version, word_size, MAP_VERSION, WORD_BITS);
+        fclose(f_in);
+        return false;
+    }
+    
+    alloc_symbol_map(map, count, names_size);
+    for (i = 0; read_ok && i < count; i++) {
+        read_ok = get_u32(f_in, &map->symbols[i].address) &&
+                  get_u32(f_in, &linenum) && get_u16(f_in, &kind) &&
+                  get_u16(f_in, &length) && get_u32(f_in, &offset) &&
+                  (unsigned long)offset + length < names_size &&
+                  (i == 0 ||
+                   map->symbols[i].address >= map->symbols[i-1].address);
+        
+        map->symbols[i].kind    = kind;
+        map->symbols[i].linenum = linenum;
+        map->symbols[i].name    = map->names + offset;
+        map->count++;
+    }
+    
+    read_ok = read_ok &&
+              fread(map->names, 1, names_size, f_in) == names_size;
+    map->names[names_size] = '\0'; /*so that no name runs past them*/
+    fclose(f_in);
+    
+    if (!read_ok) {
+        fprintf(stderr, "Error, %s is cut short or out of order.\n",
+                fname_buf);
+        destroy_symbol_map(map);
+        return false;
+    }
+    
+    return true;
+}
+
+/*Returns the last symbol of map at address or below it, which is the
+  label that address is in, or NULL if address is before all of them.*/
+map_symbol *find_map_symbol(symbol_map *map, unsigned int address) {
+    unsigned int low = 0;
+    unsigned int high = map->count; /*the first one above address*/
+    unsigned int mid;
+    
+    while (low < high) {
+        mid = low + (high - low)/2;
+        if (map->symbols[mid].address <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    return high == 0 ? NULL : &map->symbols[high - 1];
+}
+
+/*Frees what map holds, and leaves it empty.*/
+void destroy_symbol_map(symbol_map *map) {
+    mem_free(map->symbols);
+    mem_free(map->names);
+    
+    map->symbols    = NULL;
+    map->count      = 0;
+    map->names      = NULL;
+    map->names_size = 0;
+}
+
+/*Allocates room for count symbols and names_size bytes of names in map,
+  which is left without symbols.*/
+static void alloc_symbol_map(symbol_map *map, unsigned int count,
+                             unsigned long names_size) {
+    /*plus one, so that nothing is allocated of zero bytes*/
+    map->symbols = mem_alloc(sizeof(map_symbol)*(count+1), mem_output);
+    map->names   = mem_alloc(names_size+1, mem_output);
+    if (map->symbols == NULL || map->names == NULL) {
+        fprintf(stderr, "Malloc failure in alloc_symbol_map.");
+        exit(1);
+    }
+    
+    map->count      = 0;
+    map->names_size = names_size;
+}
+
+static const char *get_kind_name(int kind) {
+    return kind == MAP_CODE ? "code" : "data";
+}
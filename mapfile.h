@@ -0,0 +1,41 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#define EXTENSION_MAP ".map" /*the symbol map*/
+
+/*the symbol map formats, --map*/
+#define MAP_FORMAT_NONE 0 /*no map*/
+#define MAP_FORMAT_TEXT 1
+#define MAP_FORMAT_BIN  2
+
+/*what a label is of*/
+#define MAP_CODE 0 /*an instruction*/
+#define MAP_DATA 1 /*a data statement*/
+
+    /*a label of the map*/
+    typedef struct map_symbol {
+        unsigned int address;
+        int kind;    /*MAP_CODE or MAP_DATA*/
+        int linenum; /*of its definition*/
+        char *name;  /*in the names of the map*/
+    } map_symbol;
+
+/*Every label of an assembled file at its final address, sorted by
+  address, so that the label of an address is found by a binary search.
+  See mapfile.c for the files.*/
+typedef struct symbol_map {
+    map_symbol *symbols;
+    unsigned int count;
+    
+    char *names;              /*of all the symbols, with the terminators*/
+    unsigned long names_size;
+} symbol_map;
+
+void get_symbol_map(c_list *last_label, symbol_map *map);
+void write_map_text(symbol_map *map, char *filename);
+void write_map_bin(symbol_map *map, char *filename);
+bool read_map_bin(symbol_map *map, char *filename);
+map_symbol *find_map_symbol(symbol_map *map, unsigned int address);
+void destroy_symbol_map(symbol_map *map);
+
+#endif /*MAPFILE_H*/
@@ -0,0 +1,77 @@
+/*Converter between the object formats of the assembler (see objfile.c).
+
+  Usage: objconv --to FORMAT name [out_name]
+  
+  Options:
+    --to FORMAT   bin reads the text files name.ob (with name.ent and
+                  name.ext, if there are) and writes out_name.obj, runs
+                  does the same with the data runs kept as runs, text
+                  reads name.obj (of either kind) and writes the text
+                  files of out_name
+  
+  The names are given without an extension, like to the assembler, and
+  out_name is name if it's not given. Exits with 1 if the input can't be
+  read.*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bool.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+
+int main(int argc, char **argv) {
+    int i;
+    char *format = NULL;
+    char *name = NULL;
+    char *out_name = NULL;
+    bool to_bin;
+    bool read_ok;
+    obj_image img;
+    
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--to") == 0 && i+1 < argc) {
+            format = argv[++i];
+        } else if (strncmp(argv[i], "--to=", 5) == 0) {
+            format = argv[i] + 5;
+        } else if (argv[i][0] != '-' && name == NULL) {
+            name = argv[i];
+        } else if (argv[i][0] != '-' && out_name == NULL) {
+            out_name = argv[i];
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    
+    if (format == NULL || name == NULL ||
+        (strcmp(format, "bin") != 0 && strcmp(format, "runs") != 0 &&
+         strcmp(format, "text") != 0)) {
+        fprintf(stderr, "Usage: objconv --to bin|runs|text name "
+                        "[out_name]\n");
+        return 2;
+    }
+    
+    if (out_name == NULL) {
+        out_name = name;
+    }
+    to_bin = strcmp(format, "text") != 0;
+    
+    read_ok = to_bin ? read_obj_text(&img, name) : read_obj_bin(&img, name);
+    if (read_ok) {
+        if (to_bin) {
+            write_obj_bin(&img, out_name, strcmp(format, "runs") == 0);
+        } else {
+            write_obj_text(&img, out_name);
+        }
+    }
+    
+    destroy_obj_image(&img);
+    
+    return read_ok ? 0 : 1;
+}
@@ -0,0 +1,766 @@
+/*The object files, written from an obj_image and read back into one.
+
+  The text files are the ones of the workbook, every number being two
+  weird base digits (see output_weird in assm.c):
+    .ob   "CODE_COUNT" TABSTOP "DATA_COUNT", then "ADDRESS" TABSTOP "WORD"
+          for every word, the code followed by the data
+    .ent  "LABEL" \t "ADDRESS" for every entry
+    .ext  "LABEL" \t "ADDRESS" for every word that refers to an extern
+  Two digits only reach 1023, which is fine for the machine (see the
+  memory check in main.c), so the text files can't hold bigger images.
+  
+  The binary object (.obj, --format=bin) has all of it in one file, with
+  the numbers as little endian unsigned ints:
+    magic "AOBJ", version (16 bits), word size (16 bits), flags (32 bits)
+    base address, code count, data count, entry count, extern count
+                                                       (32 bits each)
+    the words, bit packed as in a word_image (see wordimg.h), padded with
+    zeros to a whole byte
+    the entries, then the externs: address (32 bits), name length
+                                   (16 bits), the name (no terminator)
+  With OBJ_DATA_RUNS in the flags (--format=runs), the data is kept as in
+  a data_image instead, after the (packed and padded) code:
+    run count (32 bits), then the runs: start, count (32 bits each),
+                                        value (16 bits)
+    the literals, packed and padded like the code
+  Version 1 had no flags, and is read as well.*/
+
+#define _POSIX_C_SOURCE 200112L /*for mmap*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "trace.h"
+
+#define OBJ_MAGIC "AOBJ"
+#define OBJ_MAGIC_LENGTH 4
+#define OBJ_VERSION 2
+#define OBJ_DATA_RUNS 0x01 /*flag, the data is kept as runs and literals*/
+#define MAX_OBJ_NAME 256 /*of a symbol, more than any label needs*/
+#define MIN_SYMBOL_BYTES 6 /*of a symbol in the file, with an empty name*/
+#define RUN_BYTES 10       /*of a run in the file*/
+#define MAX_OBJ_WORDS 0xFFFFFFFFUL /*of the code and the data together*/
+
+    /*a text object file, mapped read only*/
+    typedef struct mapped_file {
+        const char *start; /*NULL if the file is empty*/
+        const char *end;
+        size_t size;
+    } mapped_file;
+
+static void write_text_symbols(obj_symbol *syms, unsigned int count,
+                               char *filename, char *ext);
+static bool read_text_symbols(obj_symbol **syms, unsigned int *count,
+                              char *filename, char *ext);
+static bool map_obj_file(mapped_file *map, char *fname_buf, char *filename,
+                         char *ext);
+static void unmap_obj_file(mapped_file *map);
+static bool get_weird_field(const char **p_text, const char *end,
+                            unsigned int *value);
+static void skip_line(const char **p_text, const char *end);
+
+static void put_data_runs(data_image *data, FILE *f_out);
+static bool get_data_runs(data_image *data, unsigned int count,
+                          FILE *f_in);
+static void get_obj_words(obj_image *img, word_image *words);
+
+/*Allocates the symbol tables of img, the code and the data are empty
+  and are appended by the caller. The symbols have no names yet (see
+  set_obj_symbol).*/
+void init_obj_image(obj_image *img, unsigned int base,
+                    unsigned int entry_count, unsigned int extern_count) {
+    img->base         = base;
+    img->entry_count  = entry_count;
+    img->extern_count = extern_count;
+    
+    init_word_image(&img->code);
+    init_data_image(&img->data);
+    
+    /*+1 so that an empty table allocates something as well*/
+    img->entries = mem_alloc(sizeof(obj_symbol)*((size_t)entry_count+1),
+                             mem_output);
+    img->externs = mem_alloc(sizeof(obj_symbol)*((size_t)extern_count+1),
+                             mem_output);
+    if (img->entries == NULL || img->externs == NULL) {
+        fprintf(stderr, "Malloc failure in init_obj_image.");
+        exit(1);
+    }
+    
+    memset(img->entries, 0, sizeof(obj_symbol)*entry_count);
+    memset(img->externs, 0, sizeof(obj_symbol)*extern_count);
+}
+
+/*Frees the words, the symbol tables and the names in them.*/
+void destroy_obj_image(obj_image *img) {
+    unsigned int i;
+    
+    for (i = 0; i < img->entry_count; i++) {
+        mem_free(img->entries[i].name);
+    }
+    for (i = 0; i < img->extern_count; i++) {
+        mem_free(img->externs[i].name);
+    }
+    
+    destroy_word_image(&img->code);
+    destroy_data_image(&img->data);
+    mem_free(img->entries);
+    mem_free(img->externs);
+    img->entries = NULL;
+    img->externs = NULL;
+}
+
+/*Sets the address of sym and a copy of the length chars of name.*/
+void set_obj_symbol(obj_symbol *sym, unsigned int address,
+                    const char *name, size_t length) {
+    sym->address = address;
+    sym->name    = mem_alloc(length+1, mem_output);
+    if (sym->name == NULL) {
+        fprintf(stderr, "Malloc failure in set_obj_symbol.");
+        exit(1);
+    }
+    memcpy(sym->name, name, length);
+    sym->name[length] = '\0';
+}
+
+/*Key getter for use with c_hash, of the symbols by name.*/
+char *get_obj_symbol_name(void *item) {
+    return ((obj_symbol*)item)->name;
+}
+
+/*Finder for use with c_hash.*/
+void *find_obj_symbol(void *item, char *str) {
+    return strcmp(((obj_symbol*)item)->name, str) == 0 ? item : NULL;
+}
+
+/*Writes img into the .ob, .ent and .ext files of filename (given without
+  an extension). The .ent and .ext files are only there if img has
+  entries or externs, an old one is removed otherwise.*/
+void write_obj_text(obj_image *img, char *filename) {
+    unsigned int i;
+    char weird_buf[3];
+    char fname_buf[MAX_FILE_LENGTH];
+    word_image words;
+    FILE *f_out = open_obj_file(fname_buf, filename, EXTENSION_OB, "w");
+    
+    TRACE_BEGIN("output", fname_buf);
+    
+    /*the amount of instructions and data*/
+    fprintf(f_out, "%s%s", sprint_weird(img->code.count, weird_buf), TABSTOP);
+    fprintf(f_out, "%s\n", sprint_weird(img->data.count, weird_buf));
+    
+    /*output format: "ADDRESS" TABSTOP "MACHINECODE"*/
+    get_obj_words(img, &words);
+    for (i = 0; i < words.count; i++) {
+        fprintf(f_out, "%s%s", sprint_weird(img->base + i, weird_buf),
+                TABSTOP);
+        fprintf(f_out, "%s\n", sprint_weird(get_word(&words, i), weird_buf));
+    }
+    destroy_word_image(&words);
+    
+    fclose(f_out);
+    TRACE_END("output", fname_buf);
+    
+    write_text_symbols(img->entries, img->entry_count, filename,
+                       EXTENSION_ENT);
+    write_text_symbols(img->externs, img->extern_count, filename,
+                       EXTENSION_EXT);
+}
+
+/*Writes the symbols into filename with the ext extension, or removes
+  the file if there are none.*/
+static void write_text_symbols(obj_symbol *syms, unsigned int count,
+                               char *filename, char *ext) {
+    unsigned int i;
+    char weird_buf[3];
+    char fname_buf[MAX_FILE_LENGTH];
+    FILE *f_out;
+    
+    if (count == 0) {
+        sprintf(fname_buf, "%s%s", filename, ext);
+        remove(fname_buf);
+        return;
+    }
+    
+    f_out = open_obj_file(fname_buf, filename, ext, "w");
+    TRACE_BEGIN("output", fname_buf);
+    
+    /*output format: "LABEL" TABSTOP "ADDRESS"*/
+    for (i = 0; i < count; i++) {
+        fprintf(f_out, "%s\t%s\n", syms[i].name,
+                sprint_weird(syms[i].address, weird_buf));
+    }
+    
+    fclose(f_out);
+    TRACE_END("output", fname_buf);
+}
+
+/*Reads the .ob, .ent and .ext files of filename into img, which is
+  initialized by the call. A missing .ent or .ext file means there are
+  no entries or externs. Returns false (and prints why) if the files
+  can't be read or are malformed, img is left empty then.
+  
+  The files are mapped rather than read, and decoded in place.*/
+bool read_obj_text(obj_image *img, char *filename) {
+    unsigned int i;
+    unsigned int code_count, data_count;
+    unsigned int address;
+    unsigned int word;
+    unsigned int run_value = 0; /*the equal data words not added yet*/
+    unsigned int run_count = 0;
+    bool words_ok = true;
+    char fname_buf[MAX_FILE_LENGTH];
+    const char *p_text;
+    mapped_file map;
+    
+    init_obj_image(img, IC_INIT, 0, 0);
+    if (!map_obj_file(&map, fname_buf, filename, EXTENSION_OB)) {
+        fprintf(stderr, "Error, can't read %s\n", fname_buf);
+        return false;
+    }
+    
+    p_text = map.start;
+    if (!get_weird_field(&p_text, map.end, &code_count) ||
+        !get_weird_field(&p_text, map.end, &data_count)) {
+        fprintf(stderr, "Error, %s has no header.\n", fname_buf);
+        unmap_obj_file(&map);
+        return false;
+    }
+    
+    skip_line(&p_text, map.end);
+    reserve_words(&img->code, code_count);
+    for (i = 0; i < code_count + data_count; i++) {
+        words_ok = get_weird_field(&p_text, map.end, &address) &&
+                   get_weird_field(&p_text, map.end, &word);
+        if (!words_ok) {
+            break;
+        }
+        skip_line(&p_text, map.end);
+        
+        if (i == 0) {
+            img->base = address;
+        }
+        
+        /*the data goes in by the runs of equal words*/
+        if (i < code_count) {
+            append_word(&img->code, word);
+        } else if (run_count > 0 && word == run_value) {
+            run_count++;
+        } else {
+            append_data_run(&img->data, run_value, run_count);
+            run_value = word;
+            run_count = 1;
+        }
+    }
+    append_data_run(&img->data, run_value, run_count);
+    unmap_obj_file(&map);
+    
+    if (!words_ok) {
+        fprintf(stderr, "Error, %s is missing words.\n", fname_buf);
+    }
+    
+    mem_free(img->entries);
+    mem_free(img->externs);
+    img->entries = NULL;
+    img->externs = NULL;
+    if (!words_ok ||
+        !read_text_symbols(&img->entries, &img->entry_count, filename,
+                           EXTENSION_ENT) ||
+        !read_text_symbols(&img->externs, &img->extern_count, filename,
+                           EXTENSION_EXT)) {
+        destroy_obj_image(img);
+        init_obj_image(img, IC_INIT, 0, 0);
+        return false;
+    }
+    
+    return true;
+}
+
+/*Reads the symbols of filename with the ext extension into a new array
+  in *syms. Returns false (and prints why) if a line is malformed.*/
+static bool read_text_symbols(obj_symbol **syms, unsigned int *count,
+                              char *filename, char *ext) {
+    unsigned int lines = 0;
+    unsigned int address;
+    char fname_buf[MAX_FILE_LENGTH];
+    const char *p_text;
+    const char *p_name;
+    size_t name_length;
+    mapped_file map;
+    bool found = map_obj_file(&map, fname_buf, filename, ext);
+    
+    /*a line per symbol, counted first for the size of the array*/
+    for (p_text = map.start; found && p_text < map.end; lines++) {
+        skip_line(&p_text, map.end);
+    }
+    
+    *count = 0;
+    *syms  = mem_alloc(sizeof(obj_symbol)*(lines+1), mem_output);
+    if (*syms == NULL) {
+        fprintf(stderr, "Malloc failure in read_text_symbols.");
+        exit(1);
+    }
+    
+    if (!found) { /*no such symbols*/
+        return true;
+    }
+    
+    p_text = map.start;
+    while (*count < lines) {
+        p_name = p_text;
+        while (p_text < map.end && *p_text != '\t' && *p_text != ' ' &&
+               *p_text != '\n') {
+            p_text++;
+        }
+        name_length = p_text - p_name;
+        
+        if (name_length == 0 || p_text == map.end || *p_text == '\n') {
+            fprintf(stderr, "Error, malformed line %u in %s\n", *count+1,
+                    fname_buf);
+            unmap_obj_file(&map);
+            return false;
+        }
+        
+        if (!get_weird_field(&p_text, map.end, &address)) {
+            fprintf(stderr, "Error, malformed address in %s of %.*s\n",
+                    fname_buf, (int)name_length, p_name);
+            unmap_obj_file(&map);
+            return false;
+        }
+        
+        skip_line(&p_text, map.end);
+        set_obj_symbol(&(*syms)[(*count)++], address, p_name,
+                       name_length);
+    }
+    
+    unmap_obj_file(&map);
+    return true;
+}
+
+/*Opens filename with the ext extension in mode, the full name is left
+  in fname_buf. Exits if it can't be written.*/
+FILE *open_obj_file(char *fname_buf, char *filename, char *ext,
+                    char *mode) {
+    FILE *f_obj;
+    
+    init_string(fname_buf, MAX_FILE_LENGTH);
+    sprintf(fname_buf, "%s%s", filename, ext);
+    f_obj = fopen(fname_buf, mode);
+    if (f_obj == NULL && *mode == 'w') {
+        fprintf(stderr, "Error, fopen returned NULL for \"w\" "
+                        "in open_obj_file.");
+        exit(1);
+    }
+    
+    return f_obj;
+}
+
+/*Maps filename with the ext extension into map, the full name is left
+  in fname_buf. Returns false if it can't be read. An empty file is
+  mapped to nothing, with map->start == map->end.*/
+static bool map_obj_file(mapped_file *map, char *fname_buf, char *filename,
+                         char *ext) {
+    int fd;
+    struct stat st;
+    void *addr;
+    
+    init_string(fname_buf, MAX_FILE_LENGTH);
+    sprintf(fname_buf, "%s%s", filename, ext);
+    
+    map->start = NULL;
+    map->end   = NULL;
+    map->size  = 0;
+    
+    if ((fd = open(fname_buf, O_RDONLY)) < 0) {
+        return false;
+    }
+    
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    
+    map->size = st.st_size;
+    if (map->size > 0) {
+        addr = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        
+        posix_madvise(addr, map->size, POSIX_MADV_SEQUENTIAL);
+        map->start = addr;
+        map->end   = map->start + map->size;
+    }
+    
+    close(fd); /*the mapping stays*/
+    return true;
+}
+
+static void unmap_obj_file(mapped_file *map) {
+    if (map->size > 0) {
+        munmap((void*)map->start, map->size);
+    }
+}
+
+/*Reads the two weird base digits at *p_text, after any blanks, into
+  value and advances *p_text past them. Returns false if they're not
+  there (end is where the text ends).*/
+static bool get_weird_field(const char **p_text, const char *end,
+                            unsigned int *value) {
+    int result;
+    
+    while (*p_text < end && (**p_text == ' ' || **p_text == '\t')) {
+        (*p_text)++;
+    }
+    
+    if (end - *p_text < 2 || (result = get_weird(*p_text)) < 0) {
+        return false;
+    }
+    
+    *value   = result;
+    *p_text += 2;
+    
+    return true;
+}
+
+/*Advances *p_text past the end of the line, whatever is left on it (or
+  to the end of the text).*/
+static void skip_line(const char **p_text, const char *end) {
+    const char *p_newline = memchr(*p_text, '\n', end - *p_text);
+    
+    *p_text = p_newline == NULL ? end : p_newline + 1;
+}
+
+/*Writes img into the binary object of filename (given without an
+  extension). If data_runs is set, the runs of the data are kept.*/
+void write_obj_bin(obj_image *img, char *filename, bool data_runs) {
+    char fname_buf[MAX_FILE_LENGTH];
+    FILE *f_out = open_obj_file(fname_buf, filename, EXTENSION_OBJ, "wb");
+    
+    TRACE_BEGIN("output", fname_buf);
+    put_obj_bin(img, f_out, data_runs);
+    fclose(f_out);
+    TRACE_END("output", fname_buf);
+}
+
+/*Writes img as a binary object from where f_out is, which is where it
+  ends after (see archive.c for the objects that are part of a file).*/
+void put_obj_bin(obj_image *img, FILE *f_out, bool data_runs) {
+    word_image words;
+    
+    fwrite(OBJ_MAGIC, 1, OBJ_MAGIC_LENGTH, f_out);
+    put_u16(OBJ_VERSION, f_out);
+    put_u16(WORD_BITS, f_out);
+    put_u32(data_runs ? OBJ_DATA_RUNS : 0, f_out);
+    put_u32(img->base, f_out);
+    put_u32(img->code.count, f_out);
+    put_u32(img->data.count, f_out);
+    put_u32(img->entry_count, f_out);
+    put_u32(img->extern_count, f_out);
+    
+    if (data_runs) {
+        put_packed_words(&img->code, f_out);
+        put_data_runs(&img->data, f_out);
+    } else {
+        get_obj_words(img, &words);
+        put_packed_words(&words, f_out);
+        destroy_word_image(&words);
+    }
+    
+    put_bin_symbols(img->entries, img->entry_count, f_out);
+    put_bin_symbols(img->externs, img->extern_count, f_out);
+}
+
+void put_u16(unsigned int value, FILE *f_out) {
+    putc(value & 0xFF, f_out);
+    putc((value >> 8) & 0xFF, f_out);
+}
+
+void put_u32(unsigned long value, FILE *f_out) {
+    put_u16(value & 0xFFFF, f_out);
+    put_u16((value >> 16) & 0xFFFF, f_out);
+}
+
+/*The image is packed just the same, padding included.*/
+void put_packed_words(word_image *words, FILE *f_out) {
+    if (words->count > 0) {
+        fwrite(words->bytes, 1, get_word_image_bytes(words->count), f_out);
+    }
+}
+
+static void put_data_runs(data_image *data, FILE *f_out) {
+    unsigned int i;
+    
+    put_u32(data->run_count, f_out);
+    for (i = 0; i < data->run_count; i++) {
+        put_u32(data->runs[i].start, f_out);
+        put_u32(data->runs[i].count, f_out);
+        put_u16(data->runs[i].value, f_out);
+    }
+    
+    put_packed_words(&data->literals, f_out);
+}
+
+void put_bin_symbols(obj_symbol *syms, unsigned int count, FILE *f_out) {
+    unsigned int i;
+    size_t length;
+    
+    for (i = 0; i < count; i++) {
+        length = strlen(syms[i].name);
+        put_u32(syms[i].address, f_out);
+        put_u16(length, f_out);
+        fwrite(syms[i].name, 1, length, f_out);
+    }
+}
+
+/*Reads the binary object of filename into img, which is initialized by
+  the call. Returns false (and prints why) if the file can't be read, is
+  of another version or is cut short, img is left empty then.*/
+bool read_obj_bin(obj_image *img, char *filename) {
+    char fname_buf[MAX_FILE_LENGTH];
+    bool read_ok;
+    FILE *f_in = open_obj_file(fname_buf, filename, EXTENSION_OBJ, "rb");
+    
+    if (f_in == NULL) {
+        init_obj_image(img, IC_INIT, 0, 0);
+        fprintf(stderr, "Error, can't read %s\n", fname_buf);
+        return false;
+    }
+    
+    read_ok = get_obj_bin(img, f_in, fname_buf);
+    fclose(f_in);
+    
+    return read_ok;
+}
+
+/*Reads img (which is initialized by the call) from the binary object
+  where f_in is, name being the one in the errors. Returns false if it's
+  not one, img is empty then.*/
+bool get_obj_bin(obj_image *img, FILE *f_in, char *name) {
+    char magic[OBJ_MAGIC_LENGTH];
+    unsigned int i;
+    unsigned int version, word_size;
+    unsigned int flags = 0;
+    unsigned int base, code_count, data_count, entry_count, extern_count;
+    bool words_ok;
+    word_image words;
+    
+    init_obj_image(img, IC_INIT, 0, 0);
+    
+    if (fread(magic, 1, OBJ_MAGIC_LENGTH, f_in) != OBJ_MAGIC_LENGTH ||
+        memcmp(magic, OBJ_MAGIC, OBJ_MAGIC_LENGTH) != 0 ||
+        !get_u16(f_in, &version) || !get_u16(f_in, &word_size)) {
+        fprintf(stderr, "Error, %s is not an object file.\n", name);
+        return false;
+    }
+    
+    if (version < 1 || version > OBJ_VERSION || word_size != WORD_BITS) {
+        fprintf(stderr, "Error, %s is of version %u (word size %u), "
+                        "expected up to %d (word size %d).\n", name,
+                version, word_size, OBJ_VERSION, WORD_BITS);
+        return false;
+    }
+    
+    if ((version > 1 && !get_u32(f_in, &flags)) ||
+        !get_u32(f_in, &base) || !get_u32(f_in, &code_count) ||
+        !get_u32(f_in, &data_count) || !get_u32(f_in, &entry_count) ||
+        !get_u32(f_in, &extern_count)) {
+        fprintf(stderr, "Error, %s has no header.\n", name);
+        return false;
+    }
+    
+    /*the counts are checked against what's left of the file before the
+      tables are allocated for them, so that a broken header can't ask
+      for more memory than the file could fill*/
+    if (code_count > MAX_OBJ_WORDS - data_count ||
+        entry_count > get_bytes_left(f_in)/MIN_SYMBOL_BYTES ||
+        extern_count > get_bytes_left(f_in)/MIN_SYMBOL_BYTES - entry_count) {
+        fprintf(stderr, "Error, %s is cut short.\n", name);
+        return false;
+    }
+    
+    destroy_obj_image(img);
+    init_obj_image(img, base, entry_count, extern_count);
+    
+    if (flags & OBJ_DATA_RUNS) {
+        words_ok = get_packed_words(&img->code, code_count, f_in) &&
+                   get_data_runs(&img->data, data_count, f_in);
+    } else {
+        /*split into the code and the data, where the runs are found*/
+        init_word_image(&words);
+        words_ok = get_packed_words(&words, code_count + data_count, f_in);
+        for (i = 0; words_ok && i < words.count; i++) {
+            if (i < code_count) {
+                append_word(&img->code, get_word(&words, i));
+            } else {
+                append_data_run(&img->data, get_word(&words, i), 1);
+            }
+        }
+        destroy_word_image(&words);
+    }
+    
+    if (!words_ok ||
+        !get_bin_symbols(img->entries, entry_count, f_in) ||
+        !get_bin_symbols(img->externs, extern_count, f_in)) {
+        fprintf(stderr, "Error, %s is cut short.\n", name);
+        destroy_obj_image(img);
+        init_obj_image(img, IC_INIT, 0, 0);
+        return false;
+    }
+    
+    return true;
+}
+
+bool get_u16(FILE *f_in, unsigned int *value) {
+    int low = getc(f_in);
+    int high = getc(f_in);
+    
+    if (low == EOF || high == EOF) {
+        return false;
+    }
+    
+    *value = (unsigned int)low | (unsigned int)high << 8;
+    return true;
+}
+
+bool get_u32(FILE *f_in, unsigned int *value) {
+    unsigned int low, high;
+    
+    if (!get_u16(f_in, &low) || !get_u16(f_in, &high)) {
+        return false;
+    }
+    
+    *value = low | high << 16;
+    return true;
+}
+
+/*Reads count words written by put_packed_words into words, which must
+  be empty.*/
+bool get_packed_words(word_image *words, unsigned int count, FILE *f_in) {
+    unsigned long size = get_word_image_bytes(count);
+    
+    if (size > get_bytes_left(f_in)) {
+        return false;
+    }
+    
+    reserve_words(words, count);
+    if (count > 0 && fread(words->bytes, 1, size, f_in) != size) {
+        return false;
+    }
+    words->count = count;
+    
+    return true;
+}
+
+/*Reads the count words of data written by put_data_runs into data, which
+  must be empty. The runs come before the literals, so they're put in
+  place once the literals are read as well.*/
+static bool get_data_runs(data_image *data, unsigned int count,
+                          FILE *f_in) {
+    unsigned int i, j;
+    unsigned int run_count;
+    unsigned int covered = 0; /*words in the runs*/
+    unsigned int literal = 0; /*the next literal*/
+    bool runs_ok = true;
+    word_run *runs;
+    word_image literals;
+    
+    if (!get_u32(f_in, &run_count) || run_count > count ||
+        run_count > get_bytes_left(f_in)/RUN_BYTES) {
+        return false;
+    }
+    
+    runs = mem_alloc(sizeof(word_run)*(run_count+1), mem_output);
+    if (runs == NULL) {
+        fprintf(stderr, "Malloc failure in get_data_runs.");
+        exit(1);
+    }
+    
+    /*in order, apart and within the count*/
+    for (i = 0; runs_ok && i < run_count; i++) {
+        runs_ok = get_u32(f_in, &runs[i].start) &&
+                  get_u32(f_in, &runs[i].count) &&
+                  get_u16(f_in, &runs[i].value) &&
+                  (i == 0 || runs[i].start >= runs[i-1].start +
+                                              runs[i-1].count) &&
+                  runs[i].start <= count &&
+                  runs[i].count <= count - runs[i].start;
+        covered += runs[i].count;
+    }
+    
+    init_word_image(&literals);
+    runs_ok = runs_ok && get_packed_words(&literals, count - covered, f_in);
+    
+    for (i = 0, j = 0; runs_ok && i <= run_count; i++) {
+        /*the literals before the run (or after the last one)*/
+        for (; j < (i < run_count ? runs[i].start : count); j++) {
+            append_data_run(data, get_word(&literals, literal++), 1);
+        }
+        
+        if (i < run_count) {
+            append_data_run(data, runs[i].value, runs[i].count);
+            j += runs[i].count;
+        }
+    }
+    
+    destroy_word_image(&literals);
+    mem_free(runs);
+    
+    return runs_ok;
+}
+
+/*Returns the bytes of the file of f_in from where it is on, to check the
+  counts read from it against. Anything goes if it's not a regular file,
+  which can't tell.*/
+unsigned long get_bytes_left(FILE *f_in) {
+    struct stat st;
+    long at = ftell(f_in);
+    
+    if (at < 0 || fstat(fileno(f_in), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return (unsigned long)-1;
+    }
+    
+    return st.st_size > at ? (unsigned long)(st.st_size - at) : 0;
+}
+
+/*Reads the symbols written by put_bin_symbols. The names that were read
+  are kept even on failure, so that destroy_obj_image frees them.*/
+bool get_bin_symbols(obj_symbol *syms, unsigned int count, FILE *f_in) {
+    unsigned int i;
+    unsigned int address, length;
+    char name[MAX_OBJ_NAME];
+    
+    for (i = 0; i < count; i++) {
+        if (!get_u32(f_in, &address) || !get_u16(f_in, &length) ||
+            length >= MAX_OBJ_NAME ||
+            fread(name, 1, length, f_in) != length) {
+            return false;
+        }
+        name[length] = '\0';
+        set_obj_symbol(&syms[i], address, name, length);
+    }
+    
+    return true;
+}
+
+/*Makes words the code followed by the data, with the runs expanded.*/
+static void get_obj_words(obj_image *img, word_image *words) {
+    init_word_image(words);
+    reserve_words(words, img->code.count + img->data.count);
+    copy_word_image(words, &img->code);
+    append_data_words(words, &img->data);
+}
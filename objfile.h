@@ -0,0 +1,66 @@
+#ifndef OBJFILE_H
+#define OBJFILE_H
+
+#define EXTENSION_OB  ".ob"
+#define EXTENSION_ENT ".ent"
+#define EXTENSION_EXT ".ext"
+#define EXTENSION_OBJ ".obj" /*the binary object*/
+
+#define TABSTOP "    " /*whitespace between the fields of the .ob*/
+
+/*the output formats, --format*/
+#define OBJ_FORMAT_TEXT 0 /*.ob, .ent and .ext*/
+#define OBJ_FORMAT_BIN  1 /*.obj*/
+#define OBJ_FORMAT_RUNS 2 /*.obj with the data runs kept as runs*/
+
+    /*an entry, or a use of an extern (address of the word to patch)*/
+    typedef struct obj_symbol {
+        unsigned int address;
+        char *name;
+    } obj_symbol;
+
+/*An assembled file, as it's written into the object files. Both the
+  text files (.ob, .ent and .ext) and the binary object (.obj) are
+  written from it and read into it, see objfile.c for the formats.*/
+typedef struct obj_image {
+    unsigned int base; /*address of the first word, IC_INIT*/
+    word_image code;
+    data_image data;   /*right after the code*/
+    
+    unsigned int entry_count;
+    obj_symbol *entries;
+    
+    unsigned int extern_count;
+    obj_symbol *externs;
+} obj_image;
+
+void init_obj_image(obj_image *img, unsigned int base,
+                    unsigned int entry_count, unsigned int extern_count);
+void destroy_obj_image(obj_image *img);
+void set_obj_symbol(obj_symbol *sym, unsigned int address,
+                    const char *name, size_t length);
+char *get_obj_symbol_name(void *item);
+void *find_obj_symbol(void *item, char *str);
+
+void write_obj_text(obj_image *img, char *filename);
+void write_obj_bin(obj_image *img, char *filename, bool data_runs);
+bool read_obj_text(obj_image *img, char *filename);
+bool read_obj_bin(obj_image *img, char *filename);
+void put_obj_bin(obj_image *img, FILE *f_out, bool data_runs);
+bool get_obj_bin(obj_image *img, FILE *f_in, char *name);
+
+/*the pieces of the binary object, for the other binary files (see
+  relink.c and archive.c)*/
+FILE *open_obj_file(char *fname_buf, char *filename, char *ext,
+                    char *mode);
+void put_u16(unsigned int value, FILE *f_out);
+void put_u32(unsigned long value, FILE *f_out);
+void put_packed_words(word_image *words, FILE *f_out);
+void put_bin_symbols(obj_symbol *syms, unsigned int count, FILE *f_out);
+bool get_u16(FILE *f_in, unsigned int *value);
+bool get_u32(FILE *f_in, unsigned int *value);
+bool get_packed_words(word_image *words, unsigned int count, FILE *f_in);
+bool get_bin_symbols(obj_symbol *syms, unsigned int count, FILE *f_in);
+unsigned long get_bytes_left(FILE *f_in);
+
+#endif /*OBJFILE_H*/
@@ -0,0 +1,161 @@
+/*Command line options.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "bool.h"
+#include "clist.h"
+#include "wordimg.h"
+#include "objfile.h"
+#include "mapfile.h"
+#include "options.h"
+
+#define OPTION_PREFIX "--"
+
+static int get_count_arg(int argc, char **argv, int *i);
+static char *get_string_arg(int argc, char **argv, int *i);
+
+/*Initializes opts and fills it from the options in argv. The options are
+  removed from argv, so that only the program name and the filenames
+  remain in it. Returns the new argc, or -1 upon an unknown option.*/
+int parse_options(int argc, char **argv, run_opts *opts) {
+    int i;
+    int new_argc = 1;
+    char *format;
+    
+    opts->lsp         = false;
+    opts->syntax_only = false;
+    opts->max_errors  = 0;
+    opts->stats       = false;
+    opts->alloc_stats = false;
+    opts->trace_file  = NULL;
+    opts->trace_cats  = NULL;
+    opts->metrics_file = NULL;
+    opts->quiet       = false;
+    opts->obj_format  = OBJ_FORMAT_TEXT;
+    opts->map_format  = MAP_FORMAT_NONE;
+    
+    for (i = 1; i < argc; i++) {
+        if (strncmp(argv[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) != 0) {
+            argv[new_argc++] = argv[i]; /*filename*/
+        } else if (strcmp(argv[i], "--lsp") == 0) {
+            opts->lsp = true;
+        } else if (strcmp(argv[i], "--syntax-only") == 0) {
+            opts->syntax_only = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            opts->stats = true;
+        } else if (strcmp(argv[i], "--alloc-stats") == 0) {
+            opts->alloc_stats = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            opts->quiet = true;
+        } else if (strcmp(argv[i], "--max-errors") == 0 ||
+                   strncmp(argv[i], "--max-errors=", 13) == 0) {
+            if ((opts->max_errors = get_count_arg(argc, argv, &i)) < 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--trace") == 0 ||
+                   strncmp(argv[i], "--trace=", 8) == 0) {
+            if ((opts->trace_file = get_string_arg(argc, argv, &i)) == NULL) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--trace-cat") == 0 ||
+                   strncmp(argv[i], "--trace-cat=", 12) == 0) {
+            if ((opts->trace_cats = get_string_arg(argc, argv, &i)) == NULL) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--metrics-json") == 0 ||
+                   strncmp(argv[i], "--metrics-json=", 15) == 0) {
+            opts->metrics_file = get_string_arg(argc, argv, &i);
+            if (opts->metrics_file == NULL) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--format") == 0 ||
+                   strncmp(argv[i], "--format=", 9) == 0) {
+            if ((format = get_string_arg(argc, argv, &i)) == NULL) {
+                return -1;
+            } else if (strcmp(format, "text") == 0) {
+                opts->obj_format = OBJ_FORMAT_TEXT;
+            } else if (strcmp(format, "bin") == 0) {
+                opts->obj_format = OBJ_FORMAT_BIN;
+            } else if (strcmp(format, "runs") == 0) {
+                opts->obj_format = OBJ_FORMAT_RUNS;
+            } else {
+                fprintf(stderr, "Error, unknown format: %s\n", format);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--map") == 0 ||
+                   strncmp(argv[i], "--map=", 6) == 0) {
+            if ((format = get_string_arg(argc, argv, &i)) == NULL) {
+                return -1;
+            } else if (strcmp(format, "text") == 0) {
+                opts->map_format = MAP_FORMAT_TEXT;
+            } else if (strcmp(format, "bin") == 0) {
+                opts->map_format = MAP_FORMAT_BIN;
+            } else {
+                fprintf(stderr, "Error, unknown map format: %s\n", format);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Error, unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+    
+    return new_argc;
+}
+
+/*Reads the non negative number of the option argv[*i], either given as
+  --option=N or as --option N (in which case *i is advanced past N).
+  Returns -1 and prints an error if it's missing, malformed or above
+  INT_MAX.*/
+static int get_count_arg(int argc, char **argv, int *i) {
+    long count;
+    char *end;
+    char *arg = strchr(argv[*i], '=');
+    
+    if (arg != NULL) {
+        arg++;
+    } else if (*i+1 < argc) {
+        arg = argv[++(*i)];
+    } else {
+        fprintf(stderr, "Error, %s expects a number.\n", argv[*i]);
+        return -1;
+    }
+    
+    errno = 0;
+    count = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || count < 0) {
+        fprintf(stderr, "Error, invalid number: %s\n", arg);
+        return -1;
+    } else if (errno == ERANGE || count > INT_MAX) {
+        fprintf(stderr, "Error, %s is too large, the maximum is %d.\n",
+                arg, INT_MAX);
+        return -1;
+    }
+    
+    return (int)count;
+}
+
+/*Reads the argument of the option argv[*i], either given as
+  --option=ARG or as --option ARG (in which case *i is advanced past ARG).
+  Returns NULL and prints an error if it's missing.*/
+static char *get_string_arg(int argc, char **argv, int *i) {
+    char *option = argv[*i];
+    char *arg = strchr(option, '=');
+    
+    if (arg != NULL) {
+        arg++;
+    } else if (*i+1 < argc) {
+        arg = argv[++(*i)];
+    }
+    
+    if (arg == NULL || *arg == '\0') {
+        fprintf(stderr, "Error, %s expects an argument.\n", option);
+        return NULL;
+    }
+    
+    return arg;
+}
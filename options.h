@@ -0,0 +1,23 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+/*Command line options. Everything that starts with "--" is an option,
+  the rest of the arguments are the names of the files.*/
+typedef struct run_opts {
+    bool lsp;         /*--lsp, run as a language server (see lsp.c)*/
+    bool syntax_only; /*--syntax-only, lexer and parser checks only*/
+    int max_errors;   /*--max-errors N, stop a file at N errors, 0 if never*/
+    bool stats;       /*--stats, per phase timing (see stats.c)*/
+    bool alloc_stats; /*--alloc-stats, memory per subsystem (see alloc.c)*/
+    char *trace_file; /*--trace FILE, Chrome trace events (see trace.c)*/
+    char *trace_cats; /*--trace-cat LIST, debug output (see trace.h)*/
+    char *metrics_file; /*--metrics-json FILE, records of the files*/
+    bool quiet;       /*--quiet, no banners, just the errors*/
+    int obj_format;   /*--format F, OBJ_FORMAT_* (see objfile.c)*/
+    int map_format;   /*--map F, MAP_FORMAT_* (see mapfile.c)*/
+} run_opts;
+
+
+int parse_options(int argc, char **argv, run_opts *opts);
+
+#endif /*OPTIONS_H*/
@@ -6,25 +6,19 @@
 #include <stdarg.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "clist.h"
 #include "token.h"
 #include "statement.h"
 #include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
 #include "tokstream.h"
+#include "trace.h"
 #include "parser.h"
 
-#define MAX_LABEL_LENGTH 30
-
-/*used to check the limits of integers*/
-typedef enum {
-    numt_eightbit,
-    numt_tenbit
-} numtype;
-
 #define MAX_RWORDS 31 /*reserved words*/
 
-extern unsigned int ERRORS;
-
 static char *addmode_strings[MAX_ADD_MODES] = {
     "IMM",
     "DIR",
@@ -42,6 +36,9 @@ static ddir_data_t *get_ddir_data(file_data *filedat);
 static ddir_struct_t *get_ddir_struct(file_data *filedat);
 static token *get_ddir_entry(file_data *filedat);
 static token *get_ddir_extern(file_data *filedat);
+static token *get_ddir_symbol(file_data *filedat,
+                              char *(*get_error)(file_data*, token*, int*,
+                                                 bool*));
 
 static operand_t *get_operand_next(file_data *filedat);
 static operand_t *get_operand_imm(file_data *filedat);
@@ -52,14 +49,13 @@ static operand_t *get_operand_reg(file_data *filedat);
 static bool expect_single(file_data *filedat, token_type toktype);
 static bool expect(file_data *filedat, int numvar, token_type toktype, ...);
 static bool stat_inst_proper_ending(int opcode, file_data *filedat);
-static bool is_ident_length_ok(char *str);
-static bool is_int_within_bounds(int num, numtype num_t);
-static bool is_valid_label(c_list *last_label, file_data *filedat, token *tok);
+static bool is_valid_label(c_hash *label_table, file_data *filedat,
+                           token *tok);
 
 static void print_operand_error(int starting_index, int length,
                          file_data *filedat, char *message);
-static void print_prevdef(int linenum);
-static void print_valid_addmodes(const int *valid_modes);
+static void print_prevdef(file_data *filedat, int linenum);
+static void print_valid_addmodes(file_data *filedat, const int *valid_modes);
 
 
 
@@ -69,16 +65,16 @@ static void print_valid_addmodes(const int *valid_modes);
 void *parse_line(line_data *lindat, file_data *filedat) {
     void *statement = NULL;
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("___parse_line___");
-    #endif
+    }
     
     init_tokstream(filedat->last_token);
     
-    #ifdef DEBUG_PARSER
-        print_clist(*last_token, &print_clist_token);
+    if (TRACE_CAT(TRACE_PARSE)) {
+        print_clist(filedat->last_token, &print_clist_token);
         printf("\n");
-    #endif
+    }
     
     /*label*/
     get_label(lindat, filedat);
@@ -90,11 +86,11 @@ void *parse_line(line_data *lindat, file_data *filedat) {
     /*statement*/
     statement = get_stat(lindat, filedat);
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         putchar('\n');
         print_statement(statement, lindat->stype);
         putchar('\n');
-    #endif /*DEBUG*/
+    }
     
     return statement; /*success*/
 }
@@ -109,12 +105,12 @@ void *parse_line(line_data *lindat, file_data *filedat) {
   error, and lindat->label_error is set to true.*/
 static void get_label(line_data *lindat, file_data *filedat) {
     bool valid_label = false;
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("___get_label___");
-    #endif /*DEBUG*/
+    }
     
     tstream_savepos();
-   
+    
     /*in case of .entry or .extern label may be invalid*/
     if (probe_toktype(toktype_identifier)) {
         valid_label = true;
@@ -141,9 +137,9 @@ static void get_label(line_data *lindat, file_data *filedat) {
         lindat->valid_label = valid_label;
         
         advance_tokstream();
-        #ifdef DEBUG_PARSER
+        if (TRACE_CAT(TRACE_PARSE)) {
             puts("LABEL ACQUIRED");
-        #endif /*DEBUG*/
+        }
     } else {
         if (valid_label == true) {
             lindat->label_error = true;
@@ -161,9 +157,9 @@ static void get_label(line_data *lindat, file_data *filedat) {
 static void *get_stat(line_data *lindat, file_data *filedat) {
     void *statement = NULL;
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("\n___get_stat___");
-    #endif /*DEBUG*/
+    }
     
     if (is_EOL_token()) {
         print_tok_error(get_cur_token(), filedat,
@@ -178,7 +174,7 @@ static void *get_stat(line_data *lindat, file_data *filedat) {
                 get_cur_token()->toktype != toktype_datadir_extern) {
                 /*if we have one, that is*/
                 if (lindat->label_token != NULL) {
-                    if (!is_valid_label(filedat->last_label, filedat,
+                    if (!is_valid_label(&filedat->label_table, filedat,
                                         lindat->label_token)) {
                         return NULL;
                     /*a more generic error, triggers when toktype
@@ -203,7 +199,7 @@ static void *get_stat(line_data *lindat, file_data *filedat) {
     } else if (probe_toktype(toktype_operator)) {
         /*check the label*/
         if (lindat->label_token != NULL) {
-            if (!is_valid_label(filedat->last_label, filedat,
+            if (!is_valid_label(&filedat->label_table, filedat,
                                 lindat->label_token)) {
                 return NULL;
             /*a more generic error, triggers when toktype
@@ -225,9 +221,9 @@ static void *get_stat(line_data *lindat, file_data *filedat) {
                         "Error, expected operator or data directive.");
     }
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("---END OF GET STATEMENT---");
-    #endif /*DEBUG*/
+    }
     
     return statement;
 }
@@ -249,11 +245,11 @@ static stat_instr_t *get_stat_instr(file_data *filedat) {
     
     advance_tokstream();
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("\n   --- get_stat_instr ---");
         printf("get_stat_instr init feed: %s\n",
                get_cur_token()->tokstr);
-    #endif /*DEBUG*/
+    }
     
     /*do we have any tokens after the operator?*/
     if (is_EOL_token()) {
@@ -290,10 +286,10 @@ static stat_instr_t *get_stat_instr(file_data *filedat) {
                                  operator_token->starting_index)-1,
                                 filedat,
                                 "Error, not enough operands.");
-            fprintf(stderr,
-                    "The number of operands that %s accepts is %d.\n",
-                    get_toktype_string(opcode+toktype_operator_mov),
-                    OPS[opcode].opds);
+            print_error_note(filedat, "The number of operands that %s "
+                             "accepts is %d.\n",
+                             get_toktype_string(opcode+toktype_operator_mov),
+                             OPS[opcode].opds);
             operand_error = true;
             break;
         }
@@ -306,7 +302,7 @@ static stat_instr_t *get_stat_instr(file_data *filedat) {
                                 (*target_opd)->length,
                                 filedat,
                                 "Error, invalid addressing mode.");
-            print_valid_addmodes(allowed_addmodes);
+            print_valid_addmodes(filedat, allowed_addmodes);
             destroy_operand(*target_opd);
             *target_opd = NULL;
         }
@@ -327,10 +323,10 @@ static stat_instr_t *get_stat_instr(file_data *filedat) {
         destroy_operand(operand_src);
         destroy_operand(operand_dst);
     }
-
-    #ifdef DEBUG_PARSER
+    
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("--- end of get_instr_statement---");
-    #endif /*DEBUG*/
+    }
     
     return stat_inst;
 }
@@ -347,10 +343,10 @@ static bool stat_inst_proper_ending(int opcode, file_data *filedat) {
                                 filedat,
                                 "Error, erroneous attempt "
                                 "at operand assignment.");
-            fprintf(stderr,
-                    "The number of operands that %s accepts is %d.\n",
-                    get_toktype_string(opcode+toktype_operator_mov),
-                    OPS[opcode].opds);
+            print_error_note(filedat, "The number of operands that %s "
+                             "accepts is %d.\n",
+                             get_toktype_string(opcode+toktype_operator_mov),
+                             OPS[opcode].opds);
         } else {
             print_operand_error(get_prev_token()->starting_index, 0,
                                 filedat,
@@ -392,7 +388,7 @@ static operand_t *get_operand_imm(file_data *filedat) {
             /*offset of 1 for the # operator*/
             print_operand_error(starting_index+1, length-1, filedat,
                                 "Error, number out of bounds.");
-            fprintf(stderr, "Expected bounds (inclusive): "
+            print_error_note(filedat, "Expected bounds (inclusive): "
                              "%d, %d.\n", EIGHTBIT_MIN, EIGHTBIT_MAX);
         } else {
             /*get the complement*/
@@ -401,7 +397,7 @@ static operand_t *get_operand_imm(file_data *filedat) {
                 num += (EIGHTBIT_MAX+1)*2;
             }
             
-            opd_data = malloc(sizeof(operand_data));
+            opd_data = mem_alloc(sizeof(operand_data), mem_parser);
             if (opd_data == NULL) {
                 fprintf(stderr, "Malloc failure in get_operand_imm.");
                 exit(1);
@@ -431,7 +427,7 @@ static operand_t *get_operand_dir() {
     starting_index = get_cur_token()->starting_index;
     length = get_cur_token()->length;
     
-    opd_data = malloc(sizeof(operand_data));
+    opd_data = mem_alloc(sizeof(operand_data), mem_parser);
     if (opd_data == NULL) {
         fprintf(stderr, "Malloc failure in get_operand_dir.");
         exit(1);
@@ -441,7 +437,7 @@ static operand_t *get_operand_dir() {
     
     operand = create_operand(starting_index, length,
                              addmode_dir, opd_data);
-                             
+    
     advance_tokstream();
     
     return operand;
@@ -470,8 +466,8 @@ static operand_t *get_operand_struct(file_data *filedat) {
             print_operand_error(starting_index, length, filedat,
                             "Error, struct field must be 1 or 2.");
         } else {
-            opd_data = malloc(sizeof(operand_data));
-            structure = malloc(sizeof(struct_opd_t));
+            opd_data = mem_alloc(sizeof(operand_data), mem_parser);
+            structure = mem_alloc(sizeof(struct_opd_t), mem_parser);
             if (opd_data == NULL || structure == NULL) {
                 fprintf(stderr, "Malloc failure");
                 exit(1);
@@ -489,7 +485,7 @@ static operand_t *get_operand_struct(file_data *filedat) {
         print_operand_error(starting_index, length, filedat,
                             "Error, invalid struct field access.");
     }
-
+    
     advance_tokstream();
     
     return operand;
@@ -510,7 +506,7 @@ static operand_t *get_operand_reg(file_data *filedat) {
                             "Error, invalid register. Valid registers are "
                             "0 through 7 (inclusive).");
     } else {
-        opd_data = malloc(sizeof(operand_data));
+        opd_data = mem_alloc(sizeof(operand_data), mem_parser);
         if (opd_data == NULL) {
             fprintf(stderr, "Malloc failure");
             exit(1);
@@ -532,10 +528,10 @@ static operand_t *get_operand_reg(file_data *filedat) {
 static operand_t *get_operand_next(file_data *filedat) {
     operand_t *operand = NULL;
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("\n\n   --- get_operand_next ---");
         printf("GNO init feed: %s\n", get_cur_token()->tokstr);
-    #endif /*DEBUG*/
+    }
     
     tstream_savepos(); /*for struct operand*/
     
@@ -559,8 +555,9 @@ static operand_t *get_operand_next(file_data *filedat) {
         } else {
             print_tok_error(get_cur_token(), filedat,
                             "Error, identifier is too long.");
-            fprintf(stderr, "Max. identifier length allowed: %d.\n",
-                    MAX_LABEL_LENGTH);
+            print_error_note(filedat,
+                             "Max. identifier length allowed: %d.\n",
+                             MAX_LABEL_LENGTH);
             advance_tokstream();
         }
     /*register operand*/
@@ -590,9 +587,9 @@ static operand_t *get_operand_next(file_data *filedat) {
     
     advance_tokstream();
     
-    #ifdef DEBUG_PARSER
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("   --- get_operand_next END ---");
-    #endif
+    }
     
     return operand;
 }
@@ -606,11 +603,11 @@ static stat_ddir_t *get_stat_ddir(file_data *filedat) {
     void *data = NULL; /*for create_stat_ddir*/
     
     advance_tokstream();
-
-    #ifdef DEBUG_PARSER
+    
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("\n\t---get_stat_ddir---");
         printf("FEED: %s\n", get_cur_token()->tokstr);
-    #endif /*DEBUG*/
+    }
     
     /*data*/
     if (datadir == datadir_data) {
@@ -629,12 +626,14 @@ static stat_ddir_t *get_stat_ddir(file_data *filedat) {
             
             tstream_loadpos();
             
-            data = malloc(sizeof(char)*(strlen(get_cur_token()->tokstr))+1);
+            data = mem_alloc(sizeof(char)*
+                             (strlen(get_cur_token()->tokstr)+1),
+                             mem_parser);
             if (data == NULL) {
                 fprintf(stderr, "Malloc failure in get_stat_ddir.");
                 exit(1);
             }
-        
+            
             strcpy(data, get_cur_token()->tokstr);
         /*entry, extern*/
         } else {
@@ -653,8 +652,8 @@ static stat_ddir_t *get_stat_ddir(file_data *filedat) {
             } else {
                 print_tok_error(get_cur_token(), filedat,
                                 "Error, erroneous token length.");
-                fprintf(stderr, "Max. length allowed: %d.\n",
-                        MAX_LABEL_LENGTH);
+                print_error_note(filedat, "Max. length allowed: %d.\n",
+                                 MAX_LABEL_LENGTH);
             }
         }
     }
@@ -662,10 +661,10 @@ static stat_ddir_t *get_stat_ddir(file_data *filedat) {
     if (data != NULL) {
         stat_data = create_stat_ddir(datadir, data);
     }
-
-    #ifdef DEBUG_PARSER
+    
+    if (TRACE_CAT(TRACE_PARSE)) {
         puts("\n\t@@@ get_stat_ddir END @@@");
-    #endif /*DEBUG*/
+    }
     
     return stat_data;
 }
@@ -680,7 +679,7 @@ static ddir_data_t *get_ddir_data(file_data *filedat) {
     /*trickier and messier if we put a condition*/
     while (!0) {
         if (!expect_single(filedat, toktype_number)) {
-            destroy_clist(&data_list, &free);
+            destroy_clist(&data_list, &mem_free);
             return NULL;
         /*acquire the number, add to the list*/
         } else {
@@ -689,9 +688,9 @@ static ddir_data_t *get_ddir_data(file_data *filedat) {
             if (!is_int_within_bounds(buffer, numt_tenbit)) {
                 print_tok_error(get_cur_token(), filedat,
                             "Error, number out of bounds.");
-                fprintf(stderr, "Expected bounds (inclusive): "
-                                "%d, %d.\n", TENBIT_MIN, TENBIT_MAX);
-                destroy_clist(&data_list, &free);
+                print_error_note(filedat, "Expected bounds (inclusive): "
+                                 "%d, %d.\n", TENBIT_MIN, TENBIT_MAX);
+                destroy_clist(&data_list, &mem_free);
                 return NULL;
             }
             
@@ -700,7 +699,7 @@ static ddir_data_t *get_ddir_data(file_data *filedat) {
                 buffer = buffer + (TENBIT_MAX+1)*2;
             }
             
-            new_num = malloc(sizeof(unsigned int));
+            new_num = mem_alloc(sizeof(unsigned int), mem_code);
             if (new_num == NULL) {
                 fprintf(stderr, "Malloc failure in get_ddir_data");
                 exit(1);
@@ -721,14 +720,14 @@ static ddir_data_t *get_ddir_data(file_data *filedat) {
                 print_tok_error(get_prev_token(), filedat,
                             "Error, erroneous comma at the "
                             "end of a data statement.");
-                destroy_clist(&data_list, &free);
+                destroy_clist(&data_list, &mem_free);
                 return NULL;
             }
         } else {
             print_tok_error(get_cur_token(), filedat,
                             "Error, data entry is comma "
                             "delimited and accepts only number literals.");
-            destroy_clist(&data_list, &free);
+            destroy_clist(&data_list, &mem_free);
             return NULL;
         }
     }
@@ -756,11 +755,11 @@ static ddir_struct_t *get_ddir_struct(file_data *filedat) {
     if (!is_int_within_bounds(num, numt_tenbit)) {
         print_tok_error(get_cur_token(), filedat,
                     "Error, number out of bounds.");
-        fprintf(stderr, "Expected bounds (inclusive): "
-                        "%d, %d.\n", TENBIT_MIN, TENBIT_MAX);
+        print_error_note(filedat, "Expected bounds (inclusive): "
+                         "%d, %d.\n", TENBIT_MIN, TENBIT_MAX);
         return NULL;
     }
-            
+    
     /*get 2s complement*/
     if (num < 0) {
         num = num + (TENBIT_MAX+1)*2;
@@ -776,71 +775,37 @@ static ddir_struct_t *get_ddir_struct(file_data *filedat) {
 
 /*Acquires the .entry directive.*/
 static token *get_ddir_entry(file_data *filedat) {
-    bool error = filedat->error;
-    item_entry *p_entry = NULL;
-    item_extern *p_extern = NULL;
-    
-    /*entry list lookup for muldef*/
-    if ((p_entry = find_clist_str(filedat->last_entry,
-                                   &find_item_entry,
-                                   get_cur_token()->tokstr)) != NULL) {
-        print_tok_error(get_cur_token(), filedat,
-                        "Warning, multiple definitions of entry.");
-        print_prevdef(p_entry->linenum);
-        filedat->error = error;
-    /*extern list lookup*/
-    } else if ((p_extern = find_clist_str(filedat->last_extern,
-                                          &find_item_extern,
-                                          get_cur_token()->tokstr)) != NULL) {
-        print_tok_error(get_cur_token(), filedat,
-                        "Warning, previously defined as extern.");
-        print_prevdef(p_extern->linenum);
-    }
-    
-    if (p_entry == NULL && p_extern == NULL) {
-        return get_cur_token();
-    } else {
-        return NULL;
-    }
+    return get_ddir_symbol(filedat, &get_entry_error);
 }
 
 /*Acquires the .extern directive.*/
 static token *get_ddir_extern(file_data *filedat) {
-    bool error = filedat->error; /*for warnings*/
-    item_label *p_label = NULL;
-    item_entry *p_entry = NULL;
-    item_extern *p_extern = NULL;
-    
-    /*extern list lookup for muldef*/
-    if ((p_extern = find_clist_str(filedat->last_extern,
-                                   &find_item_extern,
-                                   get_cur_token()->tokstr)) != NULL) {
-        print_tok_error(get_cur_token(), filedat,
-                        "Warning, multiple definitions of extern.");
-        print_prevdef(p_extern->linenum);
-        filedat->error = error;
-    /*entry list lookup*/
-    } else if ((p_entry = find_clist_str(filedat->last_entry,
-                                          &find_item_entry,
-                                          get_cur_token()->tokstr)) != NULL) {
-        print_tok_error(get_cur_token(), filedat,
-                        "Error, previously defined as extern.");
-        print_prevdef(p_entry->linenum);
-    /*label list lookup*/
-    } else if ((p_label = find_clist_str(filedat->last_label,
-                                         &find_item_label,
-                                         get_cur_token()->tokstr)) != NULL) {
-        print_tok_error(get_cur_token(), filedat,
-                        "Error, previously defined as label.");
-        print_prevdef(p_label->linenum);
+    return get_ddir_symbol(filedat, &get_extern_error);
+}
+
+/*Acquires the symbol of .entry or .extern, checked by get_error (either
+  get_entry_error or get_extern_error). Returns NULL if the symbol was
+  rejected, even if it was only a warning.*/
+static token *get_ddir_symbol(file_data *filedat,
+                              char *(*get_error)(file_data*, token*, int*,
+                                                 bool*)) {
+    int prev_linenum;
+    bool warning;
+    char *message = get_error(filedat, get_cur_token(), &prev_linenum,
+                              &warning);
+    
+    if (message == NULL) {
+        return get_cur_token();
     }
     
-    /*if none of the errors were triggered, that is*/
-    if (p_entry == NULL && p_label == NULL && p_extern == NULL) {
-        return get_cur_token();
+    if (warning) {
+        print_tok_warning(get_cur_token(), filedat, message);
     } else {
-        return NULL;
+        print_tok_error(get_cur_token(), filedat, message);
     }
+    print_prevdef(filedat, prev_linenum);
+    
+    return NULL;
 }
 
 /*Expects a certain toktype from the current tokstream token. If the
@@ -852,7 +817,8 @@ static bool expect_single(file_data *filedat, token_type toktype) {
     if (!probe_toktype(toktype)) {
         print_tok_error(get_cur_token(), filedat,
                     "Error, unexpected token.");
-        fprintf(stderr, "Expected %s.\n", get_toktype_string(toktype));
+        print_error_note(filedat, "Expected %s.\n",
+                         get_toktype_string(toktype));
         
         return false;
     }
@@ -876,7 +842,8 @@ static bool expect(file_data *filedat, int numvar, token_type toktype, ...) {
        if (!probe_toktype(toktype)) {
             print_tok_error(get_cur_token(), filedat,
                     "Error, unexpected token.");
-            fprintf(stderr, "Expected %s.\n", get_toktype_string(toktype));
+            print_error_note(filedat, "Expected %s.\n",
+                             get_toktype_string(toktype));
             
             va_end(args);
             return false;
@@ -892,8 +859,8 @@ static bool expect(file_data *filedat, int numvar, token_type toktype, ...) {
 }
 
 /*Prints previous definition at Line linenum to stderr.*/
-static void print_prevdef(int linenum) {
-    fprintf(stderr, "Previously defined at Line %d.\n", linenum);
+static void print_prevdef(file_data *filedat, int linenum) {
+    print_error_note(filedat, "Previously defined at Line %d.\n", linenum);
 }
 
 /*Prints an error that is relevant to the operand. The starting_index and
@@ -902,10 +869,24 @@ static void print_operand_error(int starting_index, int length,
                          file_data *filedat, char *message) {
     int i = 0;
     char *line = filedat->current_line;
+    token *tok;
     
-    ERRORS++;
+    set_error(filedat);
     
-    filedat->error = true;
+    if (filedat->collect_diag) {
+        add_diag(filedat, filedat->linenum, starting_index, length, message);
+        return;
+    }
+    
+    /*queued under the operand, as if it were a token*/
+    if (filedat->err_queue != NULL) {
+        tok = create_token(starting_index, length > 0 ? length : 0, line);
+        tok->toktype = toktype_unknown;
+        queue_error_assm(filedat->err_queue, tok, filedat->linenum, message,
+                         NULL);
+        destroy_token(tok);
+        return;
+    }
     
     while (*line == ' ' || *line == '\t') {
         line++; i++;
@@ -931,13 +912,13 @@ static void print_operand_error(int starting_index, int length,
     for (; i < (length+starting_index); i++) {
         fprintf(stderr, "~");
     }
-
+    
     fprintf(stderr, "\n");
 }
 
 /*If the length of str is strictly greater than MAX_LABEL_LENGTH,
-  true is returned. Otherwise, false is returned.*/
-static bool is_ident_length_ok(char *str) {
+  false is returned. Otherwise, true is returned.*/
+bool is_ident_length_ok(char *str) {
     if (strlen(str) > MAX_LABEL_LENGTH) {
         return false;
     }
@@ -948,50 +929,136 @@ static bool is_ident_length_ok(char *str) {
 /*Checks if the label is valid. Prints error if not, and returns false.
   Otherwise returns true.
   
-  The pointer last_label isn't really required since it's in filedat,
+  The pointer label_table isn't really required since it's in filedat,
   but it's consistent with other functions in the project.*/
-static bool is_valid_label(c_list *last_label, file_data *filedat,
+static bool is_valid_label(c_hash *label_table, file_data *filedat,
                            token *tok) {
+    int prev_linenum;
+    char *message = get_label_error(label_table, filedat, tok,
+                                    &prev_linenum);
+    
+    if (message == NULL) {
+        return true;
+    }
+    
+    print_tok_error(tok, filedat, message);
+    if (prev_linenum > 0) {
+        print_prevdef(filedat, prev_linenum);
+    } else if (!is_reserved_word(tok)) {
+        print_error_note(filedat, "Max. allowed label length is %d.\n",
+                         MAX_LABEL_LENGTH);
+    }
+    
+    return false;
+}
+
+/*Returns why tok can't be defined as a label, or NULL if it can. If it
+  was defined before (as a label or an extern), the line of that is put
+  into *prev_linenum, which is 0 otherwise. Nothing is printed, so that
+  the builder (see builder.c) reports the same errors its own way.*/
+char *get_label_error(c_hash *label_table, file_data *filedat, token *tok,
+                      int *prev_linenum) {
     item_label *label;
     item_extern *p_extern;
     
+    *prev_linenum = 0;
+    
     /*reserved word check*/
-    if (downcast_toktype(tok->toktype) == toktype_operator ||
-        downcast_toktype(tok->toktype) == toktype_operand_register ||
-        downcast_toktype(tok->toktype) == toktype_datadir) {
-        print_tok_error(tok, filedat, "Error, this token is a reserved word.");
-        
-        return false;
+    if (is_reserved_word(tok)) {
+        return "Error, this token is a reserved word.";
     /*length check*/
-    } else if (strlen(tok->tokstr) > MAX_LABEL_LENGTH) {
-        print_tok_error(tok, filedat, "Error, label is too long.");
-        fprintf(stderr, "Max. allowed label length is %d.\n",
-                MAX_LABEL_LENGTH);
-        
-        return false;
+    } else if (!is_ident_length_ok(tok->tokstr)) {
+        return "Error, label is too long.";
     /*label list lookup*/
-    } else if ((label = find_clist_str(last_label, &find_item_label,
+    } else if ((label = find_chash_str(label_table, &find_item_label,
                                        tok->tokstr)) != NULL) {
-        print_tok_error(tok, filedat, "Error, multiple definitions of label.");
-        print_prevdef(label->linenum);
-        
-        return false;
+        *prev_linenum = label->linenum;
+        return "Error, multiple definitions of label.";
     /*extern list lookup*/
     } else if ((p_extern = 
-                find_clist_str(filedat->last_extern, &find_item_extern,
+                find_chash_str(&filedat->extern_table, &find_item_extern,
                                tok->tokstr)) != NULL) {
-        print_tok_error(tok, filedat,
-                        "Error, previously defined as extern.");
-        print_prevdef(p_extern->linenum);
-        return false;
+        *prev_linenum = p_extern->linenum;
+        return "Error, previously defined as extern.";
     }
     
-    return true;
+    return NULL;
+}
+
+/*Returns why tok can't be declared as an entry, or NULL if it can. The
+  line of the previous definition is put into *prev_linenum, and
+  *warning tells if the message is only a warning (the declaration is
+  dropped either way). Nothing is printed, as with get_label_error.*/
+char *get_entry_error(file_data *filedat, token *tok, int *prev_linenum,
+                      bool *warning) {
+    item_entry *p_entry;
+    item_extern *p_extern;
+    
+    *prev_linenum = 0;
+    *warning = false;
+    
+    /*entry list lookup for muldef*/
+    if ((p_entry = find_chash_str(&filedat->entry_table, &find_item_entry,
+                                  tok->tokstr)) != NULL) {
+        *prev_linenum = p_entry->linenum;
+        *warning = true;
+        return "Warning, multiple definitions of entry.";
+    /*extern list lookup*/
+    } else if ((p_extern = find_chash_str(&filedat->extern_table,
+                                          &find_item_extern,
+                                          tok->tokstr)) != NULL) {
+        *prev_linenum = p_extern->linenum;
+        return "Warning, previously defined as extern.";
+    }
+    
+    return NULL;
+}
+
+/*Returns why tok can't be declared as an extern, or NULL if it can. See
+  get_entry_error.*/
+char *get_extern_error(file_data *filedat, token *tok, int *prev_linenum,
+                       bool *warning) {
+    item_label *p_label;
+    item_entry *p_entry;
+    item_extern *p_extern;
+    
+    *prev_linenum = 0;
+    *warning = false;
+    
+    /*extern list lookup for muldef*/
+    if ((p_extern = find_chash_str(&filedat->extern_table, &find_item_extern,
+                                   tok->tokstr)) != NULL) {
+        *prev_linenum = p_extern->linenum;
+        *warning = true;
+        return "Warning, multiple definitions of extern.";
+    /*entry list lookup*/
+    } else if ((p_entry = find_chash_str(&filedat->entry_table,
+                                         &find_item_entry,
+                                         tok->tokstr)) != NULL) {
+        *prev_linenum = p_entry->linenum;
+        return "Error, previously defined as extern.";
+    /*label list lookup*/
+    } else if ((p_label = find_chash_str(&filedat->label_table,
+                                         &find_item_label,
+                                         tok->tokstr)) != NULL) {
+        *prev_linenum = p_label->linenum;
+        return "Error, previously defined as label.";
+    }
+    
+    return NULL;
+}
+
+/*If tok is an operator, a register or a data directive, which can't be
+  used as identifiers.*/
+bool is_reserved_word(token *tok) {
+    return downcast_toktype(tok->toktype) == toktype_operator ||
+           downcast_toktype(tok->toktype) == toktype_operand_register ||
+           downcast_toktype(tok->toktype) == toktype_datadir;
 }
 
 /*Check the boundaries of the passed int num of the type numtype. Boundaries
   are defined as macros.*/
-static bool is_int_within_bounds(int num, numtype num_t) {
+bool is_int_within_bounds(int num, numtype num_t) {
     switch (num_t) {
         case numt_eightbit:
             if (num > EIGHTBIT_MAX ||
@@ -1012,17 +1079,18 @@ static bool is_int_within_bounds(int num, numtype num_t) {
 
 /*Prints the valid addressing modes that are looked up in the passed
   pointer to OPS' relevant table.*/
-static void print_valid_addmodes(const int *valid_modes) {
+static void print_valid_addmodes(file_data *filedat, const int *valid_modes) {
     int i;
+    char modes[MAX_NOTE];
     
-    fprintf(stderr,
-            "Valid addressing modes for this operand are:\n");
-            
+    modes[0] = '\0';
     for (i = 0; i < MAX_ADD_MODES; i++) {
         if (valid_modes[i] == 1) {
-            fprintf(stderr, "%s ", addmode_strings[i]);
+            strcat(modes, addmode_strings[i]);
+            strcat(modes, " ");
         }
     }
     
-    fprintf(stderr, "\n");
+    print_error_note(filedat, "Valid addressing modes for this operand "
+                              "are:\n%s\n", modes);
 }
@@ -6,6 +6,26 @@
 #define TENBIT_MAX 511
 #define TENBIT_MIN (-512)
 
+#define MAX_LABEL_LENGTH 30
+
+/*used to check the limits of integers*/
+typedef enum {
+    numt_eightbit,
+    numt_tenbit
+} numtype;
+
 void *parse_line(line_data *lindat, file_data *filedat);
 
+/*the checks of the parser, for the builder (see builder.c) to make the
+  same ones*/
+bool is_int_within_bounds(int num, numtype num_t);
+bool is_ident_length_ok(char *str);
+bool is_reserved_word(token *tok);
+char *get_label_error(c_hash *label_table, file_data *filedat, token *tok,
+                      int *prev_linenum);
+char *get_entry_error(file_data *filedat, token *tok, int *prev_linenum,
+                      bool *warning);
+char *get_extern_error(file_data *filedat, token *tok, int *prev_linenum,
+                       bool *warning);
+
 #endif /*PARSER_H*/
@@ -0,0 +1,59 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*USDT probes of the provider "assembler", for bpftrace, perf and the
+  like, e.g.:
+  
+    bpftrace -e 'usdt:./assembler:assembler:error { @[arg0] = count(); }'
+  
+  They're compiled in when sys/sdt.h is there (HAVE_SYS_SDT_H, see the
+  Makefile), as a single nop each until something attaches to them.
+  Otherwise they're nothing at all.
+  
+  file_start     filename
+  file_end       filename, errors
+  line_start     line number
+  token          line number, token type
+  statement      line number, statement type (NULL statements aren't)
+  words          line number, machine words emitted for the line
+  symbol_define  name, line number (labels, entries and externs)
+  symbol_resolve name, address (operands, when the address is known)
+  error          line number, errors in the file so far*/
+#ifdef HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define PROBE_FILE_START(name) \
+    DTRACE_PROBE1(assembler, file_start, name)
+#define PROBE_FILE_END(name, errors) \
+    DTRACE_PROBE2(assembler, file_end, name, errors)
+#define PROBE_LINE_START(linenum) \
+    DTRACE_PROBE1(assembler, line_start, linenum)
+#define PROBE_TOKEN(linenum, toktype) \
+    DTRACE_PROBE2(assembler, token, linenum, toktype)
+#define PROBE_STATEMENT(linenum, stype) \
+    DTRACE_PROBE2(assembler, statement, linenum, stype)
+#define PROBE_WORDS(linenum, count) \
+    DTRACE_PROBE2(assembler, words, linenum, count)
+#define PROBE_SYMBOL_DEFINE(name, linenum) \
+    DTRACE_PROBE2(assembler, symbol_define, name, linenum)
+#define PROBE_SYMBOL_RESOLVE(name, address) \
+    DTRACE_PROBE2(assembler, symbol_resolve, name, address)
+#define PROBE_ERROR(linenum, errors) \
+    DTRACE_PROBE2(assembler, error, linenum, errors)
+
+#else
+
+#define PROBE_FILE_START(name)             ((void)0)
+#define PROBE_FILE_END(name, errors)       ((void)0)
+#define PROBE_LINE_START(linenum)          ((void)0)
+#define PROBE_TOKEN(linenum, toktype)      ((void)0)
+#define PROBE_STATEMENT(linenum, stype)    ((void)0)
+#define PROBE_WORDS(linenum, count)        ((void)0)
+#define PROBE_SYMBOL_DEFINE(name, linenum) ((void)0)
+#define PROBE_SYMBOL_RESOLVE(name, address) ((void)0)
+#define PROBE_ERROR(linenum, errors)       ((void)0)
+
+#endif /*HAVE_SYS_SDT_H*/
+
+#endif /*PROBES_H*/
@@ -0,0 +1,753 @@
+/*The relink of modules from the cache of their last link, when only some
+  of them were assembled again since.
+  
+  A link with the cache on keeps what it did in out_name.lnk (see
+  set_link_cache): every module with a stamp of its object files (their
+  sizes and times) and its place in the link, the entries at their linked
+  addresses, every extern operand of the linked code with the name it
+  refers to, and the linked code and data. The next link of the same
+  modules stats their object files, and reads only the ones whose stamp
+  changed. If these have as many code and data words as before, no other
+  module moves, so:
+    the words of a changed module are patched into the cached code as
+    link.c does it, at its cached bases, and its data is copied
+    the entries it had are compared with the ones it has now, and only
+    the extern operands (of the other modules) that refer to an entry
+    that moved are patched again, found by name in the sorted uses
+  which takes the words of the changed modules and the uses of the moved
+  entries, not the whole link. Anything else (a module that grew or
+  shrank, one more or less, an entry of two modules, an undefined one)
+  takes a full link, which reports the errors as it does without the
+  cache.
+  
+  The .lnk file has the numbers as in the binary object (see objfile.c):
+    magic "ALNK", version (16 bits), word size (16 bits), flags (32 bits)
+    module count, entry count, use count, code count, data count
+                                                       (32 bits each)
+    the modules: stamp (64 bits, the low half first), code count, data
+                 count, entry count (32 bits each), name length (16
+                 bits), the name (no terminator)
+    the entries, then the uses, as the symbols of the binary object
+    the code, then the data, each packed and padded like the code of the
+    binary object*/
+
+#define _POSIX_C_SOURCE 200809L /*for st_mtim, and the threads of link.h*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "token.h"
+#include "clist.h"
+#include "statement.h"
+#include "filedata.h"
+#include "wordimg.h"
+#include "assm.h"
+#include "objfile.h"
+#include "link.h"
+#include "relink.h"
+
+#define LNK_MAGIC "ALNK"
+#define LNK_MAGIC_LENGTH 4
+#define LNK_VERSION 1
+#define LNK_BIN     0x01 /*flag, the modules are read from .obj*/
+#define LNK_MEM_CAP 0x02 /*flag, the link has to fit in the machine*/
+#define STAMP_FACTOR 1000003UL /*a prime, for the stamp to mix*/
+#define MIN_MODULE_BYTES 22 /*of a module in the file, with an empty name*/
+#define MIN_SYMBOL_BYTES 6  /*of an entry or a use, with an empty name*/
+
+    /*a module that changed since the cached link*/
+    typedef struct changed_module {
+        unsigned int index;      /*of the module*/
+        unsigned long stamp;     /*of now*/
+        link_module mod;         /*as read now, at the cached bases*/
+    } changed_module;
+    
+    /*the state of a relink*/
+    typedef struct relink_t {
+        changed_module *changed; /*in the order of the modules*/
+        unsigned int changed_count;
+        c_hash entries;          /*of the cache, by name*/
+    } relink_t;
+
+static int load_changed_module(link_cache *cache, changed_module *cm);
+static bool relink_entries(link_cache *cache, relink_t *rl);
+static bool repatch_uses(link_cache *cache, relink_t *rl, char *name,
+                         obj_symbol *p_entry);
+static bool patch_changed_modules(link_cache *cache, relink_t *rl);
+static void update_uses(link_cache *cache, relink_t *rl);
+static changed_module *find_changed_module(relink_t *rl,
+                                           unsigned int address);
+
+static void alloc_link_cache(link_cache *cache);
+static bool set_cache_layout(link_cache *cache, unsigned int code_count,
+                             unsigned int data_count);
+static void set_cached_name(cached_module *cmod, const char *name,
+                            size_t length);
+static bool get_cached_modules(link_cache *cache, FILE *f_in);
+static unsigned long get_module_stamp(char *name, bool bin);
+static int cmp_use(const void *a, const void *b);
+
+/*An empty cache, of no link.*/
+void init_link_cache(link_cache *cache) {
+    cache->bin          = false;
+    cache->mem_cap      = true;
+    cache->modules      = NULL;
+    cache->module_count = 0;
+    cache->entries      = NULL;
+    cache->entry_count  = 0;
+    cache->uses         = NULL;
+    cache->use_count    = 0;
+    init_word_image(&cache->code);
+    init_word_image(&cache->data);
+}
+
+/*Sets cache (which is empty) to the link of lnk into out, which had no
+  errors. The modules were read from .obj if bin is set.*/
+void set_link_cache(link_cache *cache, link_t *lnk, obj_image *out,
+                    bool bin) {
+    unsigned int i, j;
+    unsigned int use = 0;
+    link_module *mod;
+    cached_module *cmod;
+    
+    cache->bin          = bin;
+    cache->mem_cap      = lnk->mem_cap;
+    cache->module_count = lnk->module_count;
+    cache->entry_count  = out->entry_count;
+    for (i = 0; i < lnk->module_count; i++) {
+        cache->use_count += lnk->modules[i].img.extern_count;
+    }
+    alloc_link_cache(cache);
+    
+    for (i = 0; i < lnk->module_count; i++) {
+        mod  = &lnk->modules[i];
+        cmod = &cache->modules[i];
+        set_cached_name(cmod, mod->name, strlen(mod->name));
+        cmod->stamp       = get_module_stamp(mod->name, bin);
+        cmod->code_count  = mod->img.code.count;
+        cmod->data_count  = mod->img.data.count;
+        cmod->entry_count = mod->img.entry_count;
+        
+        for (j = 0; j < mod->img.extern_count; j++) {
+            set_obj_symbol(&cache->uses[use++], mod->code_base +
+                           mod->img.externs[j].address - mod->img.base,
+                           mod->img.externs[j].name,
+                           strlen(mod->img.externs[j].name));
+        }
+    }
+    qsort(cache->uses, cache->use_count, sizeof(obj_symbol), &cmp_use);
+    
+    for (i = 0; i < out->entry_count; i++) {
+        set_obj_symbol(&cache->entries[i], out->entries[i].address,
+                       out->entries[i].name, strlen(out->entries[i].name));
+    }
+    
+    copy_word_image(&cache->code, &out->code);
+    append_data_words(&cache->data, &out->data);
+    set_cache_layout(cache, cache->code.count, cache->data.count);
+}
+
+/*Reads cache from filename.lnk. Returns false if there's none, or it
+  isn't a link cache of this version, cache is empty then.*/
+bool read_link_cache(link_cache *cache, char *filename) {
+    char magic[LNK_MAGIC_LENGTH];
+    char fname_buf[MAX_FILE_LENGTH];
+    unsigned int version, word_size, flags;
+    unsigned int module_count, entry_count, use_count;
+    unsigned int code_count, data_count;
+    bool read_ok;
+    FILE *f_in = open_obj_file(fname_buf, filename, EXTENSION_LNK, "rb");
+    
+    init_link_cache(cache);
+    if (f_in == NULL) {
+        return false;
+    }
+    
+    read_ok = fread(magic, 1, LNK_MAGIC_LENGTH, f_in) == LNK_MAGIC_LENGTH &&
+              memcmp(magic, LNK_MAGIC, LNK_MAGIC_LENGTH) == 0 &&
+              get_u16(f_in, &version) && version == LNK_VERSION &&
+              get_u16(f_in, &word_size) && word_size == WORD_BITS &&
+              get_u32(f_in, &flags) && get_u32(f_in, &module_count) &&
+              get_u32(f_in, &entry_count) && get_u32(f_in, &use_count) &&
+              get_u32(f_in, &code_count) && get_u32(f_in, &data_count);
+    
+    /*not more than what's left of the file could fill*/
+    read_ok = read_ok &&
+              module_count <= get_bytes_left(f_in)/MIN_MODULE_BYTES &&
+              entry_count <= get_bytes_left(f_in)/MIN_SYMBOL_BYTES &&
+              use_count <= get_bytes_left(f_in)/MIN_SYMBOL_BYTES - entry_count;
+    
+    if (read_ok) {
+        cache->bin          = (flags & LNK_BIN) != 0;
+        cache->mem_cap      = (flags & LNK_MEM_CAP) != 0;
+        cache->module_count = module_count;
+        cache->entry_count  = entry_count;
+        cache->use_count    = use_count;
+        alloc_link_cache(cache);
+        
+        read_ok = get_cached_modules(cache, f_in) &&
+                  set_cache_layout(cache, code_count, data_count) &&
+                  get_bin_symbols(cache->entries, entry_count, f_in) &&
+                  get_bin_symbols(cache->uses, use_count, f_in) &&
+                  get_packed_words(&cache->code, code_count, f_in) &&
+                  get_packed_words(&cache->data, data_count, f_in);
+    }
+    
+    fclose(f_in);
+    if (!read_ok) {
+        destroy_link_cache(cache);
+    }
+    
+    return read_ok;
+}
+
+void write_link_cache(link_cache *cache, char *filename) {
+    unsigned int i;
+    size_t length;
+    char fname_buf[MAX_FILE_LENGTH];
+    cached_module *cmod;
+    FILE *f_out = open_obj_file(fname_buf, filename, EXTENSION_LNK, "wb");
+    
+    fwrite(LNK_MAGIC, 1, LNK_MAGIC_LENGTH, f_out);
+    put_u16(LNK_VERSION, f_out);
+    put_u16(WORD_BITS, f_out);
+    put_u32((cache->bin ? LNK_BIN : 0) | (cache->mem_cap ? LNK_MEM_CAP : 0),
+            f_out);
+    put_u32(cache->module_count, f_out);
+    put_u32(cache->entry_count, f_out);
+    put_u32(cache->use_count, f_out);
+    put_u32(cache->code.count, f_out);
+    put_u32(cache->data.count, f_out);
+    
+    for (i = 0; i < cache->module_count; i++) {
+        cmod   = &cache->modules[i];
+        length = strlen(cmod->name);
+        put_u32(cmod->stamp & 0xFFFFFFFFUL, f_out);
+        put_u32(cmod->stamp >> 16 >> 16, f_out); /*in two, for a 32 bit long*/
+        put_u32(cmod->code_count, f_out);
+        put_u32(cmod->data_count, f_out);
+        put_u32(cmod->entry_count, f_out);
+        put_u16(length, f_out);
+        fwrite(cmod->name, 1, length, f_out);
+    }
+    
+    put_bin_symbols(cache->entries, cache->entry_count, f_out);
+    put_bin_symbols(cache->uses, cache->use_count, f_out);
+    put_packed_words(&cache->code, f_out);
+    put_packed_words(&cache->data, f_out);
+    
+    fclose(f_out);
+}
+
+/*Relinks the modules of names from cache, the link of the same modules
+  (module i from names[i]), reading only the ones that changed since,
+  their count goes in changed_count. Returns RELINK_DONE if cache is the
+  new link, RELINK_FULL if it takes a full link (cache is of no use then,
+  it's set again after it), RELINK_FAILED if a module can't be read.*/
+int relink_modules(link_cache *cache, char **names,
+                   unsigned int module_count, unsigned int *changed_count) {
+    unsigned int i;
+    unsigned long stamp;
+    int status = RELINK_DONE;
+    relink_t rl;
+    
+    *changed_count = 0;
+    if (module_count != cache->module_count) {
+        return RELINK_FULL;
+    }
+    for (i = 0; i < module_count; i++) {
+        if (strcmp(names[i], cache->modules[i].name) != 0) {
+            return RELINK_FULL;
+        }
+    }
+    
+    rl.changed = mem_alloc(sizeof(changed_module)*(module_count+1),
+                           mem_output);
+    if (rl.changed == NULL) {
+        fprintf(stderr, "Malloc failure in relink_modules.");
+        exit(1);
+    }
+    rl.changed_count = 0;
+    init_chash(&rl.entries, &get_obj_symbol_name);
+    
+    for (i = 0; i < module_count; i++) {
+        stamp = get_module_stamp(names[i], cache->bin);
+        if (stamp != cache->modules[i].stamp) {
+            rl.changed[rl.changed_count].index = i;
+            rl.changed[rl.changed_count].stamp = stamp;
+            init_obj_image(&rl.changed[rl.changed_count].mod.img, IC_INIT,
+                           0, 0);
+            rl.changed_count++;
+        }
+    }
+    
+    for (i = 0; i < rl.changed_count && status == RELINK_DONE; i++) {
+        status = load_changed_module(cache, &rl.changed[i]);
+    }
+    
+    if (status == RELINK_DONE && rl.changed_count > 0) {
+        if (relink_entries(cache, &rl) && patch_changed_modules(cache, &rl)) {
+            update_uses(cache, &rl);
+        } else {
+            status = RELINK_FULL;
+        }
+    }
+    
+    for (i = 0; i < rl.changed_count; i++) {
+        if (status == RELINK_DONE) {
+            cache->modules[rl.changed[i].index].stamp = rl.changed[i].stamp;
+        }
+        destroy_obj_image(&rl.changed[i].mod.img);
+    }
+    
+    *changed_count = rl.changed_count;
+    destroy_chash(&rl.entries);
+    mem_free(rl.changed);
+    
+    return status;
+}
+
+/*Sets out (which is initialized by the call) to the link of cache.*/
+void get_link_cache_image(link_cache *cache, obj_image *out) {
+    unsigned int i;
+    
+    init_obj_image(out, IC_INIT, cache->entry_count, 0);
+    copy_word_image(&out->code, &cache->code);
+    for (i = 0; i < cache->data.count; i++) {
+        append_data_run(&out->data, get_word(&cache->data, i), 1);
+    }
+    
+    for (i = 0; i < cache->entry_count; i++) {
+        set_obj_symbol(&out->entries[i], cache->entries[i].address,
+                       cache->entries[i].name,
+                       strlen(cache->entries[i].name));
+    }
+}
+
+/*Frees the cache, which is empty after.*/
+void destroy_link_cache(link_cache *cache) {
+    unsigned int i;
+    
+    if (cache->modules != NULL) {
+        for (i = 0; i < cache->module_count; i++) {
+            mem_free(cache->modules[i].name);
+        }
+        for (i = 0; i < cache->entry_count; i++) {
+            mem_free(cache->entries[i].name);
+        }
+        for (i = 0; i < cache->use_count; i++) {
+            mem_free(cache->uses[i].name);
+        }
+    }
+    
+    mem_free(cache->modules);
+    mem_free(cache->entries);
+    mem_free(cache->uses);
+    destroy_word_image(&cache->code);
+    destroy_word_image(&cache->data);
+    init_link_cache(cache);
+}
+
+/*Reads the changed module cm, at the bases the cache has for it. It
+  takes a full link if it's of more or less words than it was.*/
+static int load_changed_module(link_cache *cache, changed_module *cm) {
+    cached_module *cmod = &cache->modules[cm->index];
+    link_module *mod = &cm->mod;
+    bool read_ok;
+    
+    destroy_obj_image(&mod->img);
+    read_ok = cache->bin ? read_obj_bin(&mod->img, cmod->name) :
+                           read_obj_text(&mod->img, cmod->name);
+    if (!read_ok) {
+        return RELINK_FAILED;
+    }
+    
+    mod->name         = cmod->name;
+    mod->code_base    = cmod->code_base;
+    mod->data_base    = cmod->data_base;
+    mod->first_symbol = cmod->first_entry;
+    
+    return mod->img.code.count == cmod->code_count &&
+           mod->img.data.count == cmod->data_count ? RELINK_DONE :
+                                                     RELINK_FULL;
+}
+
+/*Puts the entries of the changed modules in the place of the ones they
+  had, and patches the uses of those that moved or are gone. Returns
+  false if it takes a full link: an entry of two modules, or one that's
+  gone and still used.*/
+static bool relink_entries(link_cache *cache, relink_t *rl) {
+    unsigned int i, j, k;
+    unsigned int count = cache->entry_count;
+    bool relinked = true;
+    obj_symbol *old = cache->entries;
+    obj_symbol *p_entry;
+    obj_symbol *p_found;
+    cached_module *cmod;
+    link_module *mod;
+    
+    for (i = 0; i < rl->changed_count; i++) {
+        count -= cache->modules[rl->changed[i].index].entry_count;
+        count += rl->changed[i].mod.img.entry_count;
+    }
+    
+    cache->entries = mem_alloc(sizeof(obj_symbol)*(count+1), mem_output);
+    if (cache->entries == NULL) {
+        fprintf(stderr, "Malloc failure in relink_entries.");
+        exit(1);
+    }
+    
+    /*the new entries, module by module, the old ones are moved over*/
+    for (i = 0, j = 0, k = 0; i < cache->module_count; i++) {
+        cmod = &cache->modules[i];
+        if (k < rl->changed_count && rl->changed[k].index == i) {
+            mod = &rl->changed[k++].mod;
+            for (p_entry = mod->img.entries;
+                 p_entry < &mod->img.entries[mod->img.entry_count];
+                 p_entry++) {
+                set_obj_symbol(&cache->entries[j++],
+                               get_linked_address(mod, p_entry->address),
+                               p_entry->name, strlen(p_entry->name));
+            }
+        } else {
+            memcpy(&cache->entries[j], &old[cmod->first_entry],
+                   sizeof(obj_symbol)*cmod->entry_count);
+            j += cmod->entry_count;
+        }
+    }
+    cache->entry_count = count;
+    
+    for (i = 0; i < count && relinked; i++) {
+        if (find_chash_str(&rl->entries, &find_obj_symbol,
+                           cache->entries[i].name) != NULL) {
+            relinked = false;
+        } else {
+            add_chash(&rl->entries, &cache->entries[i]);
+        }
+    }
+    
+    /*the old entries of the changed modules, which go*/
+    for (i = 0; i < rl->changed_count; i++) {
+        cmod = &cache->modules[rl->changed[i].index];
+        for (p_entry = &old[cmod->first_entry];
+             p_entry < &old[cmod->first_entry + cmod->entry_count];
+             p_entry++) {
+            if (relinked) {
+                p_found = find_chash_str(&rl->entries, &find_obj_symbol,
+                                         p_entry->name);
+                if (p_found == NULL || p_found->address != p_entry->address) {
+                    relinked = repatch_uses(cache, rl, p_entry->name,
+                                            p_found);
+                }
+            }
+            mem_free(p_entry->name);
+        }
+        cmod->entry_count = rl->changed[i].mod.img.entry_count;
+    }
+    mem_free(old);
+    
+    for (i = 0, j = 0; i < cache->module_count; i++) {
+        cache->modules[i].first_entry = j;
+        j += cache->modules[i].entry_count;
+    }
+    
+    return relinked;
+}
+
+/*Patches the uses of name by the modules that didn't change with its
+  entry now, p_entry. Returns false if it's used and there's none, or
+  it's past the machine memory.*/
+static bool repatch_uses(link_cache *cache, relink_t *rl, char *name,
+                         obj_symbol *p_entry) {
+    unsigned int low = 0;
+    unsigned int high = cache->use_count;
+    unsigned int mid;
+    obj_symbol *p_use;
+    
+    /*the first use of name, they're by name*/
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (strcmp(cache->uses[mid].name, name) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    for (p_use = &cache->uses[low];
+         p_use < &cache->uses[cache->use_count] &&
+         strcmp(p_use->name, name) == 0; p_use++) {
+        if (find_changed_module(rl, p_use->address) != NULL) {
+            continue; /*patched with its module*/
+        } else if (p_entry == NULL || p_entry->address >= MAX_MACHINE_MEM) {
+            return false;
+        }
+        
+        set_word(&cache->code, p_use->address - IC_INIT,
+                 (p_entry->address << SHIFT_8BIT) + ARE_RELOC);
+    }
+    
+    return true;
+}
+
+/*Patches the words of the changed modules into the cached code as
+  patch_link_range does, and copies their data. Returns false if it
+  takes a full link: an extern that isn't at an extern operand, or isn't
+  an entry of any module, or an address past the machine memory.*/
+static bool patch_changed_modules(link_cache *cache, relink_t *rl) {
+    unsigned int i, j;
+    unsigned int word;
+    unsigned int address;
+    unsigned int offset;  /*of the code of the module, in the link*/
+    unsigned int data_offset;
+    link_module *mod;
+    obj_symbol *p_extern;
+    obj_symbol *p_entry;
+    
+    for (i = 0; i < rl->changed_count; i++) {
+        mod    = &rl->changed[i].mod;
+        offset = mod->code_base - IC_INIT;
+        for (j = 0; j < mod->img.code.count; j++) {
+            word = get_word(&mod->img.code, j);
+            if ((word & ARE_MASK) == ARE_RELOC) {
+                address = get_linked_address(mod, word >> SHIFT_8BIT);
+                if (address >= MAX_MACHINE_MEM) {
+                    return false;
+                }
+                word = (address << SHIFT_8BIT) + ARE_RELOC;
+            }
+            
+            set_word(&cache->code, offset + j, word);
+        }
+        
+        for (j = 0; j < mod->img.extern_count; j++) {
+            p_extern = &mod->img.externs[j];
+            p_entry  = find_chash_str(&rl->entries, &find_obj_symbol,
+                                      p_extern->name);
+            if (p_extern->address < mod->img.base ||
+                p_extern->address - mod->img.base >= mod->img.code.count ||
+                (get_word(&mod->img.code, p_extern->address - mod->img.base)
+                 & ARE_MASK) != ARE_EXTERN || p_entry == NULL ||
+                p_entry->address >= MAX_MACHINE_MEM) {
+                return false;
+            }
+            
+            set_word(&cache->code, offset + p_extern->address - mod->img.base,
+                     (p_entry->address << SHIFT_8BIT) + ARE_RELOC);
+        }
+        
+        data_offset = mod->data_base - IC_INIT - cache->code.count;
+        for (j = 0; j < mod->img.data.count; j++) {
+            set_word(&cache->data, data_offset + j,
+                     get_data_word(&mod->img.data, j));
+        }
+    }
+    
+    return true;
+}
+
+/*Puts the extern operands of the changed modules in the place of the
+  ones they had. The ones kept are still sorted, so only the new ones
+  are sorted, and merged with them.*/
+static void update_uses(link_cache *cache, relink_t *rl) {
+    unsigned int i, j;
+    unsigned int kept = 0;
+    unsigned int count;
+    obj_symbol *uses;    /*the kept ones, then the new ones*/
+    obj_symbol *merged;
+    link_module *mod;
+    
+    count = cache->use_count;
+    for (i = 0; i < rl->changed_count; i++) {
+        count += rl->changed[i].mod.img.extern_count;
+    }
+    
+    uses   = mem_alloc(sizeof(obj_symbol)*(count+1), mem_output);
+    merged = mem_alloc(sizeof(obj_symbol)*(count+1), mem_output);
+    if (uses == NULL || merged == NULL) {
+        fprintf(stderr, "Malloc failure in update_uses.");
+        exit(1);
+    }
+    
+    for (i = 0; i < cache->use_count; i++) {
+        if (find_changed_module(rl, cache->uses[i].address) == NULL) {
+            uses[kept++] = cache->uses[i];
+        } else {
+            mem_free(cache->uses[i].name);
+        }
+    }
+    
+    count = kept;
+    for (i = 0; i < rl->changed_count; i++) {
+        mod = &rl->changed[i].mod;
+        for (j = 0; j < mod->img.extern_count; j++) {
+            set_obj_symbol(&uses[count++], mod->code_base +
+                           mod->img.externs[j].address - mod->img.base,
+                           mod->img.externs[j].name,
+                           strlen(mod->img.externs[j].name));
+        }
+    }
+    qsort(&uses[kept], count - kept, sizeof(obj_symbol), &cmp_use);
+    
+    for (i = 0, j = kept; i < kept || j < count; ) {
+        if (j == count || (i < kept && cmp_use(&uses[i], &uses[j]) <= 0)) {
+            merged[i + j - kept] = uses[i];
+            i++;
+        } else {
+            merged[i + j - kept] = uses[j];
+            j++;
+        }
+    }
+    
+    mem_free(uses);
+    mem_free(cache->uses);
+    cache->uses      = merged;
+    cache->use_count = count;
+}
+
+/*Returns the changed module with the code word at (linked) address, NULL
+  if it's of one that didn't change.*/
+static changed_module *find_changed_module(relink_t *rl,
+                                           unsigned int address) {
+    int low = 0;
+    int high = (int)rl->changed_count - 1;
+    int mid;
+    changed_module *p_found = NULL; /*the last that starts up to address*/
+    
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (rl->changed[mid].mod.code_base <= address) {
+            p_found = &rl->changed[mid];
+            low     = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    
+    return p_found != NULL && address - p_found->mod.code_base <
+                              p_found->mod.img.code.count ? p_found : NULL;
+}
+
+/*Allocates the tables of cache for its counts, with no names yet.*/
+static void alloc_link_cache(link_cache *cache) {
+    cache->modules = mem_alloc(sizeof(cached_module)*
+                               (cache->module_count+1), mem_output);
+    cache->entries = mem_alloc(sizeof(obj_symbol)*(cache->entry_count+1),
+                               mem_output);
+    cache->uses    = mem_alloc(sizeof(obj_symbol)*(cache->use_count+1),
+                               mem_output);
+    if (cache->modules == NULL || cache->entries == NULL ||
+        cache->uses == NULL) {
+        fprintf(stderr, "Malloc failure in alloc_link_cache.");
+        exit(1);
+    }
+    
+    memset(cache->modules, 0, sizeof(cached_module)*cache->module_count);
+    memset(cache->entries, 0, sizeof(obj_symbol)*cache->entry_count);
+    memset(cache->uses, 0, sizeof(obj_symbol)*cache->use_count);
+}
+
+/*Sets the bases of the modules from their counts, as layout_link does.
+  Returns false if they don't add up to the counts of the cache.*/
+static bool set_cache_layout(link_cache *cache, unsigned int code_count,
+                             unsigned int data_count) {
+    unsigned int i;
+    unsigned int address = IC_INIT;
+    unsigned int entry_count = 0;
+    cached_module *cmod;
+    
+    for (i = 0; i < cache->module_count; i++) {
+        cmod = &cache->modules[i];
+        cmod->code_base   = address;
+        cmod->first_entry = entry_count;
+        address     += cmod->code_count;
+        entry_count += cmod->entry_count;
+    }
+    
+    for (i = 0; i < cache->module_count; i++) {
+        cmod = &cache->modules[i];
+        cmod->data_base = address;
+        address += cmod->data_count;
+    }
+    
+    return entry_count == cache->entry_count &&
+           address == IC_INIT + code_count + data_count;
+}
+
+static void set_cached_name(cached_module *cmod, const char *name,
+                            size_t length) {
+    cmod->name = mem_alloc(length+1, mem_output);
+    if (cmod->name == NULL) {
+        fprintf(stderr, "Malloc failure in set_cached_name.");
+        exit(1);
+    }
+    memcpy(cmod->name, name, length);
+    cmod->name[length] = '\0';
+}
+
+static bool get_cached_modules(link_cache *cache, FILE *f_in) {
+    unsigned int i;
+    unsigned int low, high, length;
+    char name[MAX_FILE_LENGTH];
+    cached_module *cmod;
+    
+    for (i = 0; i < cache->module_count; i++) {
+        cmod = &cache->modules[i];
+        if (!get_u32(f_in, &low) || !get_u32(f_in, &high) ||
+            !get_u32(f_in, &cmod->code_count) ||
+            !get_u32(f_in, &cmod->data_count) ||
+            !get_u32(f_in, &cmod->entry_count) ||
+            !get_u16(f_in, &length) || length >= MAX_FILE_LENGTH ||
+            fread(name, 1, length, f_in) != length) {
+            return false;
+        }
+        
+        cmod->stamp = (unsigned long)high << 16 << 16 | low;
+        set_cached_name(cmod, name, length);
+    }
+    
+    return true;
+}
+
+/*Returns a stamp of the object files of name, which changes when any of
+  them is written (or made, or removed).*/
+static unsigned long get_module_stamp(char *name, bool bin) {
+    static char *text_ext[] = {EXTENSION_OB, EXTENSION_ENT, EXTENSION_EXT};
+    int i;
+    unsigned long stamp = 0;
+    char fname_buf[MAX_FILE_LENGTH];
+    struct stat st;
+    
+    for (i = 0; i < (bin ? 1 : 3); i++) {
+        sprintf(fname_buf, "%s%s", name, bin ? EXTENSION_OBJ : text_ext[i]);
+        if (stat(fname_buf, &st) != 0) {
+            stamp = stamp * STAMP_FACTOR + 1;
+            continue;
+        }
+        
+        stamp = stamp * STAMP_FACTOR + (unsigned long)st.st_size;
+        stamp = stamp * STAMP_FACTOR + (unsigned long)st.st_mtim.tv_sec;
+        stamp = stamp * STAMP_FACTOR + (unsigned long)st.st_mtim.tv_nsec;
+    }
+    
+    return stamp;
+}
+
+/*By name, then by address.*/
+static int cmp_use(const void *a, const void *b) {
+    const obj_symbol *use_a = a;
+    const obj_symbol *use_b = b;
+    int cmp = strcmp(use_a->name, use_b->name);
+    
+    if (cmp != 0) {
+        return cmp;
+    }
+    
+    return use_a->address < use_b->address ? -1 :
+           use_a->address > use_b->address;
+}
@@ -0,0 +1,51 @@
+#ifndef RELINK_H
+#define RELINK_H
+
+#define EXTENSION_LNK ".lnk" /*the link cache, of the linked object*/
+
+/*what relink_modules did*/
+#define RELINK_DONE   0 /*the cache is the link of the modules now*/
+#define RELINK_FULL   1 /*it takes a full link, the cache is of no use*/
+#define RELINK_FAILED 2 /*a module can't be read (printed)*/
+
+    /*a module as the cached link has it*/
+    typedef struct cached_module {
+        char *name;
+        unsigned long stamp;      /*of its object files*/
+        unsigned int code_count;  /*words*/
+        unsigned int data_count;
+        unsigned int code_base;   /*as in link_module*/
+        unsigned int data_base;
+        unsigned int first_entry; /*of its entries, in the cache's*/
+        unsigned int entry_count;
+    } cached_module;
+
+/*What a link keeps for the next one of the same modules (out_name.lnk):
+  the layout of the modules, their entries and extern operands at the
+  linked addresses, and the linked words. See relink.c.*/
+typedef struct link_cache {
+    bool bin;                 /*the modules are read from .obj*/
+    bool mem_cap;
+    cached_module *modules;
+    unsigned int module_count;
+    
+    obj_symbol *entries;      /*in the order of the modules*/
+    unsigned int entry_count;
+    obj_symbol *uses;         /*the extern operands, by name then address*/
+    unsigned int use_count;
+    
+    word_image code;          /*linked, from IC_INIT*/
+    word_image data;          /*linked, right after the code*/
+} link_cache;
+
+void init_link_cache(link_cache *cache);
+void set_link_cache(link_cache *cache, link_t *lnk, obj_image *out,
+                    bool bin);
+bool read_link_cache(link_cache *cache, char *filename);
+void write_link_cache(link_cache *cache, char *filename);
+int relink_modules(link_cache *cache, char **names,
+                   unsigned int module_count, unsigned int *changed_count);
+void get_link_cache_image(link_cache *cache, obj_image *out);
+void destroy_link_cache(link_cache *cache);
+
+#endif /*RELINK_H*/
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "clist.h"
 #include "token.h"
 #include "statement.h"
@@ -13,7 +14,7 @@
 /*Creates a new operand_t.*/
 operand_t *create_operand(int starting_index, int length,
                           add_mode addmode, operand_data *data) {
-    operand_t *newoper = malloc(sizeof(operand_t));
+    operand_t *newoper = mem_alloc(sizeof(operand_t), mem_parser);
     if (newoper == NULL) {
         fprintf(stderr, "Malloc failure");
         exit(1);
@@ -29,7 +30,7 @@ operand_t *create_operand(int starting_index, int length,
 
 /*Creates a new stat_instr_t.*/
 stat_instr_t *create_stat_inst(int opcode, operand_t *src, operand_t *dst) {
-    stat_instr_t *new_statinst = malloc(sizeof(stat_instr_t));
+    stat_instr_t *new_statinst = mem_alloc(sizeof(stat_instr_t), mem_parser);
     if (new_statinst == NULL) {
         puts("Error, malloc failure in get_stat: "
              "instr_statement");
@@ -45,7 +46,7 @@ stat_instr_t *create_stat_inst(int opcode, operand_t *src, operand_t *dst) {
 
 /*Creates a new stat_ddir_t.*/
 stat_ddir_t *create_stat_ddir(data_dir datadir, void *data) {
-    stat_ddir_t *new_statddir = malloc(sizeof(stat_ddir_t));
+    stat_ddir_t *new_statddir = mem_alloc(sizeof(stat_ddir_t), mem_parser);
     if (new_statddir == NULL) {
         fprintf(stderr, "Error, malloc failure in create_stat_ddir.");
         exit(1);
@@ -59,7 +60,8 @@ stat_ddir_t *create_stat_ddir(data_dir datadir, void *data) {
 
 /*Creates a new ddir_struct_t.*/
 ddir_struct_t *create_ddir_struct(int num, char *string) {
-    ddir_struct_t *new_structddir = malloc(sizeof(ddir_struct_t));
+    ddir_struct_t *new_structddir = mem_alloc(sizeof(ddir_struct_t),
+                                              mem_parser);
     if (new_structddir == NULL) {
         fprintf(stderr, "Error, malloc failure in create_ddir_struct.");
         exit(1);
@@ -73,7 +75,7 @@ ddir_struct_t *create_ddir_struct(int num, char *string) {
 
 /*Creates a new ddir_data_t.*/
 ddir_data_t *create_ddir_data(int num_of_items, c_list *last_data) {
-    ddir_data_t *new_data = malloc(sizeof(ddir_data_t));
+    ddir_data_t *new_data = mem_alloc(sizeof(ddir_data_t), mem_parser);
     if (new_data == NULL) {
         fprintf(stderr, "Error, malloc failure in create_ddir_data.");
         exit(1);
@@ -90,11 +92,11 @@ void destroy_operand(operand_t *operand) {
     /*no freeing of tokens*/
     if (operand != NULL) {
         if (operand->addmode == addmode_struct) {
-            free(operand->data->structure);
+            mem_free(operand->data->structure);
         }
         
-        free(operand->data);
-        free(operand);
+        mem_free(operand->data);
+        mem_free(operand);
     }
 }
 
@@ -113,15 +115,18 @@ void destroy_statement(void *stat, stat_type stype) {
             p_ddir = (stat_ddir_t*)stat;
             
             if (p_ddir->datadir == datadir_data) {
-                free(p_ddir->data);
+                /*the numbers are copied into the data image*/
+                destroy_clist(&((ddir_data_t*)p_ddir->data)->last_data,
+                              &mem_free);
+                mem_free(p_ddir->data);
             } else if (p_ddir->datadir == datadir_struct) {
-                free((ddir_struct_t*)p_ddir->data);
+                mem_free((ddir_struct_t*)p_ddir->data);
             } else if (p_ddir->datadir == datadir_string) {
-                free(p_ddir->data);
+                mem_free(p_ddir->data);
             }
         }
         
-        free(stat);
+        mem_free(stat);
     }
 }
 
@@ -0,0 +1,225 @@
+/*Per phase timing and throughput, printed with --stats. Wall time comes
+  from the monotonic clock, CPU time from clock(). Every file is reported
+  on its own, and the whole batch once at the end.
+  
+  --metrics-json writes the same numbers for the dashboards, one JSON
+  record per file and line (see write_file_metrics).*/
+
+#define _POSIX_C_SOURCE 199309L /*for clock_gettime*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "clist.h"
+#include "json.h"
+#include "stats.h"
+
+/*times are in seconds*/
+typedef struct run_stats {
+    double wall[MAX_PHASES];
+    double cpu[MAX_PHASES];
+    long lines;
+    long tokens;
+    long words; /*machine words emitted*/
+    int files;
+} run_stats;
+
+static double get_wall_time(void);
+static void add_run_stats(run_stats *to, run_stats *from);
+static void print_run_stats(run_stats *stats);
+static void print_rate(char *name, long count, double time);
+
+bool STATS = false;
+bool METRICS = false;
+
+static FILE *f_metrics;
+
+static run_stats file_stats;  /*of the current file*/
+static run_stats batch_stats; /*of the files done so far*/
+
+/*when the phases began*/
+static double wall_begin[MAX_PHASES];
+static clock_t cpu_begin[MAX_PHASES];
+
+static const char *phase_names[MAX_PHASES] = {
+    "reading",
+    "tokenize_line",
+    "parse_line",
+    "assemble_line",
+    "apply_IC_offset",
+    "second_pass",
+    "output_machine_code"
+};
+
+/*Starts timing the phase.*/
+void stats_begin(stat_phase phase) {
+    wall_begin[phase] = get_wall_time();
+    cpu_begin[phase]  = clock();
+}
+
+/*Adds the time since stats_begin to the phase.*/
+void stats_end(stat_phase phase) {
+    file_stats.wall[phase] += get_wall_time() - wall_begin[phase];
+    file_stats.cpu[phase]  += (double)(clock() - cpu_begin[phase]) /
+                              CLOCKS_PER_SEC;
+}
+
+/*Counts the tokens of the line.*/
+void stats_add_tokens(c_list *last_token) {
+    c_list *cur_node;
+    
+    if (last_token == NULL) {
+        return;
+    }
+    
+    cur_node = last_token;
+    do {
+        file_stats.tokens++;
+        cur_node = cur_node->next;
+    } while (cur_node != last_token);
+}
+
+/*Ends the stats of the current file, printing them if print is set, and
+  adds them to the batch.*/
+void end_file_stats(int lines, int words, bool print) {
+    file_stats.lines = lines;
+    file_stats.words = words;
+    file_stats.files = 1;
+    
+    if (print) {
+        puts("\nStats:");
+        print_run_stats(&file_stats);
+    }
+    
+    add_run_stats(&batch_stats, &file_stats);
+}
+
+/*Prints the stats of all the files so far.*/
+void print_batch_stats(void) {
+    if (batch_stats.files == 0) {
+        return;
+    }
+    
+    printf("\n\nBatch stats (%d files):\n", batch_stats.files);
+    print_run_stats(&batch_stats);
+}
+
+/*Opens the file of the metrics records. Returns false if it can't be
+  written.*/
+bool open_metrics(const char *filename) {
+    f_metrics = fopen(filename, "w");
+    if (f_metrics == NULL) {
+        fprintf(stderr, "Error, can't write the metrics: %s\n", filename);
+        return false;
+    }
+    
+    METRICS = true;
+    
+    return true;
+}
+
+/*Closes the file of the metrics records.*/
+void close_metrics(void) {
+    if (!METRICS) {
+        return;
+    }
+    
+    fclose(f_metrics);
+    METRICS = false;
+}
+
+/*Writes the record of the current file, before end_file_stats:
+  {"file": ..., "lines": ..., "tokens": ..., "IC": ..., "DC": ...,
+   "code_words": ..., "data_words": ..., "labels": ..., "entries": ...,
+   "externs": ..., "errors": ..., "phases_us": {"reading": ..., ...},
+   "total_us": ..., "peak_heap_bytes": ...}
+  The times are wall times.*/
+void write_file_metrics(file_metrics *metrics) {
+    int i;
+    double total_wall = 0;
+    
+    fprintf(f_metrics, "{\"file\": ");
+    json_fput_string(metrics->name, f_metrics);
+    fprintf(f_metrics, ", \"lines\": %d, \"tokens\": %ld, \"IC\": %u, "
+                       "\"DC\": %u, \"code_words\": %d, "
+                       "\"data_words\": %d, \"labels\": %d, "
+                       "\"entries\": %d, \"externs\": %d, \"errors\": %d",
+            metrics->lines, file_stats.tokens, metrics->IC, metrics->DC,
+            metrics->code_words, metrics->data_words, metrics->labels,
+            metrics->entries, metrics->externs, metrics->errors);
+    
+    fprintf(f_metrics, ", \"phases_us\": {");
+    for (i = 0; i < MAX_PHASES; i++) {
+        fprintf(f_metrics, "%s\"%s\": %ld", (i > 0) ? ", " : "",
+                phase_names[i], (long)(file_stats.wall[i]*1e6));
+        total_wall += file_stats.wall[i];
+    }
+    
+    fprintf(f_metrics, "}, \"total_us\": %ld, \"peak_heap_bytes\": %lu}\n",
+            (long)(total_wall*1e6), get_file_peak());
+    fflush(f_metrics);
+}
+
+/*Returns the monotonic time in seconds.*/
+static double get_wall_time(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*Adds from to to and resets from.*/
+static void add_run_stats(run_stats *to, run_stats *from) {
+    int i;
+    
+    for (i = 0; i < MAX_PHASES; i++) {
+        to->wall[i] += from->wall[i];
+        to->cpu[i]  += from->cpu[i];
+        from->wall[i] = 0;
+        from->cpu[i]  = 0;
+    }
+    
+    to->lines  += from->lines;
+    to->tokens += from->tokens;
+    to->words  += from->words;
+    to->files  += from->files;
+    
+    from->lines  = 0;
+    from->tokens = 0;
+    from->words  = 0;
+    from->files  = 0;
+}
+
+/*Prints the table of the phases and the throughput.*/
+static void print_run_stats(run_stats *stats) {
+    int i;
+    double total_wall = 0;
+    double total_cpu  = 0;
+    
+    printf("%-20s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+    for (i = 0; i < MAX_PHASES; i++) {
+        printf("%-20s %12.3f %12.3f\n", phase_names[i],
+               stats->wall[i]*1000, stats->cpu[i]*1000);
+        
+        total_wall += stats->wall[i];
+        total_cpu  += stats->cpu[i];
+    }
+    printf("%-20s %12.3f %12.3f\n", "total", total_wall*1000, total_cpu*1000);
+    
+    print_rate("Lines", stats->lines, total_wall);
+    print_rate("Tokens", stats->tokens, total_wall);
+    printf("Words emitted: %ld\n", stats->words);
+}
+
+/*Prints the count, and the count per second if there's any time to
+  speak of.*/
+static void print_rate(char *name, long count, double time) {
+    if (time > 0) {
+        printf("%s: %ld (%.0f/sec)\n", name, count, count/time);
+    } else {
+        printf("%s: %ld\n", name, count);
+    }
+}
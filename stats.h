@@ -0,0 +1,50 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*the phases timed by --stats*/
+typedef enum {
+    phase_read,
+    phase_lexer,
+    phase_parser,
+    phase_assembler,
+    phase_IC_offset,
+    phase_second_pass,
+    phase_output,
+    MAX_PHASES
+} stat_phase;
+
+/*what the driver knows of a file, for --metrics-json*/
+typedef struct file_metrics {
+    const char *name;
+    int lines;
+    unsigned int IC, DC; /*final values*/
+    int code_words;
+    int data_words;
+    int labels;
+    int entries;
+    int externs;
+    int errors;
+} file_metrics;
+
+extern bool STATS;   /*set by --stats and by --metrics-json*/
+extern bool METRICS; /*set once --metrics-json opened its file*/
+
+/*With the stats disabled, all that's left of these is the check of STATS,
+  so they may stay in the hot paths.*/
+#define STATS_BEGIN(phase) (STATS ? stats_begin(phase) : (void)0)
+#define STATS_END(phase)   (STATS ? stats_end(phase) : (void)0)
+#define STATS_TOKENS(last_token) \
+    (STATS ? stats_add_tokens(last_token) : (void)0)
+
+void stats_begin(stat_phase phase);
+void stats_end(stat_phase phase);
+void stats_add_tokens(c_list *last_token);
+
+void end_file_stats(int lines, int words, bool print);
+void print_batch_stats(void);
+
+bool open_metrics(const char *filename);
+void close_metrics(void);
+void write_file_metrics(file_metrics *metrics);
+
+#endif /*STATS_H*/
@@ -6,10 +6,10 @@
 #include <stdlib.h>
 
 #include "bool.h"
+#include "alloc.h"
 #include "token.h"
 
 static bool is_number(char *str);
-static bool is_valid_identifier(char *str);
 
 #define MAX_OPS 16
 #define MAX_DATA_DIRS 5
@@ -66,8 +66,8 @@ token *create_token(int starting_index, int length, char *input) {
     token *new_token;
     char *new_tokstr;
     
-    new_token = malloc(sizeof(token));
-    new_tokstr = malloc(sizeof(char)*(length+1));
+    new_token = mem_alloc(sizeof(token), mem_lexer);
+    new_tokstr = mem_alloc(sizeof(char)*(length+1), mem_lexer);
     if (new_token == NULL || new_tokstr == NULL) {
         puts("Error, malloc failure in create_token.");
         exit(1);
@@ -88,8 +88,8 @@ token *create_token(int starting_index, int length, char *input) {
 /*Frees the token. Not for use with clist (see destroy_clist_token).*/
 void destroy_token(token *tok) {
     if (tok != NULL) {
-        free(tok->tokstr);
-        free(tok);
+        mem_free(tok->tokstr);
+        mem_free(tok);
     }
 }
 
@@ -104,8 +104,8 @@ token *extract_token(token *tok) {
         return NULL;
     }
     
-    new_token = malloc(sizeof(token));
-    string = malloc(sizeof(char)*(tok->length+1));
+    new_token = mem_alloc(sizeof(token), mem_symbols);
+    string = mem_alloc(sizeof(char)*(tok->length+1), mem_symbols);
     if (new_token == NULL || string == NULL) {
         puts("Error, malloc failure in get_next_toktype: tok or string.");
         exit(1);
@@ -185,7 +185,7 @@ static bool is_number(char *str) {
 }
 
 /*Checks if the passed string is a valid identifier.*/
-static bool is_valid_identifier(char *str) {
+bool is_valid_identifier(char *str) {
     if (!isalpha(*str)) {
         return false;
     }
@@ -156,6 +156,7 @@ token *create_token(int starting_index, int length, char *input);
 void destroy_token(token *tok);
 token *extract_token(token *tok);
 token_type get_toktype(token *tok);
+bool is_valid_identifier(char *str);
 
 token_type downcast_toktype(token_type toktype);
 void print_token(token *tok);
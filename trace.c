@@ -0,0 +1,173 @@
+/*Chrome trace events, written with --trace FILE, for chrome://tracing and
+  Perfetto. There's a span (a begin and an end event) for every file, pass
+  and output file, and for every TRACE_LINE_SAMPLE-th line, and counters
+  for IC, DC and the sizes of the symbol tables.
+  
+  The events go into a JSON array, one per line. The timestamps are in
+  microseconds since open_trace, from the monotonic clock. The file is
+  fully buffered, so the tracing costs little more than the formatting.
+  
+  The text trace of --trace-cat is something else: the debug output of the
+  passes, printed to stdout when the category is enabled. stdout is made
+  fully buffered then, so tracing a large file doesn't flush every line.*/
+
+#define _POSIX_C_SOURCE 199309L /*for clock_gettime*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bool.h"
+#include "json.h"
+#include "trace.h"
+
+#define TRACE_BUFFER_SIZE 65536
+#define TRACE_PID 1
+#define TRACE_TID 1
+
+bool TRACE = false;
+unsigned int TRACE_CATS = 0;
+
+static const char *cat_names[] = {
+    "lex",   /*TRACE_LEX*/
+    "parse", /*TRACE_PARSE*/
+    "fpass", /*TRACE_FPASS*/
+    "spass", /*TRACE_SPASS*/
+    "out"    /*TRACE_OUT*/
+};
+
+#define MAX_CATS ((int)(sizeof(cat_names)/sizeof(cat_names[0])))
+
+static FILE *f_trace;
+static double start_time;
+static bool first_event; /*no comma before it*/
+
+static void put_event(const char *cat, const char *name, char phase);
+static double get_wall_time(void);
+
+/*Opens the trace file and starts the array of the events. Returns false
+  if it can't be written, in which case the tracing stays off.*/
+bool open_trace(const char *filename) {
+    f_trace = fopen(filename, "w");
+    if (f_trace == NULL) {
+        fprintf(stderr, "Error, can't write the trace: %s\n", filename);
+        return false;
+    }
+    
+    setvbuf(f_trace, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    fprintf(f_trace, "[");
+    
+    start_time  = get_wall_time();
+    first_event = true;
+    TRACE       = true;
+    
+    return true;
+}
+
+/*Ends the array and closes the trace file.*/
+void close_trace(void) {
+    if (!TRACE) {
+        return;
+    }
+    
+    fprintf(f_trace, "\n]\n");
+    fclose(f_trace);
+    
+    TRACE = false;
+}
+
+/*Begins the span name of the category cat.*/
+void trace_begin(const char *cat, const char *name) {
+    put_event(cat, name, 'B');
+    fprintf(f_trace, "}");
+}
+
+/*Ends the span begun by trace_begin.*/
+void trace_end(const char *cat, const char *name) {
+    put_event(cat, name, 'E');
+    fprintf(f_trace, "}");
+}
+
+/*Begins the span of a (sampled) line.*/
+void trace_begin_line(int linenum) {
+    put_event("line", "line", 'B');
+    fprintf(f_trace, ", \"args\": {\"line\": %d}}", linenum);
+}
+
+/*Ends the span begun by trace_begin_line.*/
+void trace_end_line(int linenum) {
+    put_event("line", "line", 'E');
+    fprintf(f_trace, ", \"args\": {\"line\": %d}}", linenum);
+}
+
+/*Sets the counter name to value, from now on.*/
+void trace_counter(const char *name, long value) {
+    put_event("counter", name, 'C');
+    fprintf(f_trace, ", \"args\": {\"value\": %ld}}", value);
+}
+
+/*Enables the categories of the comma separated list of their names (or
+  "all"). Returns false and prints an error upon an unknown one.*/
+bool set_trace_cats(const char *list) {
+    int i;
+    size_t length;
+    unsigned int cats = 0;
+    const char *name = list;
+    
+    while (*name != '\0') {
+        length = strcspn(name, ",");
+        
+        if (length == strlen("all") && strncmp(name, "all", length) == 0) {
+            cats = (1u << MAX_CATS) - 1;
+        } else {
+            for (i = 0; i < MAX_CATS; i++) {
+                if (length == strlen(cat_names[i]) &&
+                    strncmp(name, cat_names[i], length) == 0) {
+                    break;
+                }
+            }
+            
+            if (i == MAX_CATS) {
+                fprintf(stderr, "Error, unknown trace category: %.*s\n",
+                        (int)length, name);
+                return false;
+            }
+            
+            cats |= 1u << i;
+        }
+        
+        name += length;
+        if (*name == ',') {
+            name++;
+        }
+    }
+    
+    /*must come before anything is printed*/
+    if (cats != 0 && TRACE_CATS == 0) {
+        setvbuf(stdout, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    }
+    TRACE_CATS = cats;
+    
+    return true;
+}
+
+/*Writes the fields common to all the events, without the closing
+  brace.*/
+static void put_event(const char *cat, const char *name, char phase) {
+    fprintf(f_trace, first_event ? "\n{\"name\": " : ",\n{\"name\": ");
+    json_fput_string(name, f_trace);
+    fprintf(f_trace, ", \"cat\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+                     "\"pid\": %d, \"tid\": %d", cat, phase,
+            (get_wall_time() - start_time) * 1e6, TRACE_PID, TRACE_TID);
+    
+    first_event = false;
+}
+
+/*Returns the monotonic time in seconds.*/
+static double get_wall_time(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,38 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_LINE_SAMPLE 100 /*every this many lines get a span*/
+
+/*categories of the text trace, --trace-cat (in the order of the names in
+  trace.c)*/
+#define TRACE_LEX   0x01 /*every token of the lexer*/
+#define TRACE_PARSE 0x02 /*the descent of the parser*/
+#define TRACE_FPASS 0x04 /*every line with its tokens, statement and code*/
+#define TRACE_SPASS 0x08 /*what the second pass is fed*/
+#define TRACE_OUT   0x10 /*the output words, in decimal and binary*/
+
+extern bool TRACE;              /*set once --trace opened its file*/
+extern unsigned int TRACE_CATS; /*the enabled categories*/
+
+/*With the tracing disabled, all that's left of these is the check of
+  TRACE, so they may stay in the hot paths.*/
+#define TRACE_BEGIN(cat, name) (TRACE ? trace_begin(cat, name) : (void)0)
+#define TRACE_END(cat, name)   (TRACE ? trace_end(cat, name) : (void)0)
+#define TRACE_COUNTER(name, value) \
+    (TRACE ? trace_counter(name, value) : (void)0)
+
+/*The same goes for a disabled category, it's a single test.*/
+#define TRACE_CAT(cat) (TRACE_CATS & (cat))
+
+bool open_trace(const char *filename);
+void close_trace(void);
+
+void trace_begin(const char *cat, const char *name);
+void trace_end(const char *cat, const char *name);
+void trace_begin_line(int linenum);
+void trace_end_line(int linenum);
+void trace_counter(const char *name, long value);
+
+bool set_trace_cats(const char *list);
+
+#endif /*TRACE_H*/
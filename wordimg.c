@@ -0,0 +1,341 @@
+/*Bit packed images of machine words, and the data images that keep the
+  runs of a word apart.
+  
+  A word never spans more than two bytes (it starts at bit 0, 2, 4 or 6
+  of its first byte), so every access is a 16 bit load and, for the
+  writes, a store. The bytes are allocated with a spare one at the end,
+  so that the second byte of the last word is always there.*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "alloc.h"
+#include "wordimg.h"
+
+#define WORD_IMAGE_INIT_SIZE 64 /*words*/
+#define DATA_RUNS_INIT_SIZE 8
+
+static void grow_word_image(word_image *img, unsigned int capacity);
+static void add_data_run(data_image *img, unsigned int start,
+                         unsigned int count, unsigned int value);
+
+void init_word_image(word_image *img) {
+    img->bytes    = NULL;
+    img->count    = 0;
+    img->capacity = 0;
+}
+
+/*Frees the words, img is left empty (and may be used again).*/
+void destroy_word_image(word_image *img) {
+    mem_free(img->bytes);
+    init_word_image(img);
+}
+
+/*Makes room for count words in total, so that appending them doesn't
+  reallocate.*/
+void reserve_words(word_image *img, unsigned int count) {
+    if (count > img->capacity) {
+        grow_word_image(img, count);
+    }
+}
+
+/*Makes img count words long, the words added are zero. They can then be
+  set in any order (see set_word).*/
+void set_word_count(word_image *img, unsigned int count) {
+    if (count < img->count) {
+        drop_words(img, img->count - count);
+    } else {
+        reserve_words(img, count);
+        img->count = count;
+    }
+}
+
+void append_word(word_image *img, unsigned int word) {
+    if (img->count == img->capacity) {
+        grow_word_image(img, img->capacity == 0 ? WORD_IMAGE_INIT_SIZE :
+                                                  img->capacity*2);
+    }
+    
+    set_word(img, img->count++, word);
+}
+
+unsigned int get_word(const word_image *img, unsigned int i) {
+    unsigned long bit = (unsigned long)i * WORD_BITS;
+    const unsigned char *p_byte = img->bytes + (bit >> 3);
+    
+    return ((p_byte[0] | (unsigned int)p_byte[1] << 8) >> (bit & 7)) &
+           WORD_MASK;
+}
+
+/*Sets word i, which must be below the count (or be appended by
+  append_word).*/
+void set_word(word_image *img, unsigned int i, unsigned int word) {
+    unsigned long bit = (unsigned long)i * WORD_BITS;
+    unsigned char *p_byte = img->bytes + (bit >> 3);
+    int shift = bit & 7;
+    unsigned int pair = p_byte[0] | (unsigned int)p_byte[1] << 8;
+    
+    pair &= ~(WORD_MASK << shift);
+    pair |= (word & WORD_MASK) << shift;
+    
+    p_byte[0] = pair & 0xFF;
+    p_byte[1] = pair >> 8;
+}
+
+/*Removes the last count words. Their bits are zeroed, so that the
+  padding stays zero.*/
+void drop_words(word_image *img, unsigned int count) {
+    while (count-- > 0 && img->count > 0) {
+        set_word(img, --img->count, 0);
+    }
+}
+
+/*Makes dst, which must be empty, a copy of src.*/
+void copy_word_image(word_image *dst, const word_image *src) {
+    reserve_words(dst, src->count);
+    if (src->count > 0) {
+        memcpy(dst->bytes, src->bytes, get_word_image_bytes(src->count));
+    }
+    dst->count = src->count;
+}
+
+/*Returns the bytes that count packed words take, without the spare
+  byte (the size of the words in the binary object).*/
+unsigned long get_word_image_bytes(unsigned int count) {
+    return ((unsigned long)count * WORD_BITS + 7) / 8;
+}
+
+/*Moves the words into bytes for capacity words. The new bytes are
+  zeroed, so that the padding of the last byte is always zero.*/
+static void grow_word_image(word_image *img, unsigned int capacity) {
+    unsigned long size = get_word_image_bytes(capacity) + 1;
+    unsigned char *new_bytes = mem_alloc(size, mem_code);
+    
+    if (new_bytes == NULL) {
+        fprintf(stderr, "Malloc failure in grow_word_image.");
+        exit(1);
+    }
+    
+    memset(new_bytes, 0, size);
+    if (img->bytes != NULL) {
+        memcpy(new_bytes, img->bytes, get_word_image_bytes(img->count));
+        mem_free(img->bytes);
+    }
+    
+    img->bytes    = new_bytes;
+    img->capacity = capacity;
+}
+
+void init_data_image(data_image *img) {
+    init_word_image(&img->literals);
+    img->runs         = NULL;
+    img->run_count    = 0;
+    img->run_capacity = 0;
+    img->count        = 0;
+    img->tail_value   = 0;
+    img->tail_count   = 0;
+}
+
+/*Frees the words and the runs, img is left empty (and may be used
+  again).*/
+void destroy_data_image(data_image *img) {
+    destroy_word_image(&img->literals);
+    mem_free(img->runs);
+    init_data_image(img);
+}
+
+/*Appends count words of value. They extend the last run if it's of the
+  same value and at the end, and they become a run along with the equal
+  literals at the end once there are DATA_RUN_MIN of them.*/
+void append_data_run(data_image *img, unsigned int value,
+                     unsigned int count) {
+    unsigned int i;
+    word_run *p_last = img->run_count > 0 ? &img->runs[img->run_count-1] :
+                                            NULL;
+    
+    if (count == 0) {
+        return;
+    }
+    
+    if (p_last != NULL && p_last->value == value &&
+        p_last->start + p_last->count == img->count) {
+        p_last->count   += count;
+        p_last->covered += count;
+        img->count      += count;
+        return;
+    }
+    
+    if (img->tail_count == 0 || img->tail_value != value) {
+        img->tail_value = value;
+        img->tail_count = 0;
+    }
+    
+    if (img->tail_count + count >= DATA_RUN_MIN) {
+        drop_words(&img->literals, img->tail_count);
+        add_data_run(img, img->count - img->tail_count,
+                     img->tail_count + count, value);
+        img->tail_count = 0;
+    } else {
+        img->tail_count += count;
+        for (i = 0; i < count; i++) {
+            append_word(&img->literals, value);
+        }
+    }
+    
+    img->count += count;
+}
+
+/*Removes the last count words. The run they end in is cut short, and
+  the equal literals at the end are counted again as the tail.*/
+void drop_data_words(data_image *img, unsigned int count) {
+    unsigned int new_count = count < img->count ? img->count - count : 0;
+    unsigned int run_end = 0; /*of the last run that's kept*/
+    word_run *p_last;
+    
+    while (img->run_count > 0 &&
+           img->runs[img->run_count-1].start >= new_count) {
+        img->run_count--;
+    }
+    
+    if (img->run_count > 0) {
+        p_last = &img->runs[img->run_count-1];
+        if (p_last->start + p_last->count > new_count) {
+            p_last->covered -= p_last->start + p_last->count - new_count;
+            p_last->count    = new_count - p_last->start;
+        }
+        
+        run_end = p_last->start + p_last->count;
+        drop_words(&img->literals,
+                   img->literals.count - (new_count - p_last->covered));
+    } else {
+        drop_words(&img->literals, img->literals.count - new_count);
+    }
+    
+    img->count      = new_count;
+    img->tail_count = 0;
+    if (new_count > run_end) {
+        img->tail_value = get_word(&img->literals, img->literals.count-1);
+        while (img->tail_count < new_count - run_end &&
+               get_word(&img->literals,
+                        img->literals.count-1 - img->tail_count) ==
+               img->tail_value) {
+            img->tail_count++;
+        }
+    }
+}
+
+/*Returns word i of the image, which must be below the count. The run
+  that holds it (or is right before it) is found by a binary search.*/
+unsigned int get_data_word(const data_image *img, unsigned int i) {
+    int low = 0;
+    int high = (int)img->run_count - 1;
+    int mid;
+    const word_run *p_run = NULL; /*the last run that starts at i or before*/
+    
+    while (low <= high) {
+        mid = (low + high) / 2;
+        if (img->runs[mid].start <= i) {
+            p_run = &img->runs[mid];
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    
+    if (p_run == NULL) {
+        return get_word(&img->literals, i);
+    } else if (i < p_run->start + p_run->count) {
+        return p_run->value;
+    }
+    
+    return get_word(&img->literals, i - p_run->covered);
+}
+
+/*Makes dst, which must be empty, a copy of src.*/
+void copy_data_image(data_image *dst, const data_image *src) {
+    unsigned int i;
+    
+    copy_word_image(&dst->literals, &src->literals);
+    for (i = 0; i < src->run_count; i++) {
+        add_data_run(dst, src->runs[i].start, src->runs[i].count,
+                     src->runs[i].value);
+    }
+    
+    dst->count      = src->count;
+    dst->tail_value = src->tail_value;
+    dst->tail_count = src->tail_count;
+}
+
+/*Appends the words of src to dst, with the runs expanded.*/
+void append_data_words(word_image *dst, const data_image *src) {
+    unsigned int i = 0;
+    unsigned int literal = 0; /*the next literal*/
+    unsigned int run;
+    unsigned int end;
+    
+    reserve_words(dst, dst->count + src->count);
+    for (run = 0; run <= src->run_count; run++) {
+        /*the literals before the run (or after the last one)*/
+        end = run < src->run_count ? src->runs[run].start : src->count;
+        for (; i < end; i++) {
+            append_word(dst, get_word(&src->literals, literal++));
+        }
+        
+        if (run < src->run_count) {
+            for (end += src->runs[run].count; i < end; i++) {
+                append_word(dst, src->runs[run].value);
+            }
+        }
+    }
+}
+
+/*Appends the words of src to dst, the runs of src stay runs.*/
+void append_data_image(data_image *dst, const data_image *src) {
+    unsigned int i = 0;
+    unsigned int literal = 0; /*the next literal*/
+    unsigned int run;
+    unsigned int end;
+    
+    for (run = 0; run <= src->run_count; run++) {
+        end = run < src->run_count ? src->runs[run].start : src->count;
+        for (; i < end; i++) {
+            append_data_run(dst, get_word(&src->literals, literal++), 1);
+        }
+        
+        if (run < src->run_count) {
+            append_data_run(dst, src->runs[run].value, src->runs[run].count);
+            i += src->runs[run].count;
+        }
+    }
+}
+
+static void add_data_run(data_image *img, unsigned int start,
+                         unsigned int count, unsigned int value) {
+    word_run *new_runs;
+    unsigned int covered = img->run_count > 0 ?
+                           img->runs[img->run_count-1].covered : 0;
+    
+    if (img->run_count == img->run_capacity) {
+        img->run_capacity = img->run_capacity == 0 ? DATA_RUNS_INIT_SIZE :
+                                                     img->run_capacity*2;
+        new_runs = mem_alloc(sizeof(word_run)*img->run_capacity, mem_code);
+        if (new_runs == NULL) {
+            fprintf(stderr, "Malloc failure in add_data_run.");
+            exit(1);
+        }
+        
+        if (img->runs != NULL) {
+            memcpy(new_runs, img->runs, sizeof(word_run)*img->run_count);
+            mem_free(img->runs);
+        }
+        img->runs = new_runs;
+    }
+    
+    img->runs[img->run_count].start   = start;
+    img->runs[img->run_count].count   = count;
+    img->runs[img->run_count].value   = value;
+    img->runs[img->run_count].covered = covered + count;
+    img->run_count++;
+}
@@ -0,0 +1,67 @@
+#ifndef WORDIMG_H
+#define WORDIMG_H
+
+#define WORD_BITS 10 /*of a machine word*/
+#define WORD_MASK ((1u << WORD_BITS) - 1)
+
+/*Machine words, bit packed: 4 words in 5 bytes, word i in the bits
+  i*WORD_BITS and up of the little endian bit stream (which is also how
+  the binary object stores them, see objfile.c). A zeroed word_image is
+  an empty one.*/
+typedef struct word_image {
+    unsigned char *bytes;  /*NULL until the first word is appended*/
+    unsigned int count;    /*words*/
+    unsigned int capacity; /*words that fit in bytes*/
+} word_image;
+
+void init_word_image(word_image *img);
+void destroy_word_image(word_image *img);
+void reserve_words(word_image *img, unsigned int count);
+void set_word_count(word_image *img, unsigned int count);
+
+void append_word(word_image *img, unsigned int word);
+unsigned int get_word(const word_image *img, unsigned int i);
+void set_word(word_image *img, unsigned int i, unsigned int word);
+
+void drop_words(word_image *img, unsigned int count);
+void copy_word_image(word_image *dst, const word_image *src);
+unsigned long get_word_image_bytes(unsigned int count);
+
+#define DATA_RUN_MIN 10 /*words, a run takes the room of about as many*/
+
+    /*a run of the same word*/
+    typedef struct word_run {
+        unsigned int start;   /*index of the first word of the run*/
+        unsigned int count;   /*words in the run*/
+        unsigned int value;
+        unsigned int covered; /*words in the runs up to this one*/
+    } word_run;
+
+/*The data words, where runs of at least DATA_RUN_MIN equal words are
+  kept as a single word_run, and the rest (the literals) in order in a
+  word_image. A zeroed data_image is an empty one.*/
+typedef struct data_image {
+    word_image literals;
+    word_run *runs;          /*by start*/
+    unsigned int run_count;
+    unsigned int run_capacity;
+    unsigned int count;      /*words, of the runs and the literals*/
+    
+    /*the literals at the end that equal tail_value, which become a run
+      if it gets long enough*/
+    unsigned int tail_value;
+    unsigned int tail_count;
+} data_image;
+
+void init_data_image(data_image *img);
+void destroy_data_image(data_image *img);
+
+void append_data_run(data_image *img, unsigned int value,
+                     unsigned int count);
+void drop_data_words(data_image *img, unsigned int count);
+unsigned int get_data_word(const data_image *img, unsigned int i);
+void copy_data_image(data_image *dst, const data_image *src);
+void append_data_words(word_image *dst, const data_image *src);
+void append_data_image(data_image *dst, const data_image *src);
+
+#endif /*WORDIMG_H*/